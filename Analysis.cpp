@@ -0,0 +1,109 @@
+// BDPP Classifier Analysis
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Rejection counts, the unique ratio histogram and the capacity grid of
+// -analysis. The counters are filled in by the classification pass itself,
+// this file only sets them up and writes them out.
+//
+
+#include "BitmapReader.h"
+#include "Analysis.h"
+#include "MemStats.h"
+
+classifierAnalysis* createAnalysis(int blockWidth, int blockHeight, int tileBlocks)
+{
+	classifierAnalysis* analysis = (classifierAnalysis*)trackedCalloc(1, sizeof(classifierAnalysis), MEM_SITE_BOOKKEEPING);
+	if (analysis == NULL) return NULL;
+
+	analysis->blockWidth = blockWidth;
+	analysis->blockHeight = blockHeight;
+	analysis->tileBlocks = tileBlocks;
+	analysis->gridWidth = (blockWidth + tileBlocks - 1) / tileBlocks;
+	analysis->gridHeight = (blockHeight + tileBlocks - 1) / tileBlocks;
+	analysis->tileCounts = (int*)trackedCalloc((size_t)analysis->gridWidth * analysis->gridHeight + 1, sizeof(int), MEM_SITE_BOOKKEEPING);
+	if (analysis->tileCounts == NULL)
+	{
+		trackedFree(analysis);
+		return NULL;
+	}
+	return analysis;
+} // createAnalysis
+
+int writeAnalysis(classifierAnalysis* analysis, char* fileName)
+{
+	FILE* ptrFile;
+	int classified = analysis->ratioFailures + analysis->hvdFailures + analysis->flipFailures + analysis->embeddable;
+	int tileMax = 0;
+
+	for (int i = 0; i < analysis->gridWidth * analysis->gridHeight; i++)
+	{
+		if (analysis->tileCounts[i] > tileMax) tileMax = analysis->tileCounts[i];
+	}
+
+	printf("\nClassifier Analysis:\n");
+	if (analysis->skipsUniform) printf("Blocks Classified: %d (%d uniform blocks skipped)\n", classified, analysis->uniformSkipped);
+	else printf("Blocks Classified: %d\n", classified);
+	printf("Rejected by Ratio Check: %d\n", analysis->ratioFailures);
+	printf("Rejected by HVD Check: %d\n", analysis->hvdFailures);
+	printf("Rejected after Middle Pixel Flip: %d\n", analysis->flipFailures);
+	printf("Embeddable: %d\n", analysis->embeddable);
+	printf("Unique Ratios:");
+	for (int i = 0; i <= ANALYSIS_MAX_UNIQUE_RATIOS; i++)
+	{
+		printf(" %d:%d", i, analysis->uniqueRatios[i]);
+	}
+	printf("\nCapacity Grid: %d x %d tiles of %d x %d blocks, up to %d embeddable blocks per tile\n",
+		analysis->gridWidth, analysis->gridHeight, analysis->tileBlocks, analysis->tileBlocks, tileMax);
+
+	ptrFile = fopen(fileName, "w");
+	if (ptrFile == NULL)
+	{
+		printf("Error - could not write analysis file %s.\n\n", fileName);
+		return FAILURE;
+	}
+
+	fprintf(ptrFile, "statistic,value\n");
+	fprintf(ptrFile, "blocks_classified,%d\n", classified);
+	if (analysis->skipsUniform) fprintf(ptrFile, "uniform_blocks_skipped,%d\n", analysis->uniformSkipped);
+	fprintf(ptrFile, "ratio_check_rejected,%d\n", analysis->ratioFailures);
+	fprintf(ptrFile, "hvd_check_rejected,%d\n", analysis->hvdFailures);
+	fprintf(ptrFile, "middle_pixel_flip_rejected,%d\n", analysis->flipFailures);
+	fprintf(ptrFile, "embeddable,%d\n", analysis->embeddable);
+	for (int i = 0; i <= ANALYSIS_MAX_UNIQUE_RATIOS; i++)
+	{
+		fprintf(ptrFile, "unique_ratios_%d,%d\n", i, analysis->uniqueRatios[i]);
+	}
+	fprintf(ptrFile, "block_width,%d\n", analysis->blockWidth);
+	fprintf(ptrFile, "block_height,%d\n", analysis->blockHeight);
+	fprintf(ptrFile, "tile_blocks,%d\n", analysis->tileBlocks);
+	fprintf(ptrFile, "grid_width,%d\n", analysis->gridWidth);
+	fprintf(ptrFile, "grid_height,%d\n", analysis->gridHeight);
+
+	// the grid follows the statistics, one line per row of tiles, top of the image first
+	fprintf(ptrFile, "\n");
+	for (int row = analysis->gridHeight - 1; row >= 0; row--)
+	{
+		int* tileRow = analysis->tileCounts + (size_t)row * analysis->gridWidth;
+		for (int col = 0; col < analysis->gridWidth; col++)
+		{
+			fprintf(ptrFile, col == 0 ? "%d" : ",%d", tileRow[col]);
+		}
+		fprintf(ptrFile, "\n");
+	}
+
+	if (fclose(ptrFile) != 0)
+	{
+		printf("Error - could not write analysis file %s.\n\n", fileName);
+		return FAILURE;
+	}
+	printf("Analysis written to %s\n", fileName);
+	return SUCCESS;
+} // writeAnalysis
+
+void freeAnalysis(classifierAnalysis* analysis)
+{
+	if (analysis == NULL) return;
+	trackedFree(analysis->tileCounts);
+	trackedFree(analysis);
+	return;
+} // freeAnalysis
@@ -0,0 +1,71 @@
+// BDPP Classifier Analysis Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Statistics gathered while the blocks of an image are classified: why the
+// blocks that are not embeddable were rejected, how many unique ratios the
+// blocks have and how the embeddable blocks are spread over the image, so
+// covers and dithering settings can be compared by capacity.
+//
+
+#pragma once
+
+#define ANALYSIS_MAX_UNIQUE_RATIOS	4	// one per diagonal partition of a block
+#define ANALYSIS_DEFAULT_TILE		32	// blocks per side of a capacity grid tile
+
+/*
+* Structure: classifierAnalysis
+* Usage: classifierAnalysis* analysis = createAnalysis(blockWidth, blockHeight, tileBlocks);
+* ------------------------------------------------------
+* This structure counts the outcome of the BDPP checks
+* for every block classified. A block is rejected by the
+* first check it fails. The capacity grid holds the
+* embeddable blocks of each tile of tileBlocks by
+* tileBlocks blocks, tile row 0 is the bottom of the
+* image like block row 0.
+*/
+struct classifierAnalysis
+{
+    int uniqueRatios[ANALYSIS_MAX_UNIQUE_RATIOS + 1]; // blocks by totalUniqueRatios
+    int uniformSkipped;          // all 0 or all 1 blocks, counted as one unique ratio
+    int skipsUniform;            // only the table kernel passes over uniform blocks, the sliced ones classify them
+    int ratioFailures;           // fewer than 2 unique ratios
+    int hvdFailures;             // not HVD connected
+    int flipFailures;            // not embeddable once the middle pixel is flipped
+    int embeddable;
+    int blockWidth;
+    int blockHeight;
+    int tileBlocks;
+    int gridWidth;
+    int gridHeight;
+    int* tileCounts;             // gridWidth * gridHeight embeddable block counts
+};  // classifierAnalysis
+
+/*
+* Function: createAnalysis
+* Usage: state->analysis = createAnalysis(state->blockWidth, state->blockHeight, gAnalysisTile);
+* ------------------------------------------------------
+* This function allocates zeroed counters and a capacity
+* grid for an image of blockWidth by blockHeight blocks.
+*/
+classifierAnalysis* createAnalysis(int blockWidth, int blockHeight, int tileBlocks);
+
+/*
+* Function: writeAnalysis
+* Usage: status = writeAnalysis(state->analysis, gAnalysisPathFileName);
+* ------------------------------------------------------
+* This function prints the rejection counts and writes
+* them with the unique ratio histogram and the capacity
+* grid to a CSV file. The uniform blocks skipped are only
+* printed and written when skipsUniform is set. The grid is written one line per
+* row of tiles from the top of the image down. Returns
+* FAILURE if the file could not be written.
+*/
+int writeAnalysis(classifierAnalysis* analysis, char* fileName);
+
+/*
+* Function: freeAnalysis
+* Usage: freeAnalysis(state->analysis);
+* ------------------------------------------------------
+* This function releases the counters and grid.
+*/
+void freeAnalysis(classifierAnalysis* analysis);
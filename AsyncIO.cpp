@@ -0,0 +1,372 @@
+// Asynchronous I/O
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Whole-file reads and writes for batch processing. The default backend uses
+// Windows overlapped I/O so several requests are queued in the kernel at once,
+// the fallback is a small pool of worker threads doing blocking fread/fwrite.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "AsyncIO.h"
+#include "MemStats.h"
+#include "Trace.h"
+#include "Durable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define SUCCESS 0
+#define FAILURE -1
+
+int gIoBackend = 0;
+int gIoQueueDepth = IO_DEFAULT_QUEUE_DEPTH;
+
+// writes in flight, oldest first, at most gIoQueueDepth of them
+ioRequest** gIoWriteRing = NULL;
+int gIoWriteHead = 0;
+int gIoWriteCount = 0;
+
+// thread backend state
+std::thread* gIoWorkers = NULL;
+int gIoNumWorkers = 0;
+ioRequest* gIoQueueHead = NULL;
+ioRequest* gIoQueueTail = NULL;
+int gIoStopping = 0;
+std::mutex gIoLock;
+std::condition_variable gIoWorkReady;
+std::condition_variable gIoWorkDone;
+
+// reads or writes one request with plain blocking stdio, used by the worker threads
+static void ioBlockingTransfer(ioRequest* request)
+{
+	FILE* ptrFile;
+
+	request->status = FAILURE;
+	if (request->isWrite)
+	{
+		ptrFile = fopen(request->fileName, "wb");
+		if (ptrFile == NULL) return;
+		traceBegin(TRACE_WRITE, request->traceImage, TRACE_NO_ID);
+		if (fwrite(request->data, sizeof(unsigned char), request->size, ptrFile) == request->size)
+		{
+			request->status = SUCCESS;
+		}
+		traceEnd(TRACE_WRITE, request->traceImage, TRACE_NO_ID);
+		fclose(ptrFile);
+		return;
+	}
+
+	ptrFile = fopen(request->fileName, "rb");
+	if (ptrFile == NULL) return;
+	fseek(ptrFile, 0, SEEK_END);
+	request->size = ftell(ptrFile);
+	fseek(ptrFile, 0, SEEK_SET);
+	request->data = (unsigned char*)trackedMalloc(request->size, MEM_SITE_FILE);
+	traceBegin(TRACE_READ, TRACE_NO_ID, TRACE_NO_ID);
+	if (request->data != NULL && fread(request->data, sizeof(unsigned char), request->size, ptrFile) == request->size)
+	{
+		request->status = SUCCESS;
+	}
+	traceEnd(TRACE_READ, TRACE_NO_ID, TRACE_NO_ID);
+	fclose(ptrFile);
+} // ioBlockingTransfer
+
+// worker thread loop for the thread backend
+static void ioWorker()
+{
+	traceThreadName("io worker");
+	for (;;)
+	{
+		ioRequest* request;
+		{
+			std::unique_lock<std::mutex> lock(gIoLock);
+			gIoWorkReady.wait(lock, [] { return gIoQueueHead != NULL || gIoStopping; });
+			if (gIoQueueHead == NULL) return;
+			request = gIoQueueHead;
+			gIoQueueHead = request->next;
+			if (gIoQueueHead == NULL) gIoQueueTail = NULL;
+		}
+
+		ioBlockingTransfer(request);
+
+		{
+			std::lock_guard<std::mutex> lock(gIoLock);
+			request->done = 1;
+		}
+		gIoWorkDone.notify_all();
+	}
+} // ioWorker
+
+// starts an overlapped ReadFile or WriteFile, the request is marked done if it fails to start
+static void ioStartOverlapped(ioRequest* request)
+{
+	LARGE_INTEGER fileSize;
+	BOOL started;
+
+	request->status = FAILURE;
+	request->hFile = CreateFileA(request->fileName,
+		request->isWrite ? GENERIC_WRITE : GENERIC_READ,
+		request->isWrite ? 0 : FILE_SHARE_READ, NULL,
+		request->isWrite ? CREATE_ALWAYS : OPEN_EXISTING,
+		FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (request->hFile == INVALID_HANDLE_VALUE)
+	{
+		request->done = 1;
+		return;
+	}
+
+	if (!request->isWrite)
+	{
+		if (!GetFileSizeEx(request->hFile, &fileSize) || fileSize.HighPart != 0)
+		{
+			CloseHandle(request->hFile);
+			request->done = 1;
+			return;
+		}
+		request->size = fileSize.LowPart;
+		request->data = (unsigned char*)trackedMalloc(request->size, MEM_SITE_FILE);
+		if (request->data == NULL)
+		{
+			CloseHandle(request->hFile);
+			request->done = 1;
+			return;
+		}
+	}
+
+	memset(&request->overlapped, 0, sizeof(OVERLAPPED));
+	request->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	if (request->isWrite)
+		started = WriteFile(request->hFile, request->data, request->size, NULL, &request->overlapped);
+	else
+		started = ReadFile(request->hFile, request->data, request->size, NULL, &request->overlapped);
+
+	if (!started && GetLastError() != ERROR_IO_PENDING)
+	{
+		CloseHandle(request->overlapped.hEvent);
+		CloseHandle(request->hFile);
+		request->done = 1;
+	}
+} // ioStartOverlapped
+
+// hands a request to the active backend
+static void ioStart(ioRequest* request)
+{
+	if (gIoBackend == IO_BACKEND_OVERLAPPED)
+	{
+		ioStartOverlapped(request);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(gIoLock);
+		request->next = NULL;
+		if (gIoQueueTail == NULL) gIoQueueHead = request;
+		else gIoQueueTail->next = request;
+		gIoQueueTail = request;
+	}
+	gIoWorkReady.notify_one();
+} // ioStart
+
+// blocks until the request has completed and sets its final status
+static void ioWaitTransfer(ioRequest* request)
+{
+	if (gIoBackend == IO_BACKEND_OVERLAPPED)
+	{
+		DWORD transferred = 0;
+
+		if (request->done) return;  // never started
+		if (GetOverlappedResult(request->hFile, &request->overlapped, &transferred, TRUE)
+			&& transferred == request->size)
+		{
+			request->status = SUCCESS;
+		}
+		CloseHandle(request->overlapped.hEvent);
+		CloseHandle(request->hFile);
+		request->done = 1;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(gIoLock);
+	gIoWorkDone.wait(lock, [request] { return request->done != 0; });
+} // ioWaitTransfer
+
+// ioWaitTransfer in a trace wait event
+static void ioWait(ioRequest* request)
+{
+	traceBegin(TRACE_WAIT, request->traceImage, TRACE_NO_ID);
+	ioWaitTransfer(request);
+	traceEnd(TRACE_WAIT, request->traceImage, TRACE_NO_ID);
+} // ioWait
+
+static ioRequest* ioNewRequest(char* fileName, int isWrite)
+{
+	ioRequest* request = (ioRequest*)trackedCalloc(1, sizeof(ioRequest), MEM_SITE_BOOKKEEPING);
+	if (request == NULL)
+	{
+		printf("Error - Could not allocate an I/O request for %s.\n\n", fileName);
+		return NULL;
+	}
+	strncpy(request->fileName, fileName, MAX_PATH - 1);
+	request->isWrite = isWrite;
+	request->status = FAILURE;
+	request->traceImage = isWrite ? currentTraceImage() : TRACE_NO_ID;  // reads are queued before their image starts
+	return request;
+} // ioNewRequest
+
+int ioInit(int backend, int queueDepth)
+{
+	if (queueDepth < 1) queueDepth = 1;
+	gIoQueueDepth = queueDepth;
+	gIoWriteRing = (ioRequest**)trackedCalloc(queueDepth, sizeof(ioRequest*), MEM_SITE_BOOKKEEPING);
+	gIoWriteHead = gIoWriteCount = 0;
+
+	gIoBackend = backend;
+	if (gIoBackend == IO_BACKEND_OVERLAPPED)
+	{
+		// overlapped I/O needs an event per request, if we cannot get one use the threads instead
+		HANDLE probe = CreateEventA(NULL, TRUE, FALSE, NULL);
+		if (probe == NULL)
+		{
+			gIoBackend = IO_BACKEND_THREADS;
+		}
+		else
+		{
+			CloseHandle(probe);
+		}
+	}
+
+	if (gIoBackend != IO_BACKEND_OVERLAPPED)
+	{
+		gIoBackend = IO_BACKEND_THREADS;
+		gIoStopping = 0;
+		gIoNumWorkers = queueDepth;
+		gIoWorkers = new std::thread[gIoNumWorkers];
+		for (int i = 0; i < gIoNumWorkers; i++)
+		{
+			gIoWorkers[i] = std::thread(ioWorker);
+		}
+	}
+	return gIoBackend;
+} // ioInit
+
+ioRequest* ioSubmitRead(char* fileName)
+{
+	ioRequest* request = ioNewRequest(fileName, 0);
+	if (request != NULL) ioStart(request);
+	return request;
+} // ioSubmitRead
+
+unsigned char* ioWaitRead(ioRequest* request, unsigned int* fileSize)
+{
+	unsigned char* fileData;
+
+	// a read that could not be queued
+	if (request == NULL) return NULL;
+
+	ioWait(request);
+	if (request->status != SUCCESS)
+	{
+		trackedFree(request->data);
+		trackedFree(request);
+		return NULL;
+	}
+
+	fileData = request->data;
+	*fileSize = request->size;
+	trackedFree(request);
+	return fileData;
+} // ioWaitRead
+
+// waits for the oldest write in flight and releases it, returns its status
+static int ioRetireWrite()
+{
+	ioRequest* request = gIoWriteRing[gIoWriteHead];
+	int status;
+
+	ioWait(request);
+	status = request->status;
+	if (status != SUCCESS)
+	{
+		printf("Error writing file %s.\n\n", request->fileName);
+		durableDiscard(request->fileName);
+	}
+	else
+	{
+		status = durableFinish(request->fileName);
+	}
+	trackedFree(request->data);
+	trackedFree(request);
+
+	gIoWriteRing[gIoWriteHead] = NULL;
+	gIoWriteHead = (gIoWriteHead + 1) % gIoQueueDepth;
+	gIoWriteCount--;
+	return status;
+} // ioRetireWrite
+
+int ioSubmitWrite(char* fileName, unsigned char* fileData, unsigned int fileSize)
+{
+	ioRequest* request;
+	int status = SUCCESS;
+
+	if (gIoWriteCount == gIoQueueDepth)
+	{
+		status = ioRetireWrite();
+	}
+
+	// with -durable the file is written under its temporary name and committed once retired
+	request = ioNewRequest(fileName, 1);
+	if (request == NULL || durableWriteName(fileName, request->fileName) != SUCCESS)
+	{
+		trackedFree(fileData);
+		trackedFree(request);
+		return FAILURE;
+	}
+	request->data = fileData;
+	request->size = fileSize;
+	gIoWriteRing[(gIoWriteHead + gIoWriteCount) % gIoQueueDepth] = request;
+	gIoWriteCount++;
+	ioStart(request);
+	return status;
+} // ioSubmitWrite
+
+int ioDrain()
+{
+	int failed = 0;
+	while (gIoWriteCount > 0)
+	{
+		if (ioRetireWrite() != SUCCESS) failed++;
+	}
+	return failed;
+} // ioDrain
+
+void ioShutdown()
+{
+	ioDrain();
+	if (gIoWorkers != NULL)
+	{
+		{
+			std::lock_guard<std::mutex> lock(gIoLock);
+			gIoStopping = 1;
+		}
+		gIoWorkReady.notify_all();
+		for (int i = 0; i < gIoNumWorkers; i++)
+		{
+			gIoWorkers[i].join();
+		}
+		delete[] gIoWorkers;
+		gIoWorkers = NULL;
+	}
+	trackedFree(gIoWriteRing);
+	gIoWriteRing = NULL;
+} // ioShutdown
+
+const char* ioBackendName()
+{
+	if (gIoBackend == IO_BACKEND_OVERLAPPED) return "overlapped";
+	if (gIoBackend == IO_BACKEND_THREADS) return "threads";
+	return "none";
+} // ioBackendName
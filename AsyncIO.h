@@ -0,0 +1,113 @@
+// Asynchronous I/O Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Keeps several whole-file reads and writes in flight so that batch runs
+// can load the next covers from disk while the current one is classified.
+//
+
+#pragma once
+
+#include <windows.h>
+
+#define IO_BACKEND_OVERLAPPED	1	// Windows overlapped ReadFile/WriteFile
+#define IO_BACKEND_THREADS		2	// worker threads doing blocking fread/fwrite
+
+#define IO_DEFAULT_QUEUE_DEPTH	4
+
+/*
+* Structure: ioRequest
+* Usage: ioRequest* request = ioSubmitRead(fileName);
+* ------------------------------------------------------
+* This structure holds one whole-file read or write that
+* has been handed to the I/O backend. The caller only
+* keeps the pointer and waits on it, the backend owns
+* the rest of the fields until the request completes.
+*/
+struct ioRequest
+{
+    char fileName[MAX_PATH];
+    unsigned char* data;   // file contents (read) or bytes to write (write)
+    unsigned int size;     // bytes in data
+    int isWrite;           // 0 = read, 1 = write
+    int status;            // SUCCESS or FAILURE once complete
+    volatile long done;    // set to 1 by the backend when the request finished
+    HANDLE hFile;          // overlapped backend only
+    OVERLAPPED overlapped; // overlapped backend only
+    ioRequest* next;       // thread backend work queue link
+    int traceImage;        // image id of the trace events, writes only
+};  // ioRequest
+
+/*
+* Function: ioInit
+* Usage: backend = ioInit(IO_BACKEND_OVERLAPPED, queueDepth);
+* ------------------------------------------------------
+* This function starts the I/O backend. queueDepth is the
+* number of reads and the number of writes that may be in
+* flight at once. If the requested backend is not usable
+* the thread pool is used instead; the backend actually
+* in use is returned.
+*/
+int ioInit(int backend, int queueDepth);
+
+/*
+* Function: ioSubmitRead
+* Usage: ioRequest* request = ioSubmitRead(fileName);
+* ------------------------------------------------------
+* This function queues a read of the whole file and
+* returns immediately. The contents are collected with
+* ioWaitRead. Returns NULL if the read could not be
+* queued, which ioWaitRead takes as a failed read.
+*/
+ioRequest* ioSubmitRead(char* fileName);
+
+/*
+* Function: ioWaitRead
+* Usage: fileData = ioWaitRead(request, &fileSize);
+* ------------------------------------------------------
+* This function waits for a read queued by ioSubmitRead,
+* releases the request and returns the file contents,
+* or NULL if the file could not be read. The contents
+* are released with trackedFree.
+*/
+unsigned char* ioWaitRead(ioRequest* request, unsigned int* fileSize);
+
+/*
+* Function: ioSubmitWrite
+* Usage: ioSubmitWrite(fileName, fileData, fileSize);
+* ------------------------------------------------------
+* This function queues a write of fileSize bytes to
+* fileName. The I/O layer takes ownership of fileData,
+* which must come from trackedMalloc, and frees it once
+* written. If queueDepth writes are already
+* in flight the oldest one is waited on first. Returns
+* FAILURE if that write failed or this one could not be
+* queued, when fileData is freed unwritten.
+*/
+int ioSubmitWrite(char* fileName, unsigned char* fileData, unsigned int fileSize);
+
+/*
+* Function: ioDrain
+* Usage: failedWrites = ioDrain();
+* ------------------------------------------------------
+* This function waits for every outstanding write and
+* returns how many of them failed.
+*/
+int ioDrain();
+
+/*
+* Function: ioShutdown
+* Usage: ioShutdown();
+* ------------------------------------------------------
+* This function drains the outstanding writes and stops
+* the backend worker threads.
+*/
+void ioShutdown();
+
+/*
+* Function: ioBackendName
+* Usage: printf("%s", ioBackendName());
+* ------------------------------------------------------
+* This function returns a printable name for the backend
+* selected by ioInit.
+*/
+const char* ioBackendName();
@@ -23,161 +23,902 @@
 //
 
 
+#include <bit>
+#include <climits>
 #include "BitmapReader.h"
+#include "BandMemo.h"
+#include "MemStats.h"
+#include "Trace.h"
+#include "BitPlane.h"
+#include "BlockSlice.h"
+#include "Kernels.h"
+#include "Pipeline.h"
+#include "Request.h"
+#include "BDPPRandom.h"
+
+// hiding positions for every 9-bit block pattern, built by initBlockPositions
+blockPositions gBlockPositions[512];
+
+// outcome of the BDPP checks on a block, the first check it fails
+#define BLOCK_EMBEDDABLE		0
+#define BLOCK_RATIO_FAILURE		1
+#define BLOCK_HVD_FAILURE		2
+#define BLOCK_FLIP_FAILURE		3
+
+// the checks depend on the 9 pixels of a block alone, so they are run once per pattern
+struct blockClass
+{
+	unsigned char outcome;        // BLOCK_EMBEDDABLE ... BLOCK_FLIP_FAILURE
+	unsigned char uniqueRatios;   // unique ratios of the block as read
+};  // blockClass
+
+static blockClass gBlockClasses[512];
+
+// the bits every embeddable pattern carries, 0 if they differ, so a capacity count can add up whole words of blocks
+static int gEmbeddableBlockBits;
+
+// a row's three pixels come out of the packed byte left pixel first, patterns keep it in bit 0
+static const int gReverse3[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+// candidate hiding positions in the order they are tried, the middle pixel always comes first
+// position = row * 3 + column, row 0 being the bottom row of the block
+static const int gCandidatePositions[9] = { 4, 1, 7, 3, 5, 0, 2, 6, 8 };
+
+// runs the BDPP checks on a block pattern as the reference implementation does, bit (k * 3 + l) of pattern
+// is matrix[k][l]. embedData adds the flipped block's ratios to the count, so it is taken before
+static blockClass classifyPattern(int pattern)
+{
+	blockClass result;
+	blockInfo block;
+	block.blockNumber = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		for (int l = 0; l < 3; l++)
+		{
+			block.matrix[k][l] = (pattern >> (k * 3 + l)) & 1;
+		}
+	}
+	diagonalPartition(&block, 0);
+	result.uniqueRatios = (unsigned char)block.currentBlockRatios.totalUniqueRatios;
+	result.outcome = BLOCK_RATIO_FAILURE;
+	if (!block.ratioCheck) return result;
+	connectivityTest(&block, 0);
+	result.outcome = BLOCK_HVD_FAILURE;
+	if (!block.hvdCheck) return result;
+	embedData(&block, 0);
+	result.outcome = block.isEmbeddable ? BLOCK_EMBEDDABLE : BLOCK_FLIP_FAILURE;
+	return result;
+} // classifyPattern
+
+// calls check(q) for every pattern q that equals pattern outside mask, stops at the first 0
+template<typename Check>
+static int allInSubcube(int pattern, int mask, Check check)
+{
+	int sub = mask;
+	for (;;)
+	{
+		if (!check((pattern & ~mask) | sub)) return 0;
+		if (sub == 0) return 1;
+		sub = (sub - 1) & mask;
+	}
+} // allInSubcube
+
+
+/*
+* Function: initBlockPositions
+* Usage: initBlockPositions(gNumBits2Hide);
+* ------------------------------------------------------
+* This function builds the table of hiding positions
+* for every 9-bit block pattern. The embeddable patterns
+* are split into groups that differ only in the hiding
+* positions of the group, and every pattern of a group
+* is embeddable. Whatever bits are hidden the stego block
+* stays in the same group, so the extractor looks up the
+* same positions in the same table.
+*/
+void initBlockPositions(int bitsPerBlock)
+{
+	int embeddable[512], assigned[512];
+
+	for (int pattern = 0; pattern < 512; pattern++)
+	{
+		gBlockClasses[pattern] = classifyPattern(pattern);
+		embeddable[pattern] = gBlockClasses[pattern].outcome == BLOCK_EMBEDDABLE;
+		assigned[pattern] = 0;
+		gBlockPositions[pattern].count = 0;
+	}
+
+	// patterns are grouped in a fixed order, starting each group from the middle pixel and adding
+	// the next candidate position only if every pattern it reaches is embeddable and not yet grouped
+	for (int pattern = 0; pattern < 512; pattern++)
+	{
+		if (!embeddable[pattern] || assigned[pattern]) continue;
+
+		auto usable = [&](int q) { return embeddable[q] && !assigned[q]; };
+		int positions[9], count = 0, mask = 0;
+		for (int c = 0; c < 9 && count < bitsPerBlock; c++)
+		{
+			int candidate = gCandidatePositions[c];
+			if (allInSubcube(pattern, mask | (1 << candidate), usable))
+			{
+				mask |= 1 << candidate;
+				positions[count++] = candidate;
+			}
+			else if (c == 0)
+			{
+				break;  // the middle pixel cannot be used, the block carries nothing
+			}
+		}
+
+		allInSubcube(pattern, mask, [&](int q)
+		{
+			assigned[q] = 1;
+			gBlockPositions[q].count = count;
+			memcpy(gBlockPositions[q].position, positions, sizeof(int) * count);
+			return 1;
+		});
+	}
+
+	gEmbeddableBlockBits = -1;
+	for (int pattern = 0; pattern < 512; pattern++)
+	{
+		if (!embeddable[pattern]) continue;
+		if (gEmbeddableBlockBits == -1) gEmbeddableBlockBits = gBlockPositions[pattern].count;
+		else if (gEmbeddableBlockBits != gBlockPositions[pattern].count) gEmbeddableBlockBits = 0;
+	}
+	if (gEmbeddableBlockBits == -1) gEmbeddableBlockBits = 0;
+	return;
+} // initBlockPositions
+
 
 /*
 * Function: parsePixelData
-* Usage: parsePixelData(pFileInfo, pixelData, msgPixelData, gMsgFileSize, extractedBits, gKey, action);
+* Usage: parsePixelData(&image, msgPixelData, gMsgFileSize, extractedBits, gKey, action, &request);
 * ------------------------------------------------------
 * This function is used to parse the pixel data from the
 * image run the BDPP algorithm to embed or extract data
 * and then reassamble the pixel data to be written back,
-* or to be used for extraction.
+* or to be used for extraction. An 8-bit grayscale image
+* is hidden in and extracted from its least significant
+* bit-plane. A request that stops early returns FAILURE
+* with the reason in request, and a hide may then have
+* changed some of the pixels.
 */
-void parsePixelData(BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData,
-	unsigned char* msgPixelData, unsigned int* gMsgFileSize, unsigned char* extractedBits, int gKey, int action)
+int parsePixelData(imageView* image, unsigned char* msgPixelData, unsigned int* gMsgFileSize,
+	unsigned char* extractedBits, int gKey, int action, requestContext* request)
 {
-	// stor information about the image, to measure the size and block capacity
-	unsigned int numberOfPixels = pFileInfo->biWidth * pFileInfo->biHeight;
-	unsigned int imageSize = pFileInfo->biSizeImage;
-	unsigned char* bitsInImage;
-	bitsInImage = (unsigned char*)malloc(sizeof(unsigned char) * numberOfPixels);
-	unsigned char* bitsInMsg;
-	bitsInMsg = (unsigned char*)malloc(sizeof(unsigned char) * numberOfPixels);
+	pixelWork work;
 
-	// This loop checks every byte in the pixel data and stores the bits, in little endian order 7 -> 0
-	int bitCounter = 0;
-	for (int i = 0; i < imageSize; i++)
+	if (startPixelData(&work, image, msgPixelData, *gMsgFileSize, extractedBits, gKey, action, request) != SUCCESS)
 	{
-		for (int j = 7; j >= 0; j--)
+		return FAILURE;
+	}
+	return finishPixelData(&work, continuePixelData(&work, INT_MAX));
+} // parsePixelData
+
+
+/*
+* Function: startPixelData
+* Usage: startPixelData(&work, &image, msgPixelData, msgBits, extractedBits, gKey, action, &request);
+* ------------------------------------------------------
+* This function sets up the hide or extract of an image
+* held in memory without processing any of it, so the
+* bands can be run a few at a time with
+* continuePixelData. An 8-bit image has its bit-plane
+* packed here. Returns FAILURE, with the request failed,
+* if the work could not be set up.
+*/
+int startPixelData(pixelWork* work, imageView* image, unsigned char* msgPixelData, unsigned int msgBits,
+	unsigned char* extractedBits, int gKey, int action, requestContext* request)
+{
+	work->image = *image;
+	work->bands = *image;
+	work->plane = NULL;
+	work->nextBlockRow = 0;
+
+	// 8-bit covers: the bit-plane is packed into 1-bit rows and the BDPP runs on those
+	if (image->bitsPerPixel == 8)
+	{
+		work->plane = packLsbPlane(image);
+		if (work->plane == NULL)
 		{
-			unsigned char currentBit = ((*(pixelData + i) >> j) & 1);
-			bitsInImage[bitCounter] = currentBit;
-			bitCounter++;
+			printf("Error - Could not allocate memory for the bit-plane.\n\n");
+			failRequest(request);
+			return FAILURE;
 		}
+		initRowsView(&work->bands, work->plane, bitmapRowSize(image->width, 1), image->width, image->height, 1);
 	}
 
+	// the image is processed in bands so the request is looked at as it goes, the pipeline
+	// (-pipeline) feeds the same bands as the rows come off the disk
+	if (initBandState(&work->state, image, msgPixelData, msgBits, extractedBits, gKey, action) != SUCCESS)
+	{
+		failRequest(request);
+		trackedFree(work->plane);
+		return FAILURE;
+	}
+	work->state.request = request;
+	setRequestBands(request, countBands(&work->state));
+	return SUCCESS;
+} // startPixelData
+
+
+/*
+* Function: continuePixelData
+* Usage: status = continuePixelData(&work, 1);
+* ------------------------------------------------------
+* This function processes up to maxBands more bands of
+* started work. Returns FAILURE as soon as its request
+* stops or a band fails.
+*/
+int continuePixelData(pixelWork* work, int maxBands)
+{
+	return processBandsFrom(&work->state, &work->bands, &work->nextBlockRow, maxBands);
+} // continuePixelData
+
+
+/*
+* Function: isPixelDataDone
+* Usage: while (!isPixelDataDone(&work)) ...
+* ------------------------------------------------------
+* This function returns 1 once every band the work needs
+* has been processed.
+*/
+int isPixelDataDone(pixelWork* work)
+{
+	return work->nextBlockRow >= work->state.blockHeight;
+} // isPixelDataDone
+
+
+/*
+* Function: finishPixelData
+* Usage: finishPixelData(&work, status);
+* ------------------------------------------------------
+* This function ends started work. After a status of
+* SUCCESS the bit-plane of an 8-bit cover is put back and
+* the outcome printed as parsePixelData prints it, and
+* that is returned. Otherwise, or if there is no memory
+* to put the bit-plane back, what the work holds is
+* released and FAILURE returned.
+*/
+int finishPixelData(pixelWork* work, int status)
+{
+	if (status != SUCCESS)
+	{
+		releasePixelData(work);
+		return FAILURE;
+	}
+
+	if (work->plane != NULL)
+	{
+		// a plane that cannot be put back leaves the cover as it was, so the hide fails
+		int changed = work->state.action == ACTION_HIDE ? scatterLsbPlane(work->plane, &work->image) : 0;
+		if (changed == FAILURE)
+		{
+			failRequest(work->state.request);
+			releasePixelData(work);
+			return FAILURE;
+		}
+		if (work->state.action == ACTION_HIDE) printf("Bit-Plane Pixels Changed: %d\n", changed);
+		trackedFree(work->plane);
+	}
+	return reportBandResults(&work->state);
+} // finishPixelData
+
+
+/*
+* Function: releasePixelData
+* Usage: releasePixelData(&work);
+* ------------------------------------------------------
+* This function ends started work without printing or
+* putting anything back, releasing what it holds. The
+* request ring reads the outcome from the state itself.
+*/
+void releasePixelData(pixelWork* work)
+{
+	freeAnalysis(work->state.analysis);
+	work->state.analysis = NULL;
+	trackedFree(work->plane);
+	work->plane = NULL;
+	return;
+} // releasePixelData
+
+
+/*
+* Function: initBandState
+* Usage: initBandState(&state, &image, msgPixelData, msgBits, extractedBits, gKey, action);
+* ------------------------------------------------------
+* This function sets up the state that carries the
+* message position and the block counts from one band
+* of the image to the next. Returns FAILURE if the
+* -analysis counts could not be allocated.
+*/
+int initBandState(bandState* state, const imageView* image, unsigned char* msgPixelData,
+	unsigned int msgBits, unsigned char* extractedBits, int gKey, int action)
+{
 	// the blocks calculated here are used in most checks, as ensuring every block is reachable is important
-	int blockHeight = floor(pFileInfo->biHeight / 3);
-	int blockWidth = floor(pFileInfo->biWidth / 3);
-	int totalPossibleBlocks = blockWidth * blockHeight;
+	state->action = action;
+	state->width = image->width;
+	state->blockWidth = image->width / 3;
+	state->blockHeight = image->height / 3;
+	state->totalPossibleBlocks = state->blockWidth * state->blockHeight;
+	state->msgPixelData = msgPixelData;
+	state->totalMsgBits = msgBits;
+	state->extractedBits = extractedBits;
+	state->key = gKey;
+	state->bitIndex = 0;
+	state->embeddableBlocks = 0;
+	state->capacityBits = 0;
+	state->blocksUsed = 0;
+	state->blocksClassified = 0;
+	state->blocksSkipped = 0;
+	state->kernel = gKernels->kernel;
+	state->blocksRemembered = 0;
+	state->memoLookups = 0;
+	state->memoHits = 0;
+	state->fullCapacity = gFullCapacity;
+	state->verify = gVerify;
+	state->verifiedBlocks = 0;
+	state->verifyFailures = 0;
+	state->streamChecksum = 0xFFFFFFFF;
+	state->traceImage = gTraceOn ? startTraceImage() : TRACE_NO_ID;
+	state->request = NULL;
 
-	// create an array to be used the information of each block that is tested through the BDPP algorithm
-	blockInfo* blockArray;
-	blockArray = (blockInfo*)malloc(sizeof(blockInfo) * totalPossibleBlocks);
+	// -analysis keeps classifying after the message is placed or extracted so every block is counted
+	state->analysis = NULL;
+	if (gAnalysisPathFileName[0] != 0 && (action == ACTION_HIDE || action == ACTION_EXTRACT))
+	{
+		state->analysis = createAnalysis(state->blockWidth, state->blockHeight, gAnalysisTile);
+		if (state->analysis == NULL)
+		{
+			printf("Error - could not allocate the classifier analysis.\n\n");
+			return FAILURE;
+		}
+		state->analysis->skipsUniform = state->kernel == KERNEL_TABLE;
+	}
 
+	// -memo remembers rows of blocks by their pixels, -analysis needs every block classified so it goes without
+	state->memo = isBandMemoOn() && state->analysis == NULL;
 
-	// This loop is a bit complicated, however what it is essentially doing is parsing through the pixel data
-	// as if it were a coordinate greed so that it can generate the blocks
-	// the blocks are generated in from the bottom to the top, storing the 3 bits from a row
-	// then moving to the next row and storing the 3 bits from that row. Doing that 3 times, and going back
-	// to the first row and moving to the next block. This is done until all blocks are generated. 
-	// NOTE: the paper originally had the blocks generated from the top to the bottom, but I did not realize
-	// until I had alread implemented most of the code.
-	// eg. 
-	// the matrix will look like this:
-	// 0 1 0 <- pixels 2048 2049 2050
-	// 0 1 1 <- pixels 1024 1025 1026
-	// 1 1 0 <- pixels 0    1    2
-	bitCounter = 0;
-	int multiplier = 0;
-	int breakingpoint = 0;
-	size_t rowSize = ((pFileInfo->biWidth + 7) / 8 + 3) & ~3;
-	for (int i = 0; i < blockHeight; i++)
+	// with -permute the block order is derived from the permutation seed and the key, a hide uses
+	// the message size since that becomes its key
+	state->permuted = gPermute && (action == ACTION_HIDE || action == ACTION_EXTRACT);
+	if (state->permuted)
 	{
-		for (int j = 0; j < blockWidth; j++)
+		uint64_t key = action == ACTION_HIDE ? msgBits : (unsigned int)gKey;
+		initBlockPermutation(&state->permutation, state->totalPossibleBlocks, gPermuteSeed ^ (key * 0x9E3779B97F4A7C15ULL));
+	}
+	return SUCCESS;
+} // initBandState
+
+
+// an extraction is done once the key's bits are recovered, a hide once the last message bit is
+// placed unless the full capacity was asked for, the capacity counts never stop early
+static inline int isBandStateDone(bandState* state)
+{
+	if (state->analysis != NULL) return 0;
+	if (state->action == ACTION_EXTRACT) return state->bitIndex >= (unsigned int)state->key;
+	if (state->action == ACTION_HIDE) return !state->fullCapacity && state->bitIndex >= state->totalMsgBits;
+	return 0;
+} // isBandStateDone
+
+// adds one bit to a CRC-32 (the zip polynomial, reflected), used to checksum the hidden bit stream
+static inline unsigned int crc32Bit(unsigned int crc, int bit)
+{
+	return (crc >> 1) ^ (0xEDB88320u & (0u - ((crc ^ (unsigned int)bit) & 1u)));
+} // crc32Bit
+
+// reads the 9 pixels of a block straight from the packed rows, bit (k * 3 + l) is row k, column l
+// blockX and blockY are the pixel coordinates of the bottom left pixel of the block in the band
+static inline int readBlockPattern(imageView* band, int blockX, int blockY)
+{
+	int bit = band->bitOffset + blockX;
+	int shift = 13 - bit % 8;  // the block's pixels are bits shift + 2 down to shift of the row's next 16 pixels
+	int pattern = 0;
+
+	for (int k = 0; k < 3; k++)
+	{
+		unsigned char* row = imageRow(band, blockY + k) + bit / 8;
+		unsigned int pixels = row[0] << 8;
+		if (shift < 8) pixels |= row[1];  // the block runs into the next byte
+		pattern |= gReverse3[(pixels >> shift) & 7] << (k * 3);
+	}
+	return pattern;
+} // readBlockPattern
+
+// -analysis: counts the first check a classified block failed and adds the embeddable ones to their tile
+static inline void recordAnalysis(classifierAnalysis* analysis, int pattern, int blockNumber)
+{
+	blockClass* result = &gBlockClasses[pattern];
+	analysis->uniqueRatios[result->uniqueRatios]++;
+	if (result->outcome == BLOCK_RATIO_FAILURE) analysis->ratioFailures++;
+	else if (result->outcome == BLOCK_HVD_FAILURE) analysis->hvdFailures++;
+	else if (result->outcome == BLOCK_FLIP_FAILURE) analysis->flipFailures++;
+	else
+	{
+		int tileX = (blockNumber % analysis->blockWidth) / analysis->tileBlocks;
+		int tileY = (blockNumber / analysis->blockWidth) / analysis->tileBlocks;
+		analysis->embeddable++;
+		analysis->tileCounts[tileY * analysis->gridWidth + tileX]++;
+	}
+} // recordAnalysis
+
+// -verify: reads back a block a hide has just written while it is still in cache, checks it is still
+// embeddable with the same hiding positions and holds the intended bits, and checksums those bits
+static void verifyBlock(bandState* state, imageView* band, int blockX, int blockY, blockPositions* positions,
+	unsigned int firstBit)
+{
+	int pattern = readBlockPattern(band, blockX, blockY);
+	int passed = gBlockClasses[pattern].outcome == BLOCK_EMBEDDABLE;
+
+	blockPositions* stegoPositions = &gBlockPositions[pattern];
+	if (stegoPositions->count != positions->count
+		|| memcmp(stegoPositions->position, positions->position, sizeof(int) * positions->count) != 0)
+	{
+		passed = 0;
+	}
+
+	for (unsigned int msgBit = firstBit; msgBit < state->bitIndex; msgBit++)
+	{
+		int storedBit = (pattern >> positions->position[msgBit - firstBit]) & 1;
+		if (storedBit != ((state->msgPixelData[msgBit / 8] >> (7 - (msgBit % 8))) & 1)) passed = 0;
+		state->streamChecksum = crc32Bit(state->streamChecksum, storedBit);
+	}
+
+	state->verifiedBlocks++;
+	if (!passed) state->verifyFailures++;
+} // verifyBlock
+
+// counts an embeddable block and embeds or extracts its bits, pattern is the block as read before the checks
+// blockX and blockY are the pixel coordinates of the bottom left pixel of the block in the band
+static void useEmbeddableBlock(bandState* state, imageView* band, int blockX, int blockY, int pattern)
+{
+	state->embeddableBlocks++;
+
+	// the table gives the pixels of this block that carry bits, the middle pixel first
+	// with one bit per block that is the middle pixel alone
+	blockPositions* positions = &gBlockPositions[pattern];
+	state->capacityBits += positions->count;
+
+	if (state->action == ACTION_HIDE)
+	{
+		// put the next message bits in the hiding positions, only those pixels of the block can change
+		// blocks left over once the message is placed are not touched
+		if (state->bitIndex >= state->totalMsgBits || positions->count == 0) return;
+		state->blocksUsed++;
+
+		unsigned int firstBit = state->bitIndex;
+		for (int b = 0; b < positions->count && state->bitIndex < state->totalMsgBits; b++)
 		{
-			blockInfo currentBlock;
-			currentBlock.blockNumber = i * blockWidth + j;
-			int blockX = j * 3;
-			int blockY = i * 3;
-			bitCounter = blockY * pFileInfo->biWidth;
+			unsigned int msgBit = state->bitIndex++;
+			unsigned char currentBit = (state->msgPixelData[msgBit / 8] >> (7 - (msgBit % 8))) & 1;
+			int px = band->bitOffset + blockX + positions->position[b] % 3;
+			int py = blockY + positions->position[b] / 3;
+			unsigned char* currentPixel = imageRow(band, py) + px / 8;
+			size_t bitIndex = 7 - (px % 8);
+			if (currentBit == 1)
+			{
+				*currentPixel |= (1 << bitIndex);
+			}
+			else
+			{
+				*currentPixel &= ~(1 << bitIndex);
+			}
+		}
+
+		if (state->verify) verifyBlock(state, band, blockX, blockY, positions, firstBit);
+	}
+	else if (state->action == ACTION_EXTRACT)
+	{
+		// read the hidden bits from the block as it was stored, embedData has flipped the middle pixel
+		if (state->bitIndex >= state->key || positions->count == 0) return;
+		state->blocksUsed++;
 
-			for (int k = 2; k >= 0; k--)
+		for (int b = 0; b < positions->count && state->bitIndex < state->key; b++)
+		{
+			state->extractedBits[state->bitIndex++] = (pattern >> positions->position[b]) & 1;
+			if (state->verify) state->streamChecksum = crc32Bit(state->streamChecksum, (pattern >> positions->position[b]) & 1);
+		}
+	}
+	return;
+} // useEmbeddableBlock
+
+// runs the BDPP checks on one block and embeds or extracts its bits if it is embeddable, returns 1 if it is
+// blockX and blockY are the pixel coordinates of the bottom left pixel of the block in the band
+static int processBlock(bandState* state, imageView* band, int blockNumber, int blockX, int blockY)
+{
+	int pattern = readBlockPattern(band, blockX, blockY);
+
+	// This is where the BDPP algorithm is done on the block, looked up by its pattern
+	// the count of embeddable blocks will determine our hiding capacity
+	if (state->analysis != NULL) recordAnalysis(state->analysis, pattern, blockNumber);
+	if (gBlockClasses[pattern].outcome != BLOCK_EMBEDDABLE) return 0;
+	useEmbeddableBlock(state, band, blockX, blockY, pattern);
+	return 1;
+} // processBlock
+
+// returns 1 if the 64 pixels starting at byte wordByte are all 0 or all 1 on all three rows of a block row,
+// every block inside them is then uniform and has a single unique ratio, so it can never be embeddable
+static inline int isUniformWord(unsigned char* blockRow, ptrdiff_t stride, size_t wordByte)
+{
+	uint64_t row0, row1, row2;
+	memcpy(&row0, blockRow + wordByte, sizeof(row0));
+	memcpy(&row1, blockRow + stride + wordByte, sizeof(row1));
+	memcpy(&row2, blockRow + 2 * stride + wordByte, sizeof(row2));
+	return row0 == row1 && row0 == row2 && (row0 == 0 || row0 == ~(uint64_t)0);
+} // isUniformWord
+
+// classifies the blocks of row i of the band, blockRowNumber in the image, and sets the bits of the embeddable
+// ones in embeddableBits if it is not NULL. Returns 1 if the whole row was classified
+static int classifyBlockRow(bandState* state, imageView* band, int blockRowNumber, int i, uint64_t* embeddableBits)
+{
+	unsigned char* blockRow = imageRow(band, i * 3);
+	int checkedWord = -1;  // last 64 pixel word tested for uniform pixels, it was not uniform
+	size_t rowBytes = bitmapRowSize(band->bitOffset + band->width, 1);  // bytes of a row that can be read as words
+
+	for (int j = 0; j < state->blockWidth; j++)
+	{
+		// the remaining blocks are not classified once the work is done, they are left as they are
+		if (isBandStateDone(state)) return 0;
+
+		// white margins and solid areas are skipped 64 pixels at a time, only the blocks that
+		// lie wholly inside the word are skipped, the ones across two words go through the checks
+		int word = (band->bitOffset + j * 3) / 64;
+		int lastBlockInWord = (word * 64 + 61 - band->bitOffset) / 3;
+		if (word != checkedWord && j <= lastBlockInWord && (size_t)(word + 1) * 8 <= rowBytes)
+		{
+			if (isUniformWord(blockRow, band->stride, (size_t)word * 8))
 			{
-				for (int l = 0; l < 3; l++)
+				if (lastBlockInWord >= state->blockWidth) lastBlockInWord = state->blockWidth - 1;
+				state->blocksSkipped += lastBlockInWord - j + 1;
+				if (state->analysis != NULL)
 				{
-					int pixelX = blockX + l;
-					int pixelY = blockY + k;
-					size_t currentPixelIndex = (pixelY * rowSize) + (pixelX / 8);
-					size_t bitIndex = 7 - (pixelX % 8);
-					if (bitCounter + pFileInfo->biWidth * multiplier >= numberOfPixels)
-					{
-						breakingpoint = 1;
-						break;
-					}
-
-					currentBlock.matrix[k][l] = (pixelData[currentPixelIndex] & (1 << bitIndex)) ? 1 : 0;
-					bitCounter++;
+					// a uniform block has a single unique ratio and fails the ratio check
+					state->analysis->uniformSkipped += lastBlockInWord - j + 1;
+					state->analysis->uniqueRatios[1] += lastBlockInWord - j + 1;
+					state->analysis->ratioFailures += lastBlockInWord - j + 1;
 				}
-				if (breakingpoint) break;
-				bitCounter = bitCounter - 3;
-				multiplier++;
+				j = lastBlockInWord;
+				continue;
+			}
+			checkedWord = word;
+		}
+		state->blocksClassified++;
+
+		if (processBlock(state, band, blockRowNumber * state->blockWidth + j, j * 3, i * 3) && embeddableBits != NULL)
+		{
+			embeddableBits[j / 64] |= (uint64_t)1 << (j % 64);
+		}
+	}
+	return 1;
+} // classifyBlockRow
+
+// a capacity count that does not look at the blocks themselves adds up the embeddable blocks of a word of them
+// with one popcount, returns 0 if they have to be visited one at a time
+static inline int countEmbeddableWord(bandState* state, uint64_t embeddable)
+{
+	if (state->action != ACTION_ESTIMATE || state->analysis != NULL || gEmbeddableBlockBits == 0) return 0;
+	int blocks = std::popcount(embeddable);
+	state->embeddableBlocks += blocks;
+	state->capacityBits += blocks * gEmbeddableBlockBits;
+	return 1;
+} // countEmbeddableWord
+
+// -analysis: adds up the outcomes of the blocks of a slice set in lanes, as recordAnalysis does one block at a time
+static void recordSliceAnalysis(classifierAnalysis* analysis, blockSlice* slice, uint64_t lanes, int firstBlockNumber)
+{
+	analysis->uniqueRatios[1] += std::popcount(lanes & ~slice->uniqueHigh & ~slice->uniqueLow);
+	analysis->uniqueRatios[2] += std::popcount(lanes & ~slice->uniqueHigh & slice->uniqueLow);
+	analysis->uniqueRatios[3] += std::popcount(lanes & slice->uniqueHigh & ~slice->uniqueLow);
+	analysis->uniqueRatios[4] += std::popcount(lanes & slice->uniqueHigh & slice->uniqueLow);
+	analysis->ratioFailures += std::popcount(lanes & slice->ratioFailures);
+	analysis->hvdFailures += std::popcount(lanes & slice->hvdFailures);
+	analysis->flipFailures += std::popcount(lanes & slice->flipFailures);
+	for (uint64_t bits = lanes & slice->embeddable; bits != 0; bits &= bits - 1)
+	{
+		int blockNumber = firstBlockNumber + std::countr_zero(bits);
+		int tileX = (blockNumber % analysis->blockWidth) / analysis->tileBlocks;
+		int tileY = (blockNumber / analysis->blockWidth) / analysis->tileBlocks;
+		analysis->embeddable++;
+		analysis->tileCounts[tileY * analysis->gridWidth + tileX]++;
+	}
+} // recordSliceAnalysis
 
+// every kernel but -kernel table: gathers and classifies the blocks of row i of the band with the bit-sliced
+// kernels in use, then embeds or extracts in the embeddable ones in order. Uniform words need no skipping, they
+// cost the same as any other. Same results and return value as classifyBlockRow
+static int classifySlicedBlockRow(bandState* state, imageView* band, int blockRowNumber, int i, uint64_t* embeddableBits, sliceRow* row)
+{
+	blockSlice slice;
+
+	if (isBandStateDone(state)) return 0;
+	gKernels->loadSliceRow(band, i * 3, row);
+	gKernels->classifySliceRow(row);
+
+	for (int first = 0; first < state->blockWidth; first += SLICE_BLOCKS)
+	{
+		int count = state->blockWidth - first < SLICE_BLOCKS ? state->blockWidth - first : SLICE_BLOCKS;
+		uint64_t lanes = count == SLICE_BLOCKS ? ~(uint64_t)0 : ((uint64_t)1 << count) - 1;
+		getBlockSlice(row, first / SLICE_BLOCKS, &slice);
+		if (state->analysis != NULL) recordSliceAnalysis(state->analysis, &slice, lanes, blockRowNumber * state->blockWidth + first);
+
+		uint64_t embeddable = slice.embeddable & lanes;
+		if (embeddableBits != NULL) embeddableBits[first / 64] |= embeddable;
+		if (countEmbeddableWord(state, embeddable))
+		{
+			state->blocksClassified += count;
+			continue;
+		}
+		for (uint64_t bits = embeddable; bits != 0; bits &= bits - 1)
+		{
+			int j = first + std::countr_zero(bits);
+			useEmbeddableBlock(state, band, j * 3, i * 3, readBlockPattern(band, j * 3, i * 3));
+
+			// the blocks after the one that finished the work are left as they are, as one at a time
+			if (isBandStateDone(state) && j + 1 < state->blockWidth)
+			{
+				state->blocksClassified += j - first + 1;
+				return 0;
 			}
-			if (breakingpoint) break;
-			blockArray[i * blockWidth + j] = currentBlock;
-			bitCounter = (i * 3 + 3) * pFileInfo->biWidth;
-			multiplier = 0;
+		}
+		state->blocksClassified += count;
+	}
+	return 1;
+} // classifySlicedBlockRow
 
+// visits only the embeddable blocks of a row the memo remembers, the others need no checks
+static void useRememberedRow(bandState* state, imageView* band, int i, uint64_t* embeddableBits)
+{
+	for (int w = 0; w < (state->blockWidth + 63) / 64; w++)
+	{
+		if (countEmbeddableWord(state, embeddableBits[w])) continue;
+		for (uint64_t bits = embeddableBits[w]; bits != 0; bits &= bits - 1)
+		{
+			int j = w * 64 + std::countr_zero(bits);
+			if (isBandStateDone(state))
+			{
+				state->blocksRemembered += j;
+				return;
+			}
 
+			int pattern = readBlockPattern(band, j * 3, i * 3);
+			useEmbeddableBlock(state, band, j * 3, i * 3, pattern);
 		}
-		if (breakingpoint) break;
-	}  // end of block generation for loop
+	}
+	state->blocksRemembered += state->blockWidth;
+	return;
+} // useRememberedRow
 
-	// This is where the BDPP algorithm is done on the blocks
-	// the count of embeddable blocks will determine our hiding capacity
-	int embeddableBlocks = 0;
-	for (int i = 0; i < totalPossibleBlocks; i++)
+// generates and checks the blocks of a band, processBand wraps it in the trace events of the band
+// returns FAILURE if the band could not be processed or the request stopped in the middle of it
+static int processBandRows(bandState* state, imageView* band, int firstBlockRow, int numBlockRows)
+{
+	// This loop is parsing through the pixel data as if it were a coordinate grid so that
+	// it can generate the blocks. The blocks are generated from the bottom to the top,
+	// storing the 3 bits from a row then moving to the next row and storing the 3 bits
+	// from that row. Doing that 3 times, and going back to the first row and moving to
+	// the next block. This is done until all blocks of the band are generated.
+	// NOTE: the paper originally had the blocks generated from the top to the bottom, but I did not realize
+	// until I had alread implemented most of the code.
+	// eg.
+	// the matrix will look like this:
+	// 0 1 0 <- pixels 2048 2049 2050
+	// 0 1 1 <- pixels 1024 1025 1026
+	// 1 1 0 <- pixels 0    1    2
+	if (state->permuted)
 	{
-		diagonalPartition(&blockArray[i], blockArray[i].blockNumber);
-		if (!blockArray[i].ratioCheck) continue;
-		connectivityTest(&blockArray[i], blockArray[i].blockNumber);
-		if (!blockArray[i].hvdCheck) continue;
-		embedData(&blockArray[i], blockArray[i].blockNumber);
-		if (!blockArray[i].isEmbeddable) continue;
-		embeddableBlocks++;
+		// the bits go to the blocks in the key-derived order, which jumps all over the image,
+		// so the band must be the whole image. Each rank is mapped to its block on its own
+		if (firstBlockRow != 0 || numBlockRows != state->blockHeight)
+		{
+			printf("Error - the permuted block order needs the whole image at once.\n\n");
+			return FAILURE;
+		}
+		for (int rank = 0; rank < state->totalPossibleBlocks && !isBandStateDone(state); rank++)
+		{
+			// the whole image is one band, so the request is also looked at every so many blocks
+			if (rank % REQUEST_CHECK_BLOCKS == 0 && isRequestStopped(state->request)) return FAILURE;
+			int blockNumber = (int)permuteBlock(&state->permutation, rank);
+			state->blocksClassified++;
+			processBlock(state, band, blockNumber, (blockNumber % state->blockWidth) * 3, (blockNumber / state->blockWidth) * 3);
+		}
+		return SUCCESS;
 	}
 
+	// -memo: one bit per block of a row, the embeddable blocks found or remembered
+	// rows are hashed from a whole byte, a sub-rectangle starting inside a byte is always classified
+	int memo = state->memo && band->bitOffset % 8 == 0;
+	uint64_t* embeddableBits = NULL;
+	if (memo)
+	{
+		embeddableBits = (uint64_t*)trackedMalloc(((state->blockWidth + 63) / 64) * sizeof(uint64_t), MEM_SITE_BAND);
+		if (embeddableBits == NULL)
+		{
+			printf("Error - Could not allocate memory for the band memo bitset.\n\n");
+			return FAILURE;
+		}
+	}
 
-	unsigned int msgBitCounter = 0;
-	unsigned int totalMsgBits = 0;
-	unsigned char currentBit = 0;
-	size_t bitIndex = 0;
-	size_t currentPixelIndex = 0;
-	switch (action)
+	// rows are classified one block at a time or a row of slices at a time (-kernel)
+	sliceRow row = { 0, 0, NULL, NULL };
+	if (state->kernel != KERNEL_TABLE && allocSliceRow(&row, state->blockWidth) != SUCCESS)
 	{
-	case ACTION_HIDE:
+		printf("Error - Could not allocate memory for the band slices.\n\n");
+		trackedFree(embeddableBits);
+		return FAILURE;
+	}
+	auto classifyRow = [&](int i, uint64_t* bits) {
+		return state->kernel == KERNEL_TABLE ? classifyBlockRow(state, band, firstBlockRow + i, i, bits)
+			: classifySlicedBlockRow(state, band, firstBlockRow + i, i, bits, &row);
+	};
+
+	for (int i = 0; i < numBlockRows && !isBandStateDone(state); i++)
 	{
-		// This loop reads the message data and counts it, so it can be used to generate a key laters
-		msgBitCounter = 0;
-		for (int i = 0; i < *gMsgFileSize; i++)
+		if (memo)
 		{
-			for (int j = 7; j >= 0; j--)
+			uint64_t hash = hashBlockRow(imageRow(band, i * 3) + band->bitOffset / 8, band->stride, state->blockWidth);
+			state->memoLookups++;
+			if (lookupBandMemo(hash, state->blockWidth, embeddableBits))
+			{
+				state->memoHits++;
+				useRememberedRow(state, band, i, embeddableBits);
+				continue;
+			}
+			memset(embeddableBits, 0, ((state->blockWidth + 63) / 64) * sizeof(uint64_t));
+			if (classifyRow(i, embeddableBits))
 			{
-				unsigned char currentBit = ((*(msgPixelData + i) >> j) & 1);
-				bitsInMsg[msgBitCounter] = currentBit;
-				msgBitCounter++;
+				insertBandMemo(hash, state->blockWidth, embeddableBits);
 			}
+			continue;
 		}
-		totalMsgBits = msgBitCounter / 8;
+		classifyRow(i, NULL);
+	}  // end of block generation for loop
 
-		// This loop checks if a block is embeddable and puts the data in the middle pixel
-		// this occurs until either we run out of blocks, or we run out of message data
-		for (int i = 0; i < totalPossibleBlocks; i++)
-		{
-			blockInfo* currentBlock = &blockArray[i];
-			if (bitIndex >= totalMsgBits) break;
-			if (!currentBlock->isEmbeddable) continue;
+	freeSliceRow(&row);
+	trackedFree(embeddableBits);
+	return SUCCESS;
+} // processBandRows
+
+/*
+* Function: processBand
+* Usage: processBand(&state, &band, firstBlockRow, numBlockRows);
+* ------------------------------------------------------
+* This function generates the blocks of numBlockRows
+* rows of blocks, runs the BDPP checks on them and embeds
+* or extracts the message bits in the embeddable ones.
+* Row 0 of the band view is the first pixel row of the
+* band, its pixels are 1 bit each. Returns FAILURE if
+* the band could not be processed.
+*/
+int processBand(bandState* state, imageView* band, int firstBlockRow, int numBlockRows)
+{
+	// the blocks are generated, classified and embedded or extracted in one pass, so the band is one phase
+	const char* phase = state->action == ACTION_HIDE ? TRACE_EMBED
+		: state->action == ACTION_EXTRACT ? TRACE_EXTRACT : TRACE_CLASSIFY;
 
-			int blockNumber = currentBlock->blockNumber;
-			currentBit = bitsInMsg[bitIndex++]; // use bit before incrementing
-			currentBlock->matrix[1][1] = currentBit;
+	traceBegin(phase, state->traceImage, firstBlockRow);
+	int status = processBandRows(state, band, firstBlockRow, numBlockRows);
+	traceEnd(phase, state->traceImage, firstBlockRow);
+	if (status != SUCCESS) failRequest(state->request);
+	return status;
+} // processBand
+
+// rows of blocks in a band of an image held in memory, a permuted order jumps all over the image so it is one band
+static inline int bandBlockRows(bandState* state)
+{
+	return state->permuted ? state->blockHeight : PIPELINE_BAND_BLOCK_ROWS;
+} // bandBlockRows
+
+/*
+* Function: processBands
+* Usage: if (processBands(&state, &image) != SUCCESS) ...
+* ------------------------------------------------------
+* This function processes a whole image held in memory
+* in bands of PIPELINE_BAND_BLOCK_ROWS rows of blocks,
+* looking at the request of the state before each band.
+* Returns FAILURE as soon as the request stops or a band
+* fails, the request says which.
+*/
+int processBands(bandState* state, imageView* image)
+{
+	int nextBlockRow = 0;
+
+	setRequestBands(state->request, countBands(state));
+	return processBandsFrom(state, image, &nextBlockRow, INT_MAX);
+} // processBands
+
+/*
+* Function: countBands
+* Usage: setRequestBands(state->request, countBands(state));
+* ------------------------------------------------------
+* This function returns the bands processBands cuts an
+* image held in memory into.
+*/
+int countBands(bandState* state)
+{
+	int bandRows = bandBlockRows(state);
+	return bandRows > 0 ? (state->blockHeight + bandRows - 1) / bandRows : 0;
+} // countBands
+
+/*
+* Function: processBandsFrom
+* Usage: status = processBandsFrom(&state, &image, &nextBlockRow, maxBands);
+* ------------------------------------------------------
+* This function does the work of processBands for at
+* most maxBands bands, starting with the one at
+* nextBlockRow, and moves nextBlockRow past them. Once
+* the rest of the image is not needed nextBlockRow is
+* moved to the end.
+*/
+int processBandsFrom(bandState* state, imageView* image, int* nextBlockRow, int maxBands)
+{
+	int bandRows = bandBlockRows(state);
+
+	for (int bands = 0; bands < maxBands && *nextBlockRow < state->blockHeight; bands++)
+	{
+		int firstBlockRow = *nextBlockRow;
+		if (isRequestStopped(state->request)) return FAILURE;
+
+		// a band is the same rows as the image, starting higher up
+		imageView band = *image;
+		band.base = imageRow(image, firstBlockRow * 3);
+		band.height = (state->blockHeight - firstBlockRow < bandRows ? state->blockHeight - firstBlockRow : bandRows) * 3;
+		if (processBand(state, &band, firstBlockRow, band.height / 3) != SUCCESS) return FAILURE;
+		finishRequestBands(state->request, 1);
+		*nextBlockRow = firstBlockRow + band.height / 3;
+
+		// the rest of the image is not needed, its bands are done as far as the request goes
+		if (isBandStateDone(state))
+		{
+			finishRequestBands(state->request, countBands(state) - (firstBlockRow / bandRows + 1));
+			*nextBlockRow = state->blockHeight;
 		}
+	}
+	return SUCCESS;
+} // processBandsFrom
+
+
+
+// prints the rows of blocks the memo answered for this image and the memo counters of the whole run
+static void reportBandMemo(bandState* state)
+{
+	bandMemoStats stats;
+	getBandMemoStats(&stats);
+	printf("Band Memo: %d of %d rows of blocks remembered, %d blocks not reclassified\n",
+		state->memoHits, state->memoLookups, state->blocksRemembered);
+	printf("Band Memo Totals: %llu hits of %llu lookups (%.1f%%), %zu rows in %.2f MB, %llu evicted, %llu not stored\n",
+		stats.hits, stats.lookups, stats.lookups ? 100.0 * stats.hits / stats.lookups : 0.0,
+		stats.entries, stats.bytes / 1048576.0, stats.evictions, stats.rejected);
+} // reportBandMemo
+
+/*
+* Function: reportBandResults
+* Usage: reportBandResults(&state);
+* ------------------------------------------------------
+* This function prints the outcome of a hide or extract
+* once every band of the image has been processed.
+*/
+int reportBandResults(bandState* state)
+{
+	int status = SUCCESS;
+
+	switch (state->action)
+	{
+	case ACTION_HIDE:
+	{
 		// This is where the key is generated, user may not extract completely if they do not
 		// have this key. The key is just the number of bits used to hide the message.
-		gKey = bitIndex;
-		if (bitIndex < totalMsgBits)
+		state->key = state->bitIndex;
+		if (state->bitIndex < state->totalMsgBits && state->permuted)
+		{
+			// the block order was derived from the whole message size, an extract given the bits that
+			// did fit as its key would walk another order, so the stego image would be of no use
+			printf("Error - Message too large to embed in image, a permuted hide needs all of it to fit, nothing was written.\n\n");
+			state->key = 0;
+			failRequest(state->request);
+			return FAILURE;
+		}
+		if (state->bitIndex < state->totalMsgBits)
 		{
 			printf("Error - Message too large to embed in image, possible message Data loss.\n\n");
 		}
@@ -185,63 +926,40 @@ void parsePixelData(BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData,
 		{
 			printf("\n\nMessage Embedded Successfully\n");
 		}
-		printf("Key Value (Used when extracting): %d\n\n", gKey);
-		printf("Message Size: %d bits\n", totalMsgBits);
-		printf("Total Blocks: %d\n", totalPossibleBlocks);
-		printf("Embeddable Blocks: %d\n", embeddableBlocks);
-		printf("Embedded Blocks Used: %d\n", bitIndex);
-		printf("Hiding Capacity: %d bits | %d bytes\n", embeddableBlocks, embeddableBlocks / 8);
-		printf("Percentage Capacity Used: %.2f%%\n", (float)bitIndex / (float)embeddableBlocks * 100);
-
-		// This is where we reassemble the pixels from the blocks to make the new image
-		// This is for some reason stores the hidden data bits flipped, which I was not able to fix
-		// So perhaps it is something to do in the future, if needed. 
-		// At the moment the bits are being flipped when extracting to "fix" the problem
-		rowSize = ((pFileInfo->biWidth + 7) / 8 + 3) & ~3;
-		for (int k = 0; k < totalPossibleBlocks; k++)
-		{
-			int blockX = (k % blockWidth) * 3;
-			int blockY = (k / blockWidth) * 3;
-			for (int i = 0; i < 3; i++)
+		printf("Key Value (Used when extracting): %d\n\n", state->key);
+		printf("Message Size: %d bits\n", state->totalMsgBits);
+		printf("Total Blocks: %d\n", state->totalPossibleBlocks);
+		printf("Blocks Classified: %d\n", state->blocksClassified);
+		printf("Classifier Kernel: %s\n", gKernels->name);
+		if (state->kernel == KERNEL_TABLE) printf("Uniform Blocks Skipped: %d\n", state->blocksSkipped);
+		if (state->memo) reportBandMemo(state);
+		printf("Embeddable Blocks: %d\n", state->embeddableBlocks);
+		printf("Embedded Blocks Used: %d\n", state->blocksUsed);
+		if (state->verify)
+		{
+			// the checksum matches the one -extract -verify prints for the same stego image and key
+			printf("Verified Blocks: %d, %d failed\n", state->verifiedBlocks, state->verifyFailures);
+			printf("Hidden Stream CRC-32: %08X\n", ~state->streamChecksum);
+			if (state->verifyFailures > 0)
 			{
-				for (int j = 0; j < 3; j++)
-				{
-					int px = blockX + j;
-					int py = blockY + i;
-					size_t currentPixelIndex = (py * rowSize) + (px / 8);
-					size_t bitIndex = 7 - (px % 8);
-					// This if statement is where the bit flipping issue is happening,
-					// Marc may have to fix it since he implemented the writing of the image
-					if (blockArray[k].matrix[i][j] == 1)
-					{
-						pixelData[currentPixelIndex] |= (1 << bitIndex);
-					}
-					else
-					{
-						pixelData[currentPixelIndex] &= ~(1 << bitIndex);
-					}
-				}
+				printf("Error - Verification failed, the message cannot be extracted as hidden.\n\n");
+				status = FAILURE;
 			}
 		}
+		if (state->blocksClassified + state->blocksSkipped + state->blocksRemembered < state->totalPossibleBlocks)
+		{
+			// classification stopped with the last message bit, the capacity of the rest is unknown
+			printf("Hiding Capacity: at least %d bits | %d bytes (use -fullcapacity to classify every block)\n",
+				state->capacityBits, state->capacityBits / 8);
+			break;
+		}
+		printf("Hiding Capacity: %d bits | %d bytes\n", state->capacityBits, state->capacityBits / 8);
+		printf("Percentage Capacity Used: %.2f%%\n", (float)state->bitIndex / (float)state->capacityBits * 100);
 		break;
 	}
 	case ACTION_EXTRACT:
 	{
-
-		// This is a simple loop, it checks if a block is embeddable and extracts the 
-		// data from the middle pixel. This occurs until we run out of blocks or 
-		// we run out of message data, which is determined by the key value (gKey)
-		// which is provided during hiding, and the user must provide it
-		for (int i = 0; i < totalPossibleBlocks; i++)
-		{
-			blockInfo* currentBlock = &blockArray[i];
-			if (bitIndex >= gKey) break;
-			if (!currentBlock->isEmbeddable) continue;
-
-			currentBit = currentBlock->matrix[1][1] ^ 1;
-			extractedBits[bitIndex++] = currentBit;
-		}
-		if (bitIndex < gKey)
+		if (state->bitIndex < state->key)
 		{
 			printf("Error - Extracted data doesnot match key, possible data loss or incorrect key.\n");
 		}
@@ -249,6 +967,9 @@ void parsePixelData(BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData,
 		{
 			printf("Message Extracted Successfully\n\n");
 		}
+		if (state->verify) printf("Extracted Stream CRC-32: %08X\n", ~state->streamChecksum);
+		printf("Classifier Kernel: %s\n", gKernels->name);
+		if (state->memo) reportBandMemo(state);
 		break;
 	}
 	default:
@@ -256,8 +977,208 @@ void parsePixelData(BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData,
 		break;
 	}
 
-	return;
-} // parsePixelData
+	if (state->analysis != NULL)
+	{
+		if (writeAnalysis(state->analysis, gAnalysisPathFileName) != SUCCESS) status = FAILURE;
+		freeAnalysis(state->analysis);
+		state->analysis = NULL;
+	}
+	return status;
+} // reportBandResults
+
+// -selftest: compares lane b of a classified slice with the reference checks on patterns[b], returns 1 if they agree
+static int sliceLaneMatches(blockSlice* slice, int b, int pattern)
+{
+	blockClass* reference = &gBlockClasses[pattern];
+	int outcomes = (int)(slice->embeddable >> b & 1) + (int)(slice->ratioFailures >> b & 1)
+		+ (int)(slice->hvdFailures >> b & 1) + (int)(slice->flipFailures >> b & 1);
+	int outcome = (slice->embeddable >> b & 1) ? BLOCK_EMBEDDABLE
+		: (slice->ratioFailures >> b & 1) ? BLOCK_RATIO_FAILURE
+		: (slice->hvdFailures >> b & 1) ? BLOCK_HVD_FAILURE : BLOCK_FLIP_FAILURE;
+	int uniqueRatios = 1 + (int)(slice->uniqueLow >> b & 1) + 2 * (int)(slice->uniqueHigh >> b & 1);
+	return outcomes == 1 && outcome == reference->outcome && uniqueRatios == reference->uniqueRatios;
+} // sliceLaneMatches
+
+// -selftest: gathers and classifies every row of blocks of a 1-bit view with kernels and checks each block against
+// its pattern read one at a time, returns the blocks checked or -1 on the first mismatch or if it ran out of memory
+static int selfTestView(imageView* image, const kernelSet* kernels)
+{
+	blockSlice slice;
+	sliceRow row;
+	int blockWidth = image->width / 3, checked = 0;
+
+	if (allocSliceRow(&row, blockWidth) != SUCCESS)
+	{
+		printf("Error - Could not allocate memory for the self test slices.\n\n");
+		return -1;
+	}
+	for (int i = 0; i < image->height / 3; i++)
+	{
+		kernels->loadSliceRow(image, i * 3, &row);
+		kernels->classifySliceRow(&row);
+		for (int first = 0; first < blockWidth; first += SLICE_BLOCKS)
+		{
+			getBlockSlice(&row, first / SLICE_BLOCKS, &slice);
+			for (int b = 0; b < SLICE_BLOCKS && first + b < blockWidth; b++)
+			{
+				int pattern = readBlockPattern(image, (first + b) * 3, i * 3);
+				int loaded = 0;
+				for (int p = 0; p < 9; p++) loaded |= (int)(row.pixels[p * row.capacity + first / SLICE_BLOCKS] >> b & 1) << p;
+				if (loaded != pattern || !sliceLaneMatches(&slice, b, pattern))
+				{
+					printf("Error - %s block %d of row of blocks %d does not match the reference (pattern %d loaded as %d).\n\n",
+						kernels->name, first + b, i, pattern, loaded);
+					freeSliceRow(&row);
+					return -1;
+				}
+				checked++;
+			}
+		}
+	}
+	freeSliceRow(&row);
+	return checked;
+} // selfTestView
+
+// -selftest: checks the classify kernel on all 512 patterns, 64 to a slice, lane b of slice w is pattern w * 64 + b
+static int selfTestPatterns(const kernelSet* kernels)
+{
+	blockSlice slice;
+	sliceRow row;
+
+	if (allocSliceRow(&row, 512) != SUCCESS)
+	{
+		printf("Error - Could not allocate memory for the self test slices.\n\n");
+		return FAILURE;
+	}
+	for (int w = 0; w < row.slices; w++)
+	{
+		for (int p = 0; p < 9; p++)
+		{
+			uint64_t bits = 0;
+			for (int b = 0; b < SLICE_BLOCKS; b++) bits |= (uint64_t)((w * SLICE_BLOCKS + b) >> p & 1) << b;
+			row.pixels[p * row.capacity + w] = bits;
+		}
+	}
+	kernels->classifySliceRow(&row);
+
+	int status = SUCCESS;
+	for (int pattern = 0; pattern < 512 && status == SUCCESS; pattern++)
+	{
+		getBlockSlice(&row, pattern / SLICE_BLOCKS, &slice);
+		if (!sliceLaneMatches(&slice, pattern % SLICE_BLOCKS, pattern))
+		{
+			printf("Error - the %s checks differ from the reference on pattern %d.\n\n", kernels->name, pattern);
+			status = FAILURE;
+		}
+	}
+	freeSliceRow(&row);
+	return status;
+} // selfTestPatterns
+
+// -selftest: packs random 8-bit rows of every width up to 200 with the pack kernel and compares them with the
+// bits packed one at a time, returns the rows checked or -1 on the first mismatch
+static int selfTestPack(const kernelSet* kernels, bdppRandom* rng)
+{
+	unsigned char byteRow[200], packedRow[25], expected[25];
+	int checked = 0;
+
+	for (int width = 1; width <= 200; width++)
+	{
+		fillRandom(rng, byteRow, width);
+		memset(expected, 0, sizeof(expected));
+		for (int x = 0; x < width; x++) expected[x / 8] |= (byteRow[x] & 1) << (7 - x % 8);
+		kernels->packLsbRow(byteRow, width, packedRow);
+		if (memcmp(packedRow, expected, (width + 7) / 8) != 0)
+		{
+			printf("Error - the %s packer differs from the reference on a row of %d pixels.\n\n", kernels->name, width);
+			return -1;
+		}
+		checked++;
+	}
+	return checked;
+} // selfTestPack
+
+// -selftest: runs every check on one set of kernels, as selfTestClassifier describes
+static int selfTestKernels(const kernelSet* kernels, const imageView* cover)
+{
+	int offsetBlocks = 0, coverBlocks = 0, packedRows;
+
+	if (selfTestPatterns(kernels) != SUCCESS) return FAILURE;
+
+	// random rows at every bit offset a sub-rectangle can start at, with a width that leaves a partial slice,
+	// pixels left over past the last block and more than one vector of slices
+	int width = 3 * 600 + 2;
+	size_t stride = bitmapRowSize(7 + width, 1);
+	unsigned char* rows = (unsigned char*)trackedMalloc(stride * 3, MEM_SITE_BAND);
+	if (rows == NULL)
+	{
+		printf("Error - Could not allocate memory for the self test rows.\n\n");
+		return FAILURE;
+	}
+	bdppRandom rng;
+	seedRandom(&rng, 0x5E1F7E57ULL);
+	for (int bitOffset = 0; bitOffset < 8; bitOffset++)
+	{
+		imageView rowsView;
+		fillRandom(&rng, rows, stride * 3);
+		initRowsView(&rowsView, rows, (ptrdiff_t)stride, width, 3, 1);
+		rowsView.bitOffset = bitOffset;
+		int checked = selfTestView(&rowsView, kernels);
+		if (checked < 0)
+		{
+			trackedFree(rows);
+			return FAILURE;
+		}
+		offsetBlocks += checked;
+	}
+	trackedFree(rows);
+
+	packedRows = selfTestPack(kernels, &rng);
+	if (packedRows < 0) return FAILURE;
+
+	// every block of a cover, 8-bit covers through their bit-plane as a hide reads them
+	if (cover != NULL)
+	{
+		imageView coverView = *cover;
+		unsigned char* plane = NULL;
+		if (cover->bitsPerPixel == 8)
+		{
+			plane = packLsbPlane(cover);
+			if (plane == NULL)
+			{
+				printf("Error - Could not allocate memory for the bit-plane.\n\n");
+				return FAILURE;
+			}
+			initRowsView(&coverView, plane, bitmapRowSize(cover->width, 1), cover->width, cover->height, 1);
+		}
+		coverBlocks = selfTestView(&coverView, kernels);
+		trackedFree(plane);
+		if (coverBlocks < 0) return FAILURE;
+	}
+
+	printf("Self Test: the %s kernels match the reference on 512 patterns, %d blocks at 8 bit offsets, %d packed rows",
+		kernels->name, offsetBlocks, packedRows);
+	if (cover != NULL) printf(" and %d blocks of the cover", coverBlocks);
+	printf("\n");
+	return SUCCESS;
+} // selfTestKernels
+
+int selfTestClassifier(const imageView* cover)
+{
+	const kernelSet* inUse = gKernels;
+	int status = SUCCESS;
+
+	// the bit-plane of an 8-bit cover is packed by the kernels under test
+	for (int kernel = KERNEL_SWAR; kernel < KERNEL_COUNT && status == SUCCESS; kernel++)
+	{
+		const kernelSet* kernels = getKernelSet(kernel);
+		if (kernels == NULL) continue;
+		gKernels = kernels;
+		status = selfTestKernels(kernels, cover);
+	}
+	gKernels = inUse;
+	return status;
+} // selfTestClassifier
 
 
 /*
@@ -547,9 +1468,10 @@ void connectivityTest(blockInfo* currentBlock, int blockNumber)
 * then calls diagonalPartition, and connectivityTest
 * to check if the block is embeddable. If the block is
 * embeddable (isEmbeddable = 1) then the middle pixel
-* is flipped back to its original value.
+* is flipped back to its original value. Returns
+* FAILURE if the middle pixel is not a bit.
 */
-void embedData(blockInfo* currentBlock, int blockNumber)
+int embedData(blockInfo* currentBlock, int blockNumber)
 {
 	int temp = currentBlock->matrix[1][1];
 	if (currentBlock->matrix[1][1] == 1)
@@ -559,7 +1481,8 @@ void embedData(blockInfo* currentBlock, int blockNumber)
 	else
 	{
 		printf("Error - %d is not a bit. Data may not be binary.\n\n", currentBlock->matrix[1][1]);
-		exit(-1);
+		currentBlock->isEmbeddable = 0;
+		return FAILURE;
 	}
 	// Must pass tests after flipping the middle pixel to be embeddable
 	diagonalPartition(currentBlock, blockNumber);
@@ -568,7 +1491,8 @@ void embedData(blockInfo* currentBlock, int blockNumber)
 	{
 		currentBlock->matrix[1][1] = temp;
 		currentBlock->isEmbeddable = 0;
-		return;
+		return SUCCESS;
 	}
 	currentBlock->isEmbeddable = 1;
+	return SUCCESS;
 }  // embedData
@@ -0,0 +1,263 @@
+// BDPP Workload Generator
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Generates reproducible test inputs for the BDPP program: 1-bit bitmap
+// covers of any size and message files of any size. The same seed always
+// produces the same files. Everything is streamed to disk one row (or one
+// chunk) at a time so gigapixel covers need only a few rows of memory.
+//
+// Covers are made of 3x3 cells lined up with the BDPP blocks. Each cell is
+// textured (random pixels) with probability equal to the density, otherwise
+// it is plain white. Plain cells can never be embeddable, so the density
+// controls the share of embeddable blocks and with it the hiding capacity.
+//
+
+#include "BitmapReader.h"
+#include "BDPPRandom.h"
+
+#define GEN_CHUNK_SIZE (1 << 20)  // bytes per write when generating a payload
+
+// prints help message to the screen
+static void genUsage(char* programName)
+{
+	fprintf(stdout, "\n\n ***** %s Version: %s ***** \n\n", programName, VERSION);
+	fprintf(stdout, "Generate a cover:\n");
+	fprintf(stdout, "%s -cover <file.bmp> -width <pixels> -height <pixels> [-density <0.0 - 1.0>] [-seed <n>]\n", programName);
+	fprintf(stdout, "  *Writes a 1-bit bitmap, the density is the share of 3x3 cells that are textured (default 0.5).\n\n");
+	fprintf(stdout, "Generate a payload:\n");
+	fprintf(stdout, "%s -payload <file> -size <bytes> [-seed <n>]\n", programName);
+	fprintf(stdout, "  *Writes random message data.\n\n");
+	fprintf(stdout, "  *Both can be generated in one run, the payload uses the seed + 1.\n");
+	fprintf(stdout, "  *The default seed is 1, the same seed always gives the same files.\n\n");
+	exit(0);
+} // genUsage
+
+// stores the size low bytes of value, low byte first as every field of a bitmap header is stored
+static unsigned char* putLittleEndian(unsigned char* field, unsigned int value, int size)
+{
+	for (int i = 0; i < size; i++)
+	{
+		field[i] = (unsigned char)(value >> (8 * i));
+	}
+	return field + size;
+} // putLittleEndian
+
+// writes a width x height 1-bit cover bitmap, row by row from the bottom up as stored in the file
+static int generateCover(char* fileName, int width, int height, double density, uint64_t seed)
+{
+	// file header, info header and the palette, 0 = black and 1 = white
+	unsigned char header[sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + 2 * sizeof(RGBQUAD)];
+	bdppRandom rng;
+	FILE* ptrFile;
+
+	size_t rowSize = ((width + 7) / 8 + 3) & ~3;
+	unsigned long long imageSize = (unsigned long long)rowSize * height;
+	unsigned long long fileSize = sizeof(header) + imageSize;
+	if (fileSize > 0xFFFFFFFFULL)
+	{
+		printf("Error - a %d x %d bitmap is larger than the 4 GB a bitmap file can describe.\n\n", width, height);
+		return FAILURE;
+	}
+
+	// the fields are stored one at a time rather than as the structures, so the file is the same on any machine
+	unsigned char* field = header;
+	field = putLittleEndian(field, 'B' | ('M' << 8), 2);                    // bfType
+	field = putLittleEndian(field, (unsigned int)fileSize, 4);              // bfSize
+	field = putLittleEndian(field, 0, 4);                                   // bfReserved1, bfReserved2
+	field = putLittleEndian(field, sizeof(header), 4);                      // bfOffBits
+	field = putLittleEndian(field, sizeof(BITMAPINFOHEADER), 4);            // biSize
+	field = putLittleEndian(field, (unsigned int)width, 4);                 // biWidth
+	field = putLittleEndian(field, (unsigned int)height, 4);                // biHeight
+	field = putLittleEndian(field, 1, 2);                                   // biPlanes
+	field = putLittleEndian(field, 1, 2);                                   // biBitCount
+	field = putLittleEndian(field, BI_RGB, 4);                              // biCompression
+	field = putLittleEndian(field, (unsigned int)imageSize, 4);             // biSizeImage
+	field = putLittleEndian(field, 2835, 4);                                // biXPelsPerMeter, 72 dpi
+	field = putLittleEndian(field, 2835, 4);                                // biYPelsPerMeter
+	field = putLittleEndian(field, 2, 4);                                   // biClrUsed
+	field = putLittleEndian(field, 0, 4);                                   // biClrImportant
+	field = putLittleEndian(field, 0x000000, 4);                            // black
+	putLittleEndian(field, 0xFFFFFF, 4);                                    // white
+
+	ptrFile = fopen(fileName, "wb");
+	if (ptrFile == NULL)
+	{
+		printf("Error opening file (%s) for writing.\n\n", fileName);
+		return FAILURE;
+	}
+	setvbuf(ptrFile, NULL, _IOFBF, GEN_CHUNK_SIZE);
+	int failed = fwrite(header, sizeof(header), 1, ptrFile) != 1;
+
+	// one row of noise, one textured mask shared by the 3 rows of a cell row, and the random
+	// numbers for the cell decisions, two bytes per cell, the only buffers that depend on the size of the cover
+	int numCells = (width + 2) / 3;
+	unsigned char* row = (unsigned char*)malloc(rowSize);
+	unsigned char* mask = (unsigned char*)malloc(rowSize);
+	unsigned char* cellDraws = (unsigned char*)malloc((size_t)2 * numCells);
+	if (row == NULL || mask == NULL || cellDraws == NULL)
+	{
+		printf("Error - Could not allocate memory for a %d pixel row.\n\n", width);
+		exit(-1);
+	}
+
+	unsigned int threshold = (unsigned int)(density * 65536.0);
+	unsigned char lastByteMask = (width % 8) ? (unsigned char)(0xFF << (8 - width % 8)) : 0xFF;
+	size_t usedBytes = (width + 7) / 8;
+
+	seedRandom(&rng, seed);
+	for (int y = 0; y < height; y++)
+	{
+		if (y % 3 == 0)
+		{
+			// decide which cells of the next 3 rows are textured, mask bit 1 = random pixel
+			// each draw is built from its two bytes low byte first, so the covers do not depend on the byte order
+			fillRandom(&rng, cellDraws, (size_t)2 * numCells);
+			memset(mask, 0, rowSize);
+			for (int x = 0; x < width; x++)
+			{
+				const unsigned char* draw = cellDraws + 2 * (x / 3);
+				if ((unsigned int)(draw[0] | draw[1] << 8) < threshold)
+				{
+					mask[x / 8] |= (unsigned char)(0x80 >> (x % 8));
+				}
+			}
+		}
+
+		// textured pixels take the noise, the rest are white
+		fillRandom(&rng, row, usedBytes);
+		for (size_t i = 0; i < usedBytes; i++)
+		{
+			row[i] = (row[i] & mask[i]) | (unsigned char)~mask[i];
+		}
+		row[usedBytes - 1] &= lastByteMask;
+		memset(row + usedBytes, 0, rowSize - usedBytes);
+
+		if (fwrite(row, 1, rowSize, ptrFile) != rowSize) failed = 1;
+	}
+
+	free(row);
+	free(mask);
+	free(cellDraws);
+	if (fclose(ptrFile) != 0) failed = 1;
+	if (failed)
+	{
+		printf("Error writing file %s.\n\n", fileName);
+		return FAILURE;
+	}
+
+	printf("Cover: %s, %d x %d pixels, density %.3f, %llu bytes\n", fileName, width, height, density, fileSize);
+	return SUCCESS;
+} // generateCover
+
+// writes numBytes of random message data in chunks
+static int generatePayload(char* fileName, unsigned long long numBytes, uint64_t seed)
+{
+	bdppRandom rng;
+	FILE* ptrFile;
+	unsigned char* chunk;
+	unsigned long long written = 0;
+	int failed = 0;
+
+	ptrFile = fopen(fileName, "wb");
+	if (ptrFile == NULL)
+	{
+		printf("Error opening file (%s) for writing.\n\n", fileName);
+		return FAILURE;
+	}
+
+	chunk = (unsigned char*)malloc(GEN_CHUNK_SIZE);
+	if (chunk == NULL)
+	{
+		printf("Error - Could not allocate %d bytes of memory for the payload.\n\n", GEN_CHUNK_SIZE);
+		exit(-1);
+	}
+
+	seedRandom(&rng, seed);
+	while (written < numBytes)
+	{
+		size_t count = numBytes - written < GEN_CHUNK_SIZE ? (size_t)(numBytes - written) : GEN_CHUNK_SIZE;
+		fillRandom(&rng, chunk, count);
+		if (fwrite(chunk, 1, count, ptrFile) != count) failed = 1;
+		written += count;
+	}
+
+	free(chunk);
+	if (fclose(ptrFile) != 0) failed = 1;
+	if (failed)
+	{
+		printf("Error writing file %s.\n\n", fileName);
+		return FAILURE;
+	}
+
+	printf("Payload: %s, %llu bytes\n", fileName, numBytes);
+	return SUCCESS;
+} // generatePayload
+
+// Main function
+int main(int argc, char* argv[])
+{
+	char* coverFileName = NULL, * payloadFileName = NULL;
+	int width = 0, height = 0;
+	double density = 0.5;
+	unsigned long long payloadSize = 0;
+	uint64_t seed = 1;
+	int status = SUCCESS;
+
+	if (argc < 2) genUsage(argv[0]);
+
+	for (int cnt = 1; cnt < argc; cnt++)
+	{
+		if (_stricmp(argv[cnt], "-h") == 0 || _stricmp(argv[cnt], "-help") == 0)
+		{
+			genUsage(argv[0]);
+		}
+
+		if (cnt + 1 == argc)
+		{
+			fprintf(stderr, "\n\nError - no value following <%s> parameter.\n\n", argv[cnt]);
+			exit(-1);
+		}
+
+		if (_stricmp(argv[cnt], "-cover") == 0) coverFileName = argv[++cnt];
+		else if (_stricmp(argv[cnt], "-payload") == 0) payloadFileName = argv[++cnt];
+		else if (_stricmp(argv[cnt], "-width") == 0) width = atoi(argv[++cnt]);
+		else if (_stricmp(argv[cnt], "-height") == 0) height = atoi(argv[++cnt]);
+		else if (_stricmp(argv[cnt], "-density") == 0) density = atof(argv[++cnt]);
+		else if (_stricmp(argv[cnt], "-size") == 0) payloadSize = strtoull(argv[++cnt], NULL, 10);
+		else if (_stricmp(argv[cnt], "-seed") == 0) seed = strtoull(argv[++cnt], NULL, 10);
+		else
+		{
+			fprintf(stderr, "\n\nError - unknown parameter <%s>.\n\n", argv[cnt]);
+			exit(-1);
+		}
+	}
+
+	if (coverFileName == NULL && payloadFileName == NULL)
+	{
+		fprintf(stderr, "\n\nError - nothing to generate, give -cover and/or -payload.\n\n");
+		exit(-1);
+	}
+	if (coverFileName != NULL && (width < 3 || height < 3))
+	{
+		fprintf(stderr, "\n\nError - cover width and height must be at least 3 pixels.\n\n");
+		exit(-1);
+	}
+	if (density < 0.0 || density > 1.0)
+	{
+		fprintf(stderr, "\n\nError - density must be between 0.0 and 1.0.\n\n");
+		exit(-1);
+	}
+
+	clock_t start = clock();
+	if (coverFileName != NULL && generateCover(coverFileName, width, height, density, seed) != SUCCESS)
+	{
+		status = FAILURE;
+	}
+	if (payloadFileName != NULL && generatePayload(payloadFileName, payloadSize, seed + 1) != SUCCESS)
+	{
+		status = FAILURE;
+	}
+	printf("Seed: %llu, %.2f seconds\n", (unsigned long long)seed, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+	return status == SUCCESS ? 0 : -1;
+} // main
@@ -0,0 +1,109 @@
+// BDPP Random Data Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Seeded pseudo-random generator for synthetic covers and message data.
+// Four independent xoshiro256++ streams are stepped together with their
+// state stored lane by lane, so the compiler can keep all four in one
+// vector register and produce 32 bytes per step. The same seed always
+// gives the same bytes on every machine.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+#define RANDOM_LANES 4
+
+/*
+* Structure: bdppRandom
+* Usage: bdppRandom rng; seedRandom(&rng, seed);
+* ------------------------------------------------------
+* This structure holds the state of the four generator
+* lanes. s0[i] .. s3[i] are the four state words of
+* lane i.
+*/
+struct bdppRandom
+{
+    uint64_t s0[RANDOM_LANES];
+    uint64_t s1[RANDOM_LANES];
+    uint64_t s2[RANDOM_LANES];
+    uint64_t s3[RANDOM_LANES];
+};  // bdppRandom
+
+// splitmix64, only used to expand the seed into the generator state
+static inline uint64_t splitMix64(uint64_t* x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+* Function: seedRandom
+* Usage: seedRandom(&rng, seed);
+* ------------------------------------------------------
+* This function expands a 64 bit seed into the state of
+* all four lanes.
+*/
+static inline void seedRandom(bdppRandom* rng, uint64_t seed)
+{
+    uint64_t x = seed;
+    for (int i = 0; i < RANDOM_LANES; i++)
+    {
+        rng->s0[i] = splitMix64(&x);
+        rng->s1[i] = splitMix64(&x);
+        rng->s2[i] = splitMix64(&x);
+        rng->s3[i] = splitMix64(&x);
+    }
+}
+
+/*
+* Function: nextRandom
+* Usage: nextRandom(&rng, words);
+* ------------------------------------------------------
+* This function steps all four lanes once and stores one
+* 64 bit output per lane in words.
+*/
+static inline void nextRandom(bdppRandom* rng, uint64_t words[RANDOM_LANES])
+{
+    for (int i = 0; i < RANDOM_LANES; i++)
+    {
+        uint64_t sum = rng->s0[i] + rng->s3[i];
+        words[i] = ((sum << 23) | (sum >> 41)) + rng->s0[i];
+
+        uint64_t t = rng->s1[i] << 17;
+        rng->s2[i] ^= rng->s0[i];
+        rng->s3[i] ^= rng->s1[i];
+        rng->s1[i] ^= rng->s2[i];
+        rng->s0[i] ^= rng->s3[i];
+        rng->s2[i] ^= t;
+        rng->s3[i] = (rng->s3[i] << 45) | (rng->s3[i] >> 19);
+    }
+}
+
+/*
+* Function: fillRandom
+* Usage: fillRandom(&rng, buffer, numBytes);
+* ------------------------------------------------------
+* This function fills numBytes of buffer with random
+* bytes, 32 bytes per step of the generator. Each word
+* is stored low byte first, so the bytes are the same
+* on any machine.
+*/
+static inline void fillRandom(bdppRandom* rng, unsigned char* buffer, size_t numBytes)
+{
+    uint64_t words[RANDOM_LANES];
+    size_t done = 0;
+
+    while (done < numBytes)
+    {
+        nextRandom(rng, words);
+        for (size_t i = 0; i < sizeof(words) && done < numBytes; i++, done++)
+        {
+            buffer[done] = (unsigned char)(words[i / 8] >> (8 * (i % 8)));
+        }
+    }
+}
@@ -0,0 +1,275 @@
+// BDPP Request Ring Demo
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// A sample caller of a BDPP -serve request ring. It stands in for a service
+// that already holds decoded cover pixels: the cover bitmap is read once,
+// then every request decodes it into a ring slot, hides a random message in
+// place, extracts it again from the same slot and checks the bits, timing
+// both round trips. With -stop it asks the server to shut down.
+//
+
+#include <thread>
+#include "BitmapReader.h"
+#include "BDPPRandom.h"
+#include "RequestRing.h"
+
+// prints help message to the screen
+static void demoUsage(char* programName)
+{
+	fprintf(stdout, "\n\n ***** %s Version: %s ***** \n\n", programName, VERSION);
+	fprintf(stdout, "Hide and extract through a request ring:\n");
+	fprintf(stdout, "%s -ring <ring name> -cover <file.bmp> [-requests <n>] [-bits <n>] [-threads <n>] [-seed <n>]\n", programName);
+	fprintf(stdout, "  *Runs <n> hide and extract round trips (default 100) of <bits> random message bits\n");
+	fprintf(stdout, "   (default 1024) on <threads> threads (default 1) and prints the latencies.\n\n");
+	fprintf(stdout, "Stop the server:\n");
+	fprintf(stdout, "%s -ring <ring name> -stop\n\n", programName);
+	exit(0);
+} // demoUsage
+
+// round trip results of one caller thread
+struct demoThread
+{
+	int requests;
+	uint64_t seed;
+	int failures;
+	double hideSeconds;
+	double extractSeconds;
+	double worstSeconds;  // slowest hide or extract
+};  // demoThread
+
+// the decoded cover shared by every caller thread, read only
+static unsigned char* gCoverPixels;
+static int gCoverWidth, gCoverHeight;
+static size_t gCoverRowSize;
+
+static double elapsedSeconds(LARGE_INTEGER* start, LARGE_INTEGER* frequency)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)(now.QuadPart - start->QuadPart) / (double)frequency->QuadPart;
+} // elapsedSeconds
+
+// runs the round trips of one thread, each on whichever slot is free
+static void runCaller(requestRing* ring, unsigned int messageBits, demoThread* caller)
+{
+	bdppRandom rng;
+	LARGE_INTEGER frequency, start;
+	unsigned int messageBytes = (messageBits + 7) / 8;
+	unsigned char* message = (unsigned char*)malloc(messageBytes);
+	if (message == NULL)
+	{
+		printf("Error - Could not allocate %u bytes of memory for the message.\n\n", messageBytes);
+		exit(-1);
+	}
+
+	QueryPerformanceFrequency(&frequency);
+	seedRandom(&rng, caller->seed);
+	for (int r = 0; r < caller->requests; r++)
+	{
+		int slotIndex;
+		while ((slotIndex = ringAcquireSlot(ring)) < 0) Sleep(0);
+
+		ringSlot* slot = ringSlotHeader(ring, slotIndex);
+		unsigned char* data = ringSlotData(ring, slotIndex);
+
+		// a real caller decodes its image straight into the slot, the demo copies the bitmap rows
+		memcpy(data, gCoverPixels, gCoverRowSize * gCoverHeight);
+		fillRandom(&rng, message, messageBytes);
+		slot->width = gCoverWidth;
+		slot->height = gCoverHeight;
+		slot->messageOffset = (unsigned int)((gCoverRowSize * gCoverHeight + 7) & ~(size_t)7);
+		memcpy(data + slot->messageOffset, message, messageBytes);
+
+		slot->action = ACTION_HIDE;
+		slot->messageBits = messageBits;
+		QueryPerformanceCounter(&start);
+		int status = ringSubmit(ring, slotIndex, RING_WAIT_TIMEOUT);
+		double seconds = elapsedSeconds(&start, &frequency);
+		caller->hideSeconds += seconds;
+		if (seconds > caller->worstSeconds) caller->worstSeconds = seconds;
+
+		// the stego pixels are already in the slot, extract them where they are
+		if (status == SUCCESS)
+		{
+			slot->action = ACTION_EXTRACT;
+			slot->messageBits = slot->key;
+			QueryPerformanceCounter(&start);
+			status = ringSubmit(ring, slotIndex, RING_WAIT_TIMEOUT);
+			seconds = elapsedSeconds(&start, &frequency);
+			caller->extractSeconds += seconds;
+			if (seconds > caller->worstSeconds) caller->worstSeconds = seconds;
+		}
+
+		// one extracted bit per byte, most significant bit of the message first
+		for (unsigned int bit = 0; status == SUCCESS && bit < messageBits; bit++)
+		{
+			if (data[slot->messageOffset + bit] != ((message[bit / 8] >> (7 - bit % 8)) & 1)) status = FAILURE;
+		}
+		if (status != SUCCESS) caller->failures++;
+		ringReleaseSlot(ring, slotIndex);
+	}
+	free(message);
+	return;
+} // runCaller
+
+// reads a 1-bit bitmap and keeps its pixel rows as the decoded cover
+static int loadCover(char* fileName)
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	FILE* ptrFile = fopen(fileName, "rb");
+
+	if (ptrFile == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", fileName);
+		return FAILURE;
+	}
+	if (fread(&fileHdr, sizeof(fileHdr), 1, ptrFile) != 1 || fread(&fileInfo, sizeof(fileInfo), 1, ptrFile) != 1
+		|| fileHdr.bfType != ('B' | ('M' << 8)) || fileInfo.biBitCount != 1 || fileInfo.biHeight < 3 || fileInfo.biWidth < 3)
+	{
+		printf("Error - %s is not a 1-bit bottom-up bitmap file.\n\n", fileName);
+		fclose(ptrFile);
+		return FAILURE;
+	}
+
+	gCoverWidth = fileInfo.biWidth;
+	gCoverHeight = fileInfo.biHeight;
+	gCoverRowSize = ringRowSize(gCoverWidth);
+	gCoverPixels = (unsigned char*)malloc(gCoverRowSize * gCoverHeight);
+	if (gCoverPixels == NULL || fseek(ptrFile, fileHdr.bfOffBits, SEEK_SET) != 0
+		|| fread(gCoverPixels, 1, gCoverRowSize * gCoverHeight, ptrFile) != gCoverRowSize * gCoverHeight)
+	{
+		printf("Error - could not read the pixel data of %s.\n\n", fileName);
+		fclose(ptrFile);
+		return FAILURE;
+	}
+	fclose(ptrFile);
+	return SUCCESS;
+} // loadCover
+
+// Main function
+int main(int argc, char* argv[])
+{
+	char* ringName = NULL, * coverFileName = NULL;
+	int requests = 100, numThreads = 1, stop = 0;
+	unsigned int messageBits = 1024;
+	uint64_t seed = 1;
+	requestRing ring;
+
+	if (argc < 2) demoUsage(argv[0]);
+
+	for (int cnt = 1; cnt < argc; cnt++)
+	{
+		if (_stricmp(argv[cnt], "-h") == 0 || _stricmp(argv[cnt], "-help") == 0)
+		{
+			demoUsage(argv[0]);
+		}
+		if (_stricmp(argv[cnt], "-stop") == 0)
+		{
+			stop = 1;
+			continue;
+		}
+
+		if (cnt + 1 == argc)
+		{
+			fprintf(stderr, "\n\nError - no value following <%s> parameter.\n\n", argv[cnt]);
+			exit(-1);
+		}
+
+		if (_stricmp(argv[cnt], "-ring") == 0) ringName = argv[++cnt];
+		else if (_stricmp(argv[cnt], "-cover") == 0) coverFileName = argv[++cnt];
+		else if (_stricmp(argv[cnt], "-requests") == 0) requests = atoi(argv[++cnt]);
+		else if (_stricmp(argv[cnt], "-bits") == 0) messageBits = (unsigned int)strtoul(argv[++cnt], NULL, 10);
+		else if (_stricmp(argv[cnt], "-threads") == 0) numThreads = atoi(argv[++cnt]);
+		else if (_stricmp(argv[cnt], "-seed") == 0) seed = strtoull(argv[++cnt], NULL, 10);
+		else
+		{
+			fprintf(stderr, "\n\nError - unknown parameter <%s>.\n\n", argv[cnt]);
+			exit(-1);
+		}
+	}
+
+	if (ringName == NULL || (coverFileName == NULL && !stop))
+	{
+		fprintf(stderr, "\n\nError - give -ring and either -cover or -stop.\n\n");
+		exit(-1);
+	}
+	if (requests < 1 || numThreads < 1 || messageBits < 1)
+	{
+		fprintf(stderr, "\n\nError - requests, bits and threads must be positive integers.\n\n");
+		exit(-1);
+	}
+	if (ringConnect(&ring, ringName) != SUCCESS) exit(-1);
+
+	if (stop)
+	{
+		int slotIndex;
+		while ((slotIndex = ringAcquireSlot(&ring)) < 0) Sleep(1);
+		ringSlotHeader(&ring, slotIndex)->action = RING_ACTION_SHUTDOWN;
+		int status = ringSubmit(&ring, slotIndex, RING_WAIT_TIMEOUT);
+		ringReleaseSlot(&ring, slotIndex);
+		ringClose(&ring);
+		printf("Request ring %s %s\n", ringName, status == SUCCESS ? "stopped" : "did not answer");
+		return status == SUCCESS ? 0 : -1;
+	}
+
+	if (loadCover(coverFileName) != SUCCESS) exit(-1);
+
+	// the pixels, then the message or one byte per extracted bit, must fit in a slot
+	unsigned long long slotBytes = ((gCoverRowSize * gCoverHeight + 7) & ~(size_t)7) + (unsigned long long)messageBits;
+	if (slotBytes > ring.header->slotSize)
+	{
+		printf("Error - a %d x %d cover and %u message bits need %llu bytes, the slots of %s hold %u.\n\n",
+			gCoverWidth, gCoverHeight, messageBits, slotBytes, ringName, (unsigned int)ring.header->slotSize);
+		exit(-1);
+	}
+
+	demoThread* callers = (demoThread*)calloc(numThreads, sizeof(demoThread));
+	std::thread* threads = new std::thread[numThreads];
+	LARGE_INTEGER frequency, start;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	for (int t = 0; t < numThreads; t++)
+	{
+		callers[t].requests = requests / numThreads + (t < requests % numThreads ? 1 : 0);
+		callers[t].seed = seed + t;
+		threads[t] = std::thread(runCaller, &ring, messageBits, &callers[t]);
+	}
+
+	int failures = 0;
+	double hideSeconds = 0.0, extractSeconds = 0.0, worstSeconds = 0.0;
+	for (int t = 0; t < numThreads; t++)
+	{
+		threads[t].join();
+		failures += callers[t].failures;
+		hideSeconds += callers[t].hideSeconds;
+		extractSeconds += callers[t].extractSeconds;
+		if (callers[t].worstSeconds > worstSeconds) worstSeconds = callers[t].worstSeconds;
+	}
+	double totalSeconds = elapsedSeconds(&start, &frequency);
+
+	printf("Ring: %s, %u slots of %u bytes, %u bits per block\n", ringName, (unsigned int)ring.header->slotCount,
+		(unsigned int)ring.header->slotSize, (unsigned int)ring.header->bitsPerBlock);
+	printf("Cover: %s, %d x %d pixels, %u message bits\n", coverFileName, gCoverWidth, gCoverHeight, messageBits);
+	printf("Round Trips: %d on %d threads, %d failed\n", requests, numThreads, failures);
+	printf("Mean Hide: %.1f us, Mean Extract: %.1f us, Slowest: %.1f us\n",
+		hideSeconds / requests * 1e6, extractSeconds / requests * 1e6, worstSeconds * 1e6);
+	printf("Throughput: %.1f round trips per second\n", requests / totalSeconds);
+
+	// the server's own view of the latency, from the moment it took each request until it was done
+	static const char* laneNames[LANE_COUNT] = { "Latency", "Throughput" };
+	for (int lane = 0; lane < LANE_COUNT; lane++)
+	{
+		const laneHistogram* histogram = &ring.header->lanes[lane];
+		if (histogram->jobs == 0) continue;
+		printf("Server %s Lane: %llu requests, p50 %.1f us, p99 %.1f us, max %.1f us\n", laneNames[lane], histogram->jobs,
+			(double)laneLatencyPercentile(histogram, 0.50), (double)laneLatencyPercentile(histogram, 0.99),
+			(double)histogram->maxMicroseconds);
+	}
+
+	delete[] threads;
+	free(callers);
+	free(gCoverPixels);
+	ringClose(&ring);
+	return failures == 0 ? 0 : -1;
+} // main
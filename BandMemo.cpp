@@ -0,0 +1,140 @@
+// BDPP Band Memo
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// A direct mapped table of remembered rows of blocks. A row goes in the slot
+// its hash selects and replaces whatever was there; rows stop being added
+// once their bitsets use up the memory budget. One lock covers the table,
+// the batch, schedule and ring threads all share it.
+//
+
+#include <mutex>
+#include "BitmapReader.h"
+#include "BandMemo.h"
+#include "MemStats.h"
+
+// one remembered row, the hash covers the pixels and the block count
+struct bandMemoEntry
+{
+    uint64_t hash;
+    int blockWidth;
+    uint64_t* embeddableBits;   // NULL if the slot is empty
+};  // bandMemoEntry
+
+static bandMemoEntry* gMemoTable = NULL;
+static size_t gMemoMask;
+static size_t gMemoBudget;
+static bandMemoStats gMemoStats;
+static std::mutex gMemoLock;
+
+// words of a bitset with one bit per block
+static inline size_t memoWords(int blockWidth)
+{
+	return ((size_t)blockWidth + 63) / 64;
+} // memoWords
+
+int initBandMemo(int megabytes)
+{
+	size_t slots = 1024;
+
+	gMemoBudget = (size_t)megabytes << 20;
+	while (slots < gMemoBudget / BAND_MEMO_ROW_BYTES) slots <<= 1;
+	gMemoTable = (bandMemoEntry*)trackedCalloc(slots, sizeof(bandMemoEntry), MEM_SITE_BOOKKEEPING);
+	if (gMemoTable == NULL) return FAILURE;
+	gMemoMask = slots - 1;
+	memset(&gMemoStats, 0, sizeof(gMemoStats));
+	return SUCCESS;
+} // initBandMemo
+
+int isBandMemoOn()
+{
+	return gMemoTable != NULL;
+} // isBandMemoOn
+
+uint64_t hashBlockRow(unsigned char* blockRow, ptrdiff_t stride, int blockWidth)
+{
+	// whole 8 byte words, then the last 1 to 8 bytes with the pixels past the last block masked off
+	size_t usedBits = (size_t)blockWidth * 3;
+	size_t usedBytes = (usedBits + 7) / 8;
+	unsigned char lastByteMask = (usedBits % 8) ? (unsigned char)(0xFF << (8 - usedBits % 8)) : 0xFF;
+	uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (uint64_t)blockWidth;
+
+	for (int r = 0; r < 3; r++)
+	{
+		unsigned char* row = blockRow + r * stride;
+		size_t i = 0;
+		for (; i + 8 < usedBytes; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, row + i, sizeof(word));
+			hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+			hash ^= hash >> 32;
+		}
+		uint64_t tail = 0;
+		for (; i < usedBytes; i++)
+		{
+			unsigned char byte = (i + 1 == usedBytes) ? (row[i] & lastByteMask) : row[i];
+			tail = (tail << 8) | byte;
+		}
+		hash = (hash ^ tail ^ ((uint64_t)r << 62)) * 0xC4CEB9FE1A85EC53ULL;
+		hash ^= hash >> 29;
+	}
+
+	// the table slot comes from the low bits, so finish with a full avalanche
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ULL;
+	hash ^= hash >> 33;
+	return hash;
+} // hashBlockRow
+
+int lookupBandMemo(uint64_t hash, int blockWidth, uint64_t* embeddableBits)
+{
+	std::lock_guard<std::mutex> lock(gMemoLock);
+	bandMemoEntry* entry = &gMemoTable[hash & gMemoMask];
+
+	gMemoStats.lookups++;
+	if (entry->embeddableBits == NULL || entry->hash != hash || entry->blockWidth != blockWidth) return 0;
+	memcpy(embeddableBits, entry->embeddableBits, memoWords(blockWidth) * sizeof(uint64_t));
+	gMemoStats.hits++;
+	return 1;
+} // lookupBandMemo
+
+void insertBandMemo(uint64_t hash, int blockWidth, uint64_t* embeddableBits)
+{
+	std::lock_guard<std::mutex> lock(gMemoLock);
+	bandMemoEntry* entry = &gMemoTable[hash & gMemoMask];
+	size_t bytes = memoWords(blockWidth) * sizeof(uint64_t);
+
+	if (entry->embeddableBits != NULL)
+	{
+		if (entry->hash == hash && entry->blockWidth == blockWidth) return;  // another thread got there first
+		gMemoStats.bytes -= memoWords(entry->blockWidth) * sizeof(uint64_t);
+		gMemoStats.entries--;
+		gMemoStats.evictions++;
+		trackedFree(entry->embeddableBits);
+		entry->embeddableBits = NULL;
+	}
+	if (gMemoStats.bytes + bytes > gMemoBudget)
+	{
+		gMemoStats.rejected++;
+		return;
+	}
+
+	entry->embeddableBits = (uint64_t*)trackedMalloc(bytes, MEM_SITE_BOOKKEEPING);
+	if (entry->embeddableBits == NULL) return;
+	memcpy(entry->embeddableBits, embeddableBits, bytes);
+	entry->hash = hash;
+	entry->blockWidth = blockWidth;
+	gMemoStats.bytes += bytes;
+	gMemoStats.entries++;
+	gMemoStats.inserts++;
+	return;
+} // insertBandMemo
+
+void getBandMemoStats(bandMemoStats* stats)
+{
+	std::lock_guard<std::mutex> lock(gMemoLock);
+	*stats = gMemoStats;
+	return;
+} // getBandMemoStats
@@ -0,0 +1,93 @@
+// BDPP Band Memo Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Remembers which blocks of a row of blocks are embeddable, keyed by a hash
+// of the row's three pixel rows, so rows that repeat within an image or
+// across the images of a run (letterheads, borders, blank template pages)
+// are classified once. Only the embeddable blocks of a remembered row are
+// read again, to hide in or extract from them.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BAND_MEMO_DEFAULT_MB	64		// memory for remembered rows, -memo
+#define BAND_MEMO_ROW_BYTES		256		// expected bytes per remembered row, sizes the table
+
+/*
+* Structure: bandMemoStats
+* Usage: bandMemoStats stats; getBandMemoStats(&stats);
+* ------------------------------------------------------
+* This structure holds the counters of the memo since
+* the program started.
+*/
+struct bandMemoStats
+{
+    unsigned long long lookups;
+    unsigned long long hits;
+    unsigned long long inserts;
+    unsigned long long evictions;         // rows replaced by a row with the same table slot
+    unsigned long long rejected;          // rows not remembered because the memory was used up
+    size_t bytes;                         // memory held by remembered rows
+    size_t entries;
+};  // bandMemoStats
+
+/*
+* Function: initBandMemo
+* Usage: initBandMemo(gBandMemoMegabytes);
+* ------------------------------------------------------
+* This function sets up an empty memo that holds at most
+* megabytes of remembered rows. Returns FAILURE if the
+* table could not be allocated.
+*/
+int initBandMemo(int megabytes);
+
+/*
+* Function: isBandMemoOn
+* Usage: state->memo = isBandMemoOn();
+* ------------------------------------------------------
+* This function returns 1 once initBandMemo succeeded.
+*/
+int isBandMemoOn();
+
+/*
+* Function: hashBlockRow
+* Usage: hash = hashBlockRow(blockRow, stride, blockWidth);
+* ------------------------------------------------------
+* This function hashes the pixels of the blocks of one
+* row of blocks, the first 3 * blockWidth pixels of each
+* of its three pixel rows, and the block count. The rows
+* are stride bytes apart, stride is negative for rows
+* stored top row first.
+*/
+uint64_t hashBlockRow(unsigned char* blockRow, ptrdiff_t stride, int blockWidth);
+
+/*
+* Function: lookupBandMemo
+* Usage: if (lookupBandMemo(hash, blockWidth, embeddableBits)) ...
+* ------------------------------------------------------
+* This function copies the embeddable block bitset of a
+* remembered row into embeddableBits, one bit per block
+* with block 0 in bit 0 of word 0. Returns 0 if the row
+* is not remembered.
+*/
+int lookupBandMemo(uint64_t hash, int blockWidth, uint64_t* embeddableBits);
+
+/*
+* Function: insertBandMemo
+* Usage: insertBandMemo(hash, blockWidth, embeddableBits);
+* ------------------------------------------------------
+* This function remembers the embeddable block bitset of
+* a fully classified row.
+*/
+void insertBandMemo(uint64_t hash, int blockWidth, uint64_t* embeddableBits);
+
+/*
+* Function: getBandMemoStats
+* Usage: getBandMemoStats(&stats);
+* ------------------------------------------------------
+* This function copies the memo counters.
+*/
+void getBandMemoStats(bandMemoStats* stats);
@@ -0,0 +1,147 @@
+// BDPP Bit-Plane
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Packs the least significant bit-plane of 8-bit rows into 1-bit rows and
+// scatters the changed bits back. The portable packer gathers the lowest
+// bits of 8 pixels with one multiply; the vector packers of Kernels.h do 16
+// to 64 at a time.
+//
+
+#include <bit>
+#include <string.h>
+#include <climits>
+#include "BitmapReader.h"
+#include "BitPlane.h"
+#include "Kernels.h"
+#include "MemStats.h"
+
+void packLsbRow(const unsigned char* byteRow, int width, unsigned char* packedRow)
+{
+	gKernels->packLsbRow(byteRow, width, packedRow);
+	return;
+} // packLsbRow
+
+void packLsbRowSwar(const unsigned char* byteRow, int width, unsigned char* packedRow)
+{
+	int x = 0;
+
+	// the lowest bit of byte i lands in bit 63 - i of the product, so the top byte holds the 8 pixels first pixel highest
+	for (; x + 8 <= width; x += 8)
+	{
+		uint64_t pixels;
+		memcpy(&pixels, byteRow + x, sizeof(pixels));
+		packedRow[x / 8] = (unsigned char)(((pixels & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56);
+	}
+
+	for (; x < width; x += 8)
+	{
+		unsigned char packed = 0;
+		for (int i = 0; i < 8 && x + i < width; i++)
+		{
+			packed |= (byteRow[x + i] & 1) << (7 - i);
+		}
+		packedRow[x / 8] = packed;
+	}
+	return;
+} // packLsbRow
+
+int isGrayscalePalette(RGBQUAD* palette, int colors)
+{
+	for (int i = 0; i < colors; i++)
+	{
+		if (palette[i].rgbRed != palette[i].rgbGreen || palette[i].rgbRed != palette[i].rgbBlue) return 0;
+		if (i > 0 && palette[i].rgbRed <= palette[i - 1].rgbRed) return 0;
+	}
+	return 1;
+} // isGrayscalePalette
+
+int isSupportedBitmap(unsigned char* fileData, unsigned int fileSize)
+{
+	BITMAPFILEHEADER* pFileHdr = (BITMAPFILEHEADER*)fileData;
+	BITMAPINFOHEADER* pFileInfo = (BITMAPINFOHEADER*)(fileData + sizeof(BITMAPFILEHEADER));
+
+	if (fileSize < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) || pFileInfo->biSize < sizeof(BITMAPINFOHEADER))
+	{
+		printf("Error - the bitmap headers are incomplete.\n\n");
+		return 0;
+	}
+	if (pFileInfo->biCompression != BI_RGB)
+	{
+		printf("Error - compressed bitmaps are not supported.\n\n");
+		return 0;
+	}
+	if (pFileInfo->biBitCount != 1 && pFileInfo->biBitCount != 8)
+	{
+		printf("Error - %d-bit images are not supported, only 1-bit and 8-bit grayscale.\n\n", pFileInfo->biBitCount);
+		return 0;
+	}
+	if (pFileInfo->biWidth < 1 || pFileInfo->biHeight == 0 || pFileInfo->biHeight == INT_MIN || pFileInfo->biClrUsed > 256)
+	{
+		printf("Error - the bitmap headers give a %dx%d image with %u colors.\n\n", pFileInfo->biWidth, pFileInfo->biHeight,
+			pFileInfo->biClrUsed);
+		return 0;
+	}
+
+	// the palette must end before the pixels start and the pixels before the file ends, whatever the headers say
+	int colors = pFileInfo->biClrUsed != 0 ? (int)pFileInfo->biClrUsed : 1 << pFileInfo->biBitCount;
+	unsigned long long height = pFileInfo->biHeight < 0 ? -(long long)pFileInfo->biHeight : pFileInfo->biHeight;
+	if (sizeof(BITMAPFILEHEADER) + (unsigned long long)pFileInfo->biSize + sizeof(RGBQUAD) * colors > pFileHdr->bfOffBits
+		|| pFileHdr->bfOffBits + bitmapRowSize(pFileInfo->biWidth, pFileInfo->biBitCount) * height > fileSize)
+	{
+		printf("Error - the palette and pixels given in the bitmap headers do not fit in the file.\n\n");
+		return 0;
+	}
+
+	if (pFileInfo->biBitCount == 8 && !isGrayscalePalette((RGBQUAD*)((unsigned char*)pFileInfo + pFileInfo->biSize), colors))
+	{
+		printf("Error - the palette of an 8-bit cover must be grayscale, from dark to light.\n\n");
+		return 0;
+	}
+	return 1;
+} // isSupportedBitmap
+
+unsigned char* packLsbPlane(const imageView* image)
+{
+	size_t rowSize = bitmapRowSize(image->width, 1);
+	unsigned char* plane = (unsigned char*)trackedCalloc((size_t)image->height, rowSize, MEM_SITE_BAND);
+
+	if (plane == NULL) return NULL;
+	for (int y = 0; y < image->height; y++)
+	{
+		packLsbRow(imageRow(image, y) + image->bitOffset / 8, image->width, plane + y * rowSize);
+	}
+	return plane;
+} // packLsbPlane
+
+int scatterLsbPlane(unsigned char* plane, imageView* image)
+{
+	int width = image->width;
+	size_t rowSize = bitmapRowSize(width, 1);
+	int changed = 0;
+
+	// the pixels are packed again and compared, only the bits that differ are written
+	unsigned char* current = (unsigned char*)trackedCalloc(rowSize, 1, MEM_SITE_BAND);
+	if (current == NULL)
+	{
+		printf("Error - Could not allocate memory for a bit-plane row.\n\n");
+		return FAILURE;
+	}
+
+	for (int y = 0; y < image->height; y++)
+	{
+		unsigned char* byteRow = imageRow(image, y) + image->bitOffset / 8;
+		unsigned char* planeRow = plane + y * rowSize;
+
+		packLsbRow(byteRow, width, current);
+		for (int b = 0; b < (width + 7) / 8; b++)
+		{
+			for (unsigned int diff = current[b] ^ planeRow[b]; diff != 0; diff &= diff - 1)
+			{
+				byteRow[b * 8 + 7 - std::countr_zero(diff)] ^= 1;
+				changed++;
+			}
+		}
+	}
+	trackedFree(current);
+	return changed;
+} // scatterLsbPlane
@@ -0,0 +1,82 @@
+// BDPP Bit-Plane Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Lets BDPP run on the least significant bit-plane of an 8-bit grayscale
+// cover. The plane is packed into the 1-bit row format the classifier reads,
+// and after a hide only the pixels whose plane bit changed are written back,
+// so the cover keeps its gray levels to within one step and needs no
+// dithering.
+//
+
+#pragma once
+
+#include <windows.h>
+#include <stddef.h>
+#include "ImageView.h"
+
+/*
+* Function: packLsbRow
+* Usage: packLsbRow(byteRow, width, packedRow);
+* ------------------------------------------------------
+* This function packs the least significant bits of
+* width 8-bit pixels into 1-bit pixels, most significant
+* bit first, with the packer of the kernels in use. The
+* padding of the last byte is zero.
+*/
+void packLsbRow(const unsigned char* byteRow, int width, unsigned char* packedRow);
+
+/*
+* Function: packLsbRowSwar
+* Usage: packLsbRowSwar(byteRow, width, packedRow);
+* ------------------------------------------------------
+* This function is the portable packer behind
+* packLsbRow, 8 pixels at a time in a 64-bit word. The
+* vector packers finish their rows with it.
+*/
+void packLsbRowSwar(const unsigned char* byteRow, int width, unsigned char* packedRow);
+
+/*
+* Function: isGrayscalePalette
+* Usage: if (!isGrayscalePalette(palette, colors)) ...
+* ------------------------------------------------------
+* This function returns 1 if every palette entry has
+* equal red, green and blue and the levels rise with the
+* index, so flipping the lowest bit of a pixel moves it
+* to a neighbouring gray level.
+*/
+int isGrayscalePalette(RGBQUAD* palette, int colors);
+
+/*
+* Function: isSupportedBitmap
+* Usage: if (!isSupportedBitmap(fileData, fileSize)) ...
+* ------------------------------------------------------
+* This function returns 1 for an uncompressed 1-bit
+* image or 8-bit image with a grayscale palette whose
+* headers, palette and pixels all fit in the fileSize
+* bytes read. Otherwise it prints why the image cannot
+* be used and returns 0.
+*/
+int isSupportedBitmap(unsigned char* fileData, unsigned int fileSize);
+
+/*
+* Function: packLsbPlane
+* Usage: plane = packLsbPlane(&image);
+* ------------------------------------------------------
+* This function returns the bit-plane of an 8-bit image
+* view as a bottom-up 1-bit image with rows padded to 4
+* bytes, or NULL if it could not be allocated. Release it
+* with trackedFree.
+*/
+unsigned char* packLsbPlane(const imageView* image);
+
+/*
+* Function: scatterLsbPlane
+* Usage: changed = scatterLsbPlane(plane, &image);
+* ------------------------------------------------------
+* This function writes a plane from packLsbPlane back
+* into the 8-bit pixels of the view it came from. Only
+* pixels whose bit differs are touched. Returns the
+* number of pixels changed, or FAILURE with no pixel
+* touched if it runs out of memory.
+*/
+int scatterLsbPlane(unsigned char* plane, imageView* image);
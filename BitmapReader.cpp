@@ -7,6 +7,19 @@
 //
 
 #include "BitmapReader.h"
+#include "AsyncIO.h"
+#include "Pipeline.h"
+#include "BDPPRandom.h"
+#include "MemStats.h"
+#include "Capacity.h"
+#include "Scheduler.h"
+#include "RingServer.h"
+#include "BandMemo.h"
+#include "Trace.h"
+#include "BitPlane.h"
+#include "Durable.h"
+#include "Kernels.h"
+#include "Lanes.h"
 
 // Global Variables for File Data Pointers
 
@@ -25,6 +38,64 @@ char gAction;						// typically hide (1), extract (2), wipe (3), randomize (4),
 char gNumBits2Hide;
 int gKey;
 int gInfo;
+int gFullCapacity;
+int gPermute;
+int gVerify;
+int gKernel;
+int gSelfTest;
+char gAnalysisPathFileName[MAX_PATH], * gAnalysisFileName;
+int gAnalysisTile;
+unsigned long long gPermuteSeed;
+
+// Batch Processing Global Variables
+char gBatchPathFileName[MAX_PATH], * gBatchFileName;
+int gIoBackendChoice;
+int gQueueDepth;
+int gPipeline;
+
+// Random Message Global Variables
+bdppRandom gRandom;
+unsigned long long gSeed;
+int gSeedGiven;
+
+// Memory Statistics Global Variables
+int gMemStats;
+
+// Capacity Estimate Global Variables
+int gEstimateSamples;
+char** gCapacityFileNames;
+int gNumCapacityFiles;
+int gCapacityJson;
+
+// Scheduler Global Variables
+char gSchedulePathFileName[MAX_PATH], * gScheduleFileName;
+char gCataloguePathFileName[MAX_PATH], * gCatalogueFileName;
+
+// Request Ring Global Variables
+char gRingName[MAX_PATH];
+int gRingSlots;
+int gRingSlotMegabytes;
+
+// Band Memo Global Variables
+int gBandMemoMegabytes;
+
+// Trace Global Variables
+char gTracePathFileName[MAX_PATH], * gTraceFileName;
+
+// Durable Output Global Variables
+int gDurable;
+int gCommitFiles;
+int gCommitMilliseconds;
+
+// Sub-Rectangle Global Variables
+int gRectX, gRectY, gRectWidth, gRectHeight;	// a width of 0 means the whole image
+
+// Request Global Variables
+unsigned int gDeadlineMilliseconds;	// 0 means no deadline
+
+// Lane Global Variables
+int gLaneMegapixels;	// 0 runs every batch job and ring request in arrival order
+int gLaneBurst;
 
 void initGlobals()
 {
@@ -47,8 +118,42 @@ void initGlobals()
 	gStegoFileName = NULL;
 	gAction = 0;						// typically hide (1), extract (2)
 	gNumBits2Hide = 1;
+	gFullCapacity = 0;
+	gPermute = 0;
+	gVerify = 0;
+	gKernel = KERNEL_AUTO;
+	gSelfTest = 0;
+	gAnalysisPathFileName[0] = 0;
+	gAnalysisTile = ANALYSIS_DEFAULT_TILE;
+	gRingName[0] = 0;
+	gRingSlots = RING_DEFAULT_SLOTS;
+	gRingSlotMegabytes = RING_DEFAULT_SLOT_MB;
+	gBandMemoMegabytes = 0;
+	gTracePathFileName[0] = 0;
+	gRectX = gRectY = gRectWidth = gRectHeight = 0;
+	gDurable = 0;
+	gCommitFiles = DURABLE_DEFAULT_FILES;
+	gCommitMilliseconds = DURABLE_DEFAULT_MS;
+	gDeadlineMilliseconds = 0;
+	gLaneMegapixels = LANE_DEFAULT_MEGAPIXELS;
+	gLaneBurst = LANE_DEFAULT_BURST;
+	gPermuteSeed = 0;
 	gKey = -1;
 	gInfo = 0;
+	gBatchPathFileName[0] = 0;
+	gBatchFileName = NULL;
+	gIoBackendChoice = IO_BACKEND_OVERLAPPED;
+	gQueueDepth = IO_DEFAULT_QUEUE_DEPTH;
+	gPipeline = 0;
+	gSeed = 0;
+	gSeedGiven = 0;
+	gMemStats = MEMSTATS_OFF;
+	gEstimateSamples = ESTIMATE_DEFAULT_SAMPLES;
+	gCapacityFileNames = NULL;
+	gNumCapacityFiles = 0;
+	gCapacityJson = 0;
+	gSchedulePathFileName[0] = 0;
+	gCataloguePathFileName[0] = 0;
 
 	return;
 } // initGlobals
@@ -88,6 +193,12 @@ void displayFileInfo(char* pFileName,
 		numColors = -1;
 	}
 
+	// a palette may list fewer colors than the bit count allows
+	if (numColors > 0 && numColors <= 256 && pFileInfo->biClrUsed != 0 && (int)pFileInfo->biClrUsed < numColors)
+	{
+		numColors = pFileInfo->biClrUsed;
+	}
+
 	printf("Bit Map Image Info:\n\nSize Info Header:%d\nWidth:%d\nHeight:%d\nPlanes:%d\n"
 		"Bits/Pixel:%d ==> %d colors\n"
 		"Compression:%d\nImage Size:%d\nRes X:%d\nRes Y:%d\nColors:%d\nImportant Colors:%d\n\n",
@@ -138,18 +249,19 @@ bool isValidBitMap(unsigned char* filedata)
 } // isValidBitMap
 
 
-// reads specified bitmap file from disk
+// reads specified bitmap file from disk, returns NULL after saying why if it cannot
 unsigned char* readBitmapFile(char* fileName, unsigned int* fileSize)
 {
 	FILE* ptrFile;
 	unsigned char* pFile;
+	size_t got;
 
 	ptrFile = fopen(fileName, "rb");	// specify read only and binary (no CR/LF added)
 
 	if (ptrFile == NULL)
 	{
 		printf("Error in opening file: %s.\n\n", fileName);
-		exit(-1);
+		return NULL;
 	}
 
 	fseek(ptrFile, 0, SEEK_END);
@@ -157,50 +269,84 @@ unsigned char* readBitmapFile(char* fileName, unsigned int* fileSize)
 	fseek(ptrFile, 0, SEEK_SET);
 
 	// malloc memory to hold the file, include room for the header and color table
-	pFile = (unsigned char*)malloc(*fileSize);
+	pFile = (unsigned char*)trackedMalloc(*fileSize, MEM_SITE_FILE);
 
 	if (pFile == NULL)
 	{
 		printf("Error - Could not allocate %d bytes of memory for bitmap file.\n\n", *fileSize);
-		exit(-1);
+		fclose(ptrFile);
+		return NULL;
 	}
 
 	// Read in complete file
 	// buffer for data, size of each item, max # items, ptr to the file
-	fread(pFile, sizeof(unsigned char), *fileSize, ptrFile);
+	traceBegin(TRACE_READ, TRACE_NO_ID, TRACE_NO_ID);
+	got = fread(pFile, sizeof(unsigned char), *fileSize, ptrFile);
+	traceEnd(TRACE_READ, TRACE_NO_ID, TRACE_NO_ID);
 	fclose(ptrFile);
+	if (got != *fileSize)
+	{
+		printf("Error reading file: %s.\n\n", fileName);
+		trackedFree(pFile);
+		return NULL;
+	}
 
 	return(pFile);
 } // readBitmapFile
 
-// writes modified bitmap file to disk
+// writes modified bitmap file to disk, returns FAILURE after saying why if it cannot
 // gMask used to determine the name of the file
 int writeFile(char* filename, int fileSize, unsigned char* pFile)
 {
 	FILE* ptrFile;
+	char writeName[MAX_PATH];
 	int x;
 
 	// open the new file, MUST set binary format (text format will add line feed characters)
-	ptrFile = fopen(filename, "wb+");
+	// with -durable it is written under its temporary name and renamed once it is on disk
+	if (durableWriteName(filename, writeName) != SUCCESS) return FAILURE;
+	ptrFile = fopen(writeName, "wb+");
 	if (ptrFile == NULL)
 	{
-		printf("Error opening file (%s) for writing.\n\n", filename);
-		exit(-1);
+		printf("Error opening file (%s) for writing.\n\n", writeName);
+		return FAILURE;
 	}
 
 	// write the file
+	traceBegin(TRACE_WRITE, currentTraceImage(), TRACE_NO_ID);
 	x = (int)fwrite(pFile, sizeof(unsigned char), fileSize, ptrFile);
+	traceEnd(TRACE_WRITE, currentTraceImage(), TRACE_NO_ID);
 
 	// check for success
 	if (x != fileSize)
 	{
 		printf("Error writing file %s.\n\n", filename);
-		exit(-1);
+		fclose(ptrFile);
+		durableDiscard(writeName);
+		return FAILURE;
 	}
 	fclose(ptrFile); // close file
-	return(SUCCESS);
+	return(durableFinish(writeName));
 } // writeFile
 
+// generates random message data of less than maxSize bytes from rng, with -seed every run gives the same message
+unsigned char* generateRandomMessage(bdppRandom* rng, unsigned int maxSize, unsigned int* msgSize)
+{
+	unsigned char* messageData;
+	uint64_t draws[RANDOM_LANES];
+
+	nextRandom(rng, draws);
+	*msgSize = maxSize ? (unsigned int)(draws[0] % maxSize) : 0;
+	messageData = (unsigned char*)trackedMalloc(sizeof(unsigned char) * (*msgSize + 1), MEM_SITE_MESSAGE);
+	if (messageData == NULL)
+	{
+		printf("Error - Could not allocate %d bytes of memory for random message data.\n\n", *msgSize);
+		exit(-1);
+	}
+	fillRandom(rng, messageData, *msgSize);
+	return messageData;
+} // generateRandomMessage
+
 // prints help message to the screen
 void Usage(char* programName)
 {
@@ -252,7 +398,12 @@ void Usage(char* programName)
 	fprintf(stdout, "  *Hiding capacity may vary between files, therefore we recommend\n");
 	fprintf(stdout, "   the message be at most half the size of the cover file.\n");
 	fprintf(stdout, "  *Random message data is generated based on the cover image width value.\n");
-	fprintf(stdout, "  *If no output file is specified, the default is hiding_output.bmp.\n\n");
+	fprintf(stdout, "  *Add -seed <n> to generate the same random message on every run.\n");
+	fprintf(stdout, "  *If no output file is specified, the default is hiding_output.bmp.\n");
+	fprintf(stdout, "  *Add -verify to read back every block as it is written and print a CRC-32 of the\n");
+	fprintf(stdout, "   hidden bits, -extract -verify prints the same CRC-32 for the extracted bits.\n");
+	fprintf(stdout, "  *Blocks past the last message bit are not classified, add -fullcapacity to\n");
+	fprintf(stdout, "   classify all of them and report the hiding capacity of the whole image.\n\n");
 
 	fprintf(stdout, "Extract:\n");
 	fprintf(stdout, "%s -extract -s <stego file> -k <key value> [-o <message file>] \n", prgname);
@@ -260,8 +411,139 @@ void Usage(char* programName)
 	fprintf(stdout, "  *Key value is generated when an image is hidden\n");
 	fprintf(stdout, "  *Key value is equal to the hidden message bits\n");
 	fprintf(stdout, "  *Using an incorrect key may extract incorrect information\n");
+	fprintf(stdout, "  *Only the rows of the image holding the message are read, use -s - to read from standard input\n");
 	fprintf(stdout, "  *If no output file is specified, the default is extraction_output.bin.\n\n");
 
+	fprintf(stdout, "Hide or extract more than one bit per block:\n");
+	fprintf(stdout, "%s -hide ... -b <bits> | %s -extract ... -b <bits>\n", prgname, prgname);
+	fprintf(stdout, "  *Besides the middle pixel, other pixels of a block carry bits when every value they\n");
+	fprintf(stdout, "   can take keeps the block embeddable. Up to <bits> (1 - 9, default 1) per block.\n");
+	fprintf(stdout, "  *Extract with the same -b value that was used to hide.\n\n");
+
+	fprintf(stdout, "Hide or extract in a key-derived block order:\n");
+	fprintf(stdout, "%s -hide ... -permute <seed> | %s -extract ... -permute <seed>\n", prgname, prgname);
+	fprintf(stdout, "  *The message bits are spread over the whole image in an order derived from the seed\n");
+	fprintf(stdout, "   and the key. Extract with the same seed. Cannot be combined with -pipeline.\n");
+	fprintf(stdout, "  *The order depends on the whole message size, so a message that does not fit is not hidden.\n\n");
+
+	fprintf(stdout, "Classifier analysis:\n");
+	fprintf(stdout, "%s -hide ... -analysis <csv file> [-tile <blocks>] | %s -extract ... -analysis <csv file>\n", prgname, prgname);
+	fprintf(stdout, "  *Classifies every block and counts why blocks were rejected (ratio check, HVD check or\n");
+	fprintf(stdout, "   middle pixel flip) and how many unique ratios they have.\n");
+	fprintf(stdout, "  *The CSV file also holds the embeddable blocks of each tile of <blocks> x <blocks>\n");
+	fprintf(stdout, "   blocks (default %d), one line per row of tiles from the top of the image.\n\n", ANALYSIS_DEFAULT_TILE);
+
+	fprintf(stdout, "8-bit grayscale covers:\n");
+	fprintf(stdout, "%s -hide -c <8-bit file> ... | %s -extract -s <8-bit file> ...\n", prgname, prgname);
+	fprintf(stdout, "  *The least significant bit-plane of an 8-bit cover with a grayscale palette is used as\n");
+	fprintf(stdout, "   the binary image, no pixel moves more than one gray level. Not with -pipeline,\n");
+	fprintf(stdout, "   -estimate or -schedule, which read 1-bit covers only.\n\n");
+
+	fprintf(stdout, "Hide in part of a cover:\n");
+	fprintf(stdout, "%s -hide ... -rect <x> <y> <width> <height> | %s -extract ... -rect <x> <y> <width> <height>\n", prgname, prgname);
+	fprintf(stdout, "  *Only the blocks of the rectangle whose top left pixel is (x, y) are used, the rest of\n");
+	fprintf(stdout, "   the cover is left as it is. The extract must be given the same rectangle.\n\n");
+
+	fprintf(stdout, "Remember classified rows of blocks:\n");
+	fprintf(stdout, "%s ... -memo <megabytes>\n", prgname);
+	fprintf(stdout, "  *Rows of blocks whose pixels were seen before in the run, in the same image or another\n");
+	fprintf(stdout, "   image of a batch, schedule or ring, are not classified again. Only their embeddable\n");
+	fprintf(stdout, "   blocks are read. Up to <megabytes> (%d is a good start) of rows are kept.\n\n", BAND_MEMO_DEFAULT_MB);
+
+	fprintf(stdout, "Classifier kernel:\n");
+	fprintf(stdout, "%s ... -kernel auto | table | swar | sse42 | avx2 | avx512 | neon\n", prgname);
+	fprintf(stdout, "  *auto (the default) picks the widest kernel the processor runs, on ARM64 that is swar and\n");
+	fprintf(stdout, "   neon is only used when asked for. swar classifies 64 blocks at a time with bit-sliced\n");
+	fprintf(stdout, "   checks on 64-bit words, sse42, avx2, avx512 and neon do the same on 2 to 8 words at once,\n");
+	fprintf(stdout, "   table looks each block up one at a time. All give the same blocks, the kernel used is in\n");
+	fprintf(stdout, "   the statistics.\n");
+	fprintf(stdout, "%s -selftest [-c <cover file>]\n", prgname);
+	fprintf(stdout, "  *Checks every kernel the processor runs against the reference checks on all 512 block\n");
+	fprintf(stdout, "   patterns, random rows and packed bit-planes, and on every block of the cover if one is given.\n\n");
+
+	fprintf(stdout, "Pipelined hide or extract:\n");
+	fprintf(stdout, "%s -hide ... -pipeline | %s -extract ... -pipeline\n", prgname, prgname);
+	fprintf(stdout, "  *Reads, processes and writes the image in bands of %d block rows on separate threads,\n", PIPELINE_BAND_BLOCK_ROWS);
+	fprintf(stdout, "   the image is never held in memory as a whole. Intended for very large covers.\n\n");
+
+	fprintf(stdout, "Estimate capacity:\n");
+	fprintf(stdout, "%s -estimate -c <cover file> [-m <msg file>] [-samples <rows>]\n", prgname);
+	fprintf(stdout, "  *Reads only the header and a stratified random sample of rows of blocks (default %d)\n", ESTIMATE_DEFAULT_SAMPLES);
+	fprintf(stdout, "   and prints the estimated embeddable blocks with a 95%% confidence interval.\n");
+	fprintf(stdout, "  *With a message file, also reports whether it fits. Exits with -1 if it does not.\n\n");
+
+	fprintf(stdout, "Count the capacity of many covers:\n");
+	fprintf(stdout, "%s -capacity <cover file> [<cover file> ...] [-b <bits>] [-json]\n", prgname);
+	fprintf(stdout, "  *Classifies every block of every 1-bit cover and prints its exact hiding capacity,\n");
+	fprintf(stdout, "   one line per cover, or one JSON record per line with -json. Nothing is hidden or\n");
+	fprintf(stdout, "   written. The covers are counted in parallel, one per hardware thread.\n");
+	fprintf(stdout, "  *With -json, why a cover failed is printed to standard error, standard output only\n");
+	fprintf(stdout, "   holds the records.\n");
+	fprintf(stdout, "  *Every argument after -capacity up to the next one starting with '-' is taken as a\n");
+	fprintf(stdout, "   cover, so a misspelt word among them is reported as a cover that failed. Give a\n");
+	fprintf(stdout, "   cover whose name starts with '-' with its folder, as .\\-name.bmp.\n\n");
+
+	fprintf(stdout, "Memory statistics:\n");
+	fprintf(stdout, "%s ... -memstats text | json\n", prgname);
+	fprintf(stdout, "  *On exit, prints allocations and bytes per site (file, message, extract, output, band,\n");
+	fprintf(stdout, "   bookkeeping), the peak of live bytes and the peak working set of the process.\n\n");
+
+	fprintf(stdout, "Trace:\n");
+	fprintf(stdout, "%s ... -trace <json file>\n", prgname);
+	fprintf(stdout, "  *On exit, writes the begin and end of every read, classify, write, queue wait and\n");
+	fprintf(stdout, "   durable commit of every thread, with the image and band they belong to, as a Chrome\n");
+	fprintf(stdout, "   trace. Open it in chrome://tracing or ui.perfetto.dev.\n\n");
+
+	fprintf(stdout, "Durable output:\n");
+	fprintf(stdout, "%s ... -durable [-commitfiles <count>] [-commitms <milliseconds>]\n", prgname);
+	fprintf(stdout, "  *Every output file is written under its name plus %s and only renamed to its name\n", DURABLE_TEMP_SUFFIX);
+	fprintf(stdout, "   once it is flushed to disk, so a crash never leaves a partly written output behind.\n");
+	fprintf(stdout, "  *Finished files are flushed and renamed in groups on a thread of their own, as soon as\n");
+	fprintf(stdout, "   <count> files are waiting (default %d) or the oldest has waited <milliseconds>\n", DURABLE_DEFAULT_FILES);
+	fprintf(stdout, "   (default %d). -commitfiles 1 flushes every file on its own.\n\n", DURABLE_DEFAULT_MS);
+
+	fprintf(stdout, "Deadline:\n");
+	fprintf(stdout, "%s ... -deadline <milliseconds>\n", prgname);
+	fprintf(stdout, "  *Stops each hide or extract, of a single image, a batch job, a scheduled cover or a\n");
+	fprintf(stdout, "   request ring slot, that is still running <milliseconds> after it started. It is\n");
+	fprintf(stdout, "   stopped between bands, nothing is written for it and the run goes on with the next.\n");
+	fprintf(stdout, "   Ring callers may set a deadline of their own per slot.\n\n");
+
+	fprintf(stdout, "Lanes:\n");
+	fprintf(stdout, "%s -batch <job file> | -serve <ring name> ... [-lanes <megapixels>] [-laneburst <jobs>]\n", prgname);
+	fprintf(stdout, "  *Batch jobs and ring requests are costed from their image size and message size. Those\n");
+	fprintf(stdout, "   above <megapixels> of work (default %d) run a band at a time behind the smaller ones,\n", LANE_DEFAULT_MEGAPIXELS);
+	fprintf(stdout, "   which run whole, and get a band after every <jobs> small ones (default %d) so they\n", LANE_DEFAULT_BURST);
+	fprintf(stdout, "   keep moving. -lanes 0 runs everything in arrival order. The latency of each lane is\n");
+	fprintf(stdout, "   printed as a histogram when the run ends, and kept in the ring header.\n\n");
+
+	fprintf(stdout, "Batch:\n");
+	fprintf(stdout, "%s -batch <job file> [-io overlapped|threads] [-qd <depth>]\n", prgname);
+	fprintf(stdout, "  *Each line of the job file is one of:\n");
+	fprintf(stdout, "     hide <cover file> <msg file | random> <stego file>\n");
+	fprintf(stdout, "     extract <stego file> <key value> <message file>\n");
+	fprintf(stdout, "  *File names containing spaces must be put in double quotes.\n");
+	fprintf(stdout, "  *Up to <depth> reads and <depth> writes are kept in flight while images are processed.\n");
+	fprintf(stdout, "  *The default backend is overlapped I/O with a depth of %d, threads is the fallback.\n\n", IO_DEFAULT_QUEUE_DEPTH);
+
+	fprintf(stdout, "Schedule messages onto a pool of covers:\n");
+	fprintf(stdout, "%s -schedule <schedule file> [-catalogue <file>] [-o <manifest file>]\n", prgname);
+	fprintf(stdout, "  *Each line of the schedule file is one of:\n");
+	fprintf(stdout, "     cover <cover file> <stego file>\n");
+	fprintf(stdout, "     message <msg file>\n");
+	fprintf(stdout, "  *The exact capacity of every cover is kept in the catalogue (default %s)\n", SCHEDULE_DEFAULT_CATALOGUE);
+	fprintf(stdout, "   and only recomputed when the cover file changes.\n");
+	fprintf(stdout, "  *Messages are packed onto as few covers as possible, the covers are hidden in parallel.\n");
+	fprintf(stdout, "  *The manifest (default %s) lists the key of each stego file and\n", SCHEDULE_DEFAULT_MANIFEST);
+	fprintf(stdout, "   the offset of each message in what is extracted from it.\n\n");
+
+	fprintf(stdout, "Serve requests from a shared memory ring:\n");
+	fprintf(stdout, "%s -serve <ring name> [-slots <count>] [-slotmb <megabytes>] [-b <bits>] [-permute <seed>] [-verify]\n", prgname);
+	fprintf(stdout, "  *Callers on the same machine place decoded pixels and a message in a slot of the ring\n");
+	fprintf(stdout, "   (RequestRing.h), the hide or extract is done in place in the slot, no files are used.\n");
+	fprintf(stdout, "  *Default %d slots of %d MB. Runs until a caller sends a shutdown request,\n", RING_DEFAULT_SLOTS, RING_DEFAULT_SLOT_MB);
+	fprintf(stdout, "   bdpp_ringdemo is a sample caller.\n\n");
+
 	fprintf(stdout, "Help:\n");
 	fprintf(stdout, "%s -h\n", prgname);
 	fprintf(stdout, "  *Displays this help screen\n----------------------------------------------\n");
@@ -276,6 +558,38 @@ void Usage(char* programName)
 	fprintf(stdout, "Set the value of the extraction key:	-k ( Positive Integer )\n");
 	fprintf(stdout, "Set the value of the message file: . -m < filename.bmp >\n");
 	fprintf(stdout, "Set the value of the output file: .. -o < filename.bmp >\n");
+	fprintf(stdout, "Set the bits hidden per block: ..... -b ( 1 - 9 )\n");
+	fprintf(stdout, "Report the full hiding capacity: ... -fullcapacity\n");
+	fprintf(stdout, "Verify a hide as it is written: .... -verify\n");
+	fprintf(stdout, "Write the classifier analysis: ..... -analysis < filename.csv >\n");
+	fprintf(stdout, "Remember classified rows: .......... -memo ( Megabytes )\n");
+	fprintf(stdout, "Hide in a sub-rectangle: ........... -rect ( x y width height )\n");
+	fprintf(stdout, "Set the analysis grid tile size: ... -tile ( Positive Integer )\n");
+	fprintf(stdout, "Permute the block order: ........... -permute ( Positive Integer )\n");
+	fprintf(stdout, "Seed the random message data: ...... -seed ( Positive Integer )\n");
+	fprintf(stdout, "Set the classifier kernel: ......... -kernel ( auto | table | swar | sse42 | avx2 | avx512 | neon )\n");
+	fprintf(stdout, "Check the classifier kernel: ....... -selftest\n");
+	fprintf(stdout, "Stream the image in bands: ......... -pipeline\n");
+	fprintf(stdout, "Report memory use on exit: ......... -memstats ( text | json )\n");
+	fprintf(stdout, "Write a trace on exit: ............. -trace < filename.json >\n");
+	fprintf(stdout, "Write outputs crash-safe: .......... -durable\n");
+	fprintf(stdout, "Set the files committed together: .. -commitfiles ( Positive Integer )\n");
+	fprintf(stdout, "Set the longest commit wait: ....... -commitms ( Milliseconds )\n");
+	fprintf(stdout, "Stop requests after a time: ........ -deadline ( Milliseconds )\n");
+	fprintf(stdout, "Set the large job threshold: ....... -lanes ( Megapixels, 0 for one lane )\n");
+	fprintf(stdout, "Set the small jobs per large band: . -laneburst ( Positive Integer )\n");
+	fprintf(stdout, "Estimate capacity: ................. -estimate\n");
+	fprintf(stdout, "Set the estimate sample rows: ...... -samples ( Positive Integer )\n");
+	fprintf(stdout, "Count the capacity of covers: ...... -capacity < filename.bmp ... >\n");
+	fprintf(stdout, "Print the capacities as JSON: ...... -json\n");
+	fprintf(stdout, "Run a batch job file: .............. -batch < filename >\n");
+	fprintf(stdout, "Set the batch I/O backend: ......... -io ( overlapped | threads )\n");
+	fprintf(stdout, "Set the batch I/O queue depth: ..... -qd ( Positive Integer )\n");
+	fprintf(stdout, "Run a schedule file: ............... -schedule < filename >\n");
+	fprintf(stdout, "Set the capacity catalogue: ........ -catalogue < filename >\n");
+	fprintf(stdout, "Serve a shared memory ring: ........ -serve < ring name >\n");
+	fprintf(stdout, "Set the request ring slots: ........ -slots ( 1 - %d )\n", RING_MAX_SLOTS);
+	fprintf(stdout, "Set the request ring slot size: .... -slotmb ( Megabytes )\n");
 
 
 	fprintf(stdout, "\n\tNOTES:\n\t1. Order of parameters is irrelevant.\n\t2. All selections in \"[]\" are optional.\n\n");
@@ -352,7 +666,16 @@ void parseCommandLine(int argc, char* argv[])
 				exit(-2);
 			}
 
-			GetFullPathName(argv[cnt], MAX_PATH, gStegoPathFileName, &gStegoFileName);
+			if (strcmp(argv[cnt], "-") == 0)
+			{
+				// the stego image comes from standard input
+				strcpy(gStegoPathFileName, "-");
+				gStegoFileName = gStegoPathFileName;
+			}
+			else
+			{
+				GetFullPathName(argv[cnt], MAX_PATH, gStegoPathFileName, &gStegoFileName);
+			}
 		}
 		else if (_stricmp(argv[cnt], "-o") == 0)	// output file
 		{
@@ -382,6 +705,22 @@ void parseCommandLine(int argc, char* argv[])
 
 			gKey = atoi(argv[cnt]);
 		}
+		else if (_stricmp(argv[cnt], "-b") == 0)	// bits per block
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no number of bits following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gNumBits2Hide = atoi(argv[cnt]);
+			if (gNumBits2Hide < 1 || gNumBits2Hide > 9)
+			{
+				fprintf(stderr, "\n\nError - bits per block must be between 1 and 9.\n\n");
+				exit(-1);
+			}
+		}
 		else if (_stricmp(argv[cnt], "-h") == 0)	// help
 		{
 			Usage(argv[0]);
@@ -404,270 +743,1323 @@ void parseCommandLine(int argc, char* argv[])
 			GetFullPathName(argv[cnt], MAX_PATH, gCoverPathFileName, &gCoverFileName);
 			gInfo = 1;
 		}
-		else if (_stricmp(argv[cnt], "-hide") == 0)	// hide
+		else if (_stricmp(argv[cnt], "-batch") == 0)	// batch job file
 		{
-			if (gAction)
+			cnt++;
+			if (cnt == argc)
 			{
-				fprintf(stderr, "\n\nError, an action has already been specified.\n\n");
+				fprintf(stderr, "\n\nError - no file name following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
 
-			gAction = ACTION_HIDE;
+			if (gBatchPathFileName[0] != 0)
+			{
+				fprintf(stderr, "\n\nError - batch file <%s> already specified.\n\n", gBatchPathFileName);
+				exit(-2);
+			}
+
+			GetFullPathName(argv[cnt], MAX_PATH, gBatchPathFileName, &gBatchFileName);
 		}
-		else if (_stricmp(argv[cnt], "-extract") == 0)	// extract
+		else if (_stricmp(argv[cnt], "-schedule") == 0)	// cover pool and message queue
 		{
-			if (gAction)
+			cnt++;
+			if (cnt == argc)
 			{
-				fprintf(stderr, "\n\nError, an action has already been specified.\n\n");
+				fprintf(stderr, "\n\nError - no file name following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
-			gAction = ACTION_EXTRACT;
 
+			if (gSchedulePathFileName[0] != 0)
+			{
+				fprintf(stderr, "\n\nError - schedule file <%s> already specified.\n\n", gSchedulePathFileName);
+				exit(-2);
+			}
+
+			GetFullPathName(argv[cnt], MAX_PATH, gSchedulePathFileName, &gScheduleFileName);
 		}
-		else
+		else if (_stricmp(argv[cnt], "-catalogue") == 0)	// cached cover capacities
 		{
-			fprintf(stderr, "\n\nError - unknown parameter <%s>.\n\n", argv[cnt]);
-			exit(-1);
-		}
-
-		cnt++;
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no file name following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
 
-		// error checking for parameters
-		if (gInfo == 0)
+			GetFullPathName(argv[cnt], MAX_PATH, gCataloguePathFileName, &gCatalogueFileName);
+		}
+		else if (_stricmp(argv[cnt], "-serve") == 0)	// shared memory request ring
 		{
-			if (cnt == argc && gAction == 0)
+			cnt++;
+			if (cnt == argc)
 			{
-				fprintf(stderr, "\n\nError - no action specified.\n\n");
+				fprintf(stderr, "\n\nError - no ring name following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
-			if (cnt == argc && gAction == 0)
+
+			strncpy(gRingName, argv[cnt], MAX_PATH - 1);
+			gRingName[MAX_PATH - 1] = 0;
+		}
+		else if (_stricmp(argv[cnt], "-slots") == 0)	// request ring slots
+		{
+			cnt++;
+			if (cnt == argc)
 			{
-				fprintf(stderr, "\n\nError - no action specified.\n\n");
+				fprintf(stderr, "\n\nError - no slot count following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
-			if (cnt == argc && gAction == ACTION_EXTRACT && gKey == -1)
+
+			gRingSlots = atoi(argv[cnt]);
+			if (gRingSlots < 1 || gRingSlots > RING_MAX_SLOTS)
 			{
-				fprintf(stderr, "\n\nError - no key specified.\n\n");
+				fprintf(stderr, "\n\nError - slot count must be between 1 and %d.\n\n", RING_MAX_SLOTS);
 				exit(-1);
 			}
-			if (cnt == argc && gOutputPathFileName[0] == 0)
+		}
+		else if (_stricmp(argv[cnt], "-slotmb") == 0)	// request ring slot size
+		{
+			cnt++;
+			if (cnt == argc)
 			{
-				if (gAction == ACTION_HIDE)
-				{
-					GetFullPathName("hiding_output.bmp", MAX_PATH, gOutputPathFileName, &gOutputFileName);
-				}
-				else if (gAction == ACTION_EXTRACT)
-				{
-					GetFullPathName("extraction_output.bin", MAX_PATH, gOutputPathFileName, &gOutputFileName);
-				}
+				fprintf(stderr, "\n\nError - no slot size following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
 			}
-			if (cnt == argc && gMsgPathFileName[0] == 0 && gAction == ACTION_HIDE)
+
+			gRingSlotMegabytes = atoi(argv[cnt]);
+			if (gRingSlotMegabytes < 1 || gRingSlotMegabytes > 1024)
 			{
-				fprintf(stderr, "\n\nError - no message file specified.\n\n");
+				fprintf(stderr, "\n\nError - slot size must be between 1 and 1024 megabytes.\n\n");
 				exit(-1);
 			}
-			if (cnt == argc && gStegoPathFileName[0] == 0 && gAction == ACTION_EXTRACT)
+		}
+		else if (_stricmp(argv[cnt], "-io") == 0)	// batch I/O backend
+		{
+			cnt++;
+			if (cnt == argc)
 			{
-				fprintf(stderr, "\n\nError - no stego file specified.\n\n");
+				fprintf(stderr, "\n\nError - no backend following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
-			if (cnt == argc && gCoverPathFileName[0] == 0 && gAction == ACTION_HIDE)
+
+			if (_stricmp(argv[cnt], "overlapped") == 0)
 			{
-				fprintf(stderr, "\n\nError - no cover file specified.\n\n");
+				gIoBackendChoice = IO_BACKEND_OVERLAPPED;
+			}
+			else if (_stricmp(argv[cnt], "threads") == 0)
+			{
+				gIoBackendChoice = IO_BACKEND_THREADS;
+			}
+			else
+			{
+				fprintf(stderr, "\n\nError - unknown I/O backend <%s>.\n\n", argv[cnt]);
 				exit(-1);
 			}
 		}
-		else
+		else if (_stricmp(argv[cnt], "-qd") == 0)	// batch I/O queue depth
 		{
-			if (cnt == argc && gCoverPathFileName[0] == 0)
+			cnt++;
+			if (cnt == argc)
 			{
-				fprintf(stderr, "\n\nError - no cover file specified.\n\n");
+				fprintf(stderr, "\n\nError - no queue depth following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
-		}
-
-	} // end while loop
-
-	return;
-} // parseCommandLine
-
-// Main function
-// Parameters are used to indicate the input file and available options
-int main(int argc, char* argv[])
-{
-	unsigned char* coverData, * pixelData, * messageData, * msgPixelData;  // used to store file data for cover and message
-	unsigned char* extractBits;  // used to store extracted bits
 
-
-	// get the number of bits to use for data hiding or data extracting
-	// if not specified, default to one
-	initGlobals();
-
-	parseCommandLine(argc, argv);
-
-	// take appropriate actions based on user inputs
-	// example opening cover bitmap
-
-	// Necessary to display information about the bitmap file and exit before any other action
-	if (gInfo == 1)
-	{
-		if (gCoverPathFileName[0] != 0)
+			gQueueDepth = atoi(argv[cnt]);
+			if (gQueueDepth < 1)
+			{
+				fprintf(stderr, "\n\nError - queue depth must be a positive integer.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-seed") == 0)	// seed for random message data
 		{
-			coverData = readBitmapFile(gCoverPathFileName, &gCoverFileSize);
-
-			if (!isValidBitMap(coverData))
+			cnt++;
+			if (cnt == argc)
 			{
-				printf("Error - %s is not a valid bitmap file.\n\n", gCoverPathFileName);
+				fprintf(stderr, "\n\nError - no seed value following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
 
-			gpTypeFileHdr = (BITMAPFILEHEADER*)coverData;
-
-			gpTypeFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
-
-			// there might not exist a palette - I don't check here, but you can see how in display info
-			gpCoverPalette = (RGBQUAD*)((char*)coverData + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER));
-
-			pixelData = coverData + gpTypeFileHdr->bfOffBits;
-
-			displayFileInfo(gCoverPathFileName, gpTypeFileHdr, gpTypeFileInfoHdr, gpCoverPalette, pixelData);
-			exit(0);
+			gSeed = strtoull(argv[cnt], NULL, 10);
+			gSeedGiven = 1;
 		}
-	} // end if gInfo
-
-	// hide or extract data
-	if (gAction == ACTION_HIDE)
-	{
-		if (gCoverPathFileName[0] != 0)
+		else if (_stricmp(argv[cnt], "-memstats") == 0)	// memory statistics report
 		{
-			coverData = readBitmapFile(gCoverPathFileName, &gCoverFileSize);
-
-			if (!isValidBitMap(coverData))  //  check if cover is usable for hiding, should be bmp
+			cnt++;
+			if (cnt == argc)
 			{
-				printf("Error - %s is not a valid bitmap file.\n\n", gCoverPathFileName);
+				fprintf(stderr, "\n\nError - no format following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
 
-			gpTypeFileHdr = (BITMAPFILEHEADER*)coverData;
-
-			gpTypeFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
-
-			// there might not exist a palette - I don't check here, but you can see how in display info
-			gpCoverPalette = (RGBQUAD*)((char*)coverData + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER));
-
-			pixelData = coverData + gpTypeFileHdr->bfOffBits;
-
-			//  check if message is random, if so generate random data based on the cover image width 
-			// (almost guarantees data will be small enough to hide)
-			if (_stricmp(gMsgFileName, "random") == 0)
+			if (_stricmp(argv[cnt], "text") == 0)
 			{
-				// generate random data
-				srand((unsigned int)time(NULL));
-				unsigned int maxMsgFilesSize = gpTypeFileInfoHdr->biWidth;
-				gMsgFileSize = rand() % maxMsgFilesSize;
-				messageData = (unsigned char*)malloc(sizeof(unsigned char) * gMsgFileSize);
-				printf("\nRandom message data size: %d", gMsgFileSize);
-				for (int i = 0; i < gMsgFileSize; i++)
-				{
-					messageData[i] = rand() % 256;
-				}
-				msgPixelData = messageData;  //  no header data
+				gMemStats = MEMSTATS_TEXT;
 			}
-			else  //  read the file and check if it is a bitmap or not
+			else if (_stricmp(argv[cnt], "json") == 0)
 			{
-				messageData = readBitmapFile(gMsgPathFileName, &gMsgFileSize);
-				if (isValidBitMap(messageData))
-				{
-					gpMsgFileHdr = (BITMAPFILEHEADER*)messageData;
-					gpMsgFileInfoHdr = (BITMAPINFOHEADER*)(messageData + sizeof(BITMAPFILEHEADER));
-					msgPixelData = messageData + gpTypeFileHdr->bfOffBits;
-				}
-				else
-				{
-					msgPixelData = messageData;
-					gMsgFileSize *= 8;
-				}
+				gMemStats = MEMSTATS_JSON;
+			}
+			else
+			{
+				fprintf(stderr, "\n\nError - unknown memory statistics format <%s>.\n\n", argv[cnt]);
+				exit(-1);
 			}
-			// extract bits needs to bee set to be able to enter parsePixelData, so we allocate the bare minimum
-			extractBits = (unsigned char*)malloc(sizeof(unsigned char) * 1);
-			printf("\nAttempting to hide in %s\n", gCoverPathFileName);
 		}
-		else
+		else if (_stricmp(argv[cnt], "-estimate") == 0)	// sampled capacity estimate
 		{
-			printf("Error - no cover file specified.\n\n");
-			exit(-1);
+			if (gAction)
+			{
+				fprintf(stderr, "\n\nError, an action has already been specified.\n\n");
+				exit(-1);
+			}
+			gAction = ACTION_ESTIMATE;
 		}
-	}
-	else if (gAction == ACTION_EXTRACT)
-	{
-		// basic setting to prep the data for parsing (reading checking)
-		if (gStegoPathFileName[0] != 0)
+		else if (_stricmp(argv[cnt], "-capacity") == 0)	// exact capacity of a list of covers
 		{
-			//have to allocate msgPixelData to be able to enter parsePixelData
-			//we allocate the expected size of the hidden message plust a little extra just in case
-			msgPixelData = (unsigned char*)malloc(sizeof(unsigned char) * gKey * 2);
-			coverData = readBitmapFile(gStegoPathFileName, &gStegoFileSize);
-
-			if (!isValidBitMap(coverData))
+			cnt++;
+			if (cnt == argc || argv[cnt][0] == '-')
 			{
-				printf("Error - %s is not a valid bitmap file.\n\n", gStegoPathFileName);
+				fprintf(stderr, "\n\nError - no file name following '%s' parameter.\n\n", argv[cnt - 1]);
 				exit(-1);
 			}
 
-			gpTypeFileHdr = (BITMAPFILEHEADER*)coverData;
-
-			gpTypeFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
-
-			pixelData = coverData + gpTypeFileHdr->bfOffBits;
-
-			// there might not exist a palette - I don't check here, but you can see how in display info
-			gpStegoPalette = (RGBQUAD*)((char*)coverData + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER));
-
-			// extractBits is allocated to the size of the key since the key is the size of the hidden message
-			extractBits = (unsigned char*)malloc(sizeof(unsigned char) * gKey);
-			printf("\nAttempting to extract from %s\n", gStegoPathFileName);
+			if (gNumCapacityFiles != 0)
+			{
+				fprintf(stderr, "\n\nError - capacity files already specified.\n\n");
+				exit(-2);
+			}
 
+			// every argument up to the next one starting with '-' is a cover, so a shell wildcard can name them,
+			// the usage text says how to give a cover whose name starts with '-'
+			gCapacityFileNames = &argv[cnt];
+			gNumCapacityFiles = 1;
+			while (cnt + 1 < argc && argv[cnt + 1][0] != '-')
+			{
+				cnt++;
+				gNumCapacityFiles++;
+			}
 		}
-		else
+		else if (_stricmp(argv[cnt], "-json") == 0)	// -capacity records as JSON
 		{
-			printf("Error - no stego file specified.\n\n");
-			exit(-1);
+			gCapacityJson = 1;
 		}
-	}
-
-	// parse the pixel data, hides, extracts, and performs all checks for the BDPP algorithm
-	parsePixelData(gpTypeFileInfoHdr, pixelData, msgPixelData, &gMsgFileSize, extractBits, gKey, gAction);
-
-	unsigned char headerData[14];
-	unsigned char headerDataInfo[40];
-	memcpy(headerData, coverData, 14);
-	memcpy(headerDataInfo, coverData + 14, 40);
-	FILE* f1;
-	size_t count = gpTypeFileHdr->bfSize - gpTypeFileHdr->bfOffBits;
-	switch (gAction)
-	{
-	case ACTION_HIDE:
-	{
-		f1 = fopen(gOutputFileName, "wb");
-		fwrite(headerData, 1, 14, f1);
-		fwrite(headerDataInfo, 1, 40, f1);
-		fwrite(gpCoverPalette, 1, 8, f1);
-		fwrite(pixelData, 1, count, f1);
-		fclose(f1);
+		else if (_stricmp(argv[cnt], "-samples") == 0)	// rows of blocks sampled by -estimate
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no sample count following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
 
-		printf("Message hidden in %s\n", gOutputPathFileName);
-		break;
+			gEstimateSamples = atoi(argv[cnt]);
+			if (gEstimateSamples < 1)
+			{
+				fprintf(stderr, "\n\nError - sample count must be a positive integer.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-permute") == 0)	// key-derived block order
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no seed following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gPermuteSeed = strtoull(argv[cnt], NULL, 10);
+			gPermute = 1;
+		}
+		else if (_stricmp(argv[cnt], "-analysis") == 0)	// classifier statistics and capacity grid
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no file name following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			GetFullPathName(argv[cnt], MAX_PATH, gAnalysisPathFileName, &gAnalysisFileName);
+		}
+		else if (_stricmp(argv[cnt], "-trace") == 0)	// Chrome trace of the phases of every thread
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no file name following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			GetFullPathName(argv[cnt], MAX_PATH, gTracePathFileName, &gTraceFileName);
+		}
+		else if (_stricmp(argv[cnt], "-tile") == 0)	// blocks per side of an analysis grid tile
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no tile size following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gAnalysisTile = atoi(argv[cnt]);
+			if (gAnalysisTile < 1)
+			{
+				fprintf(stderr, "\n\nError - tile size must be a positive integer.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-rect") == 0)	// hide in or extract from a sub-rectangle
+		{
+			if (cnt + 4 >= argc)
+			{
+				fprintf(stderr, "\n\nError - '%s' must be followed by x, y, width and height.\n\n", argv[cnt]);
+				exit(-1);
+			}
+
+			gRectX = atoi(argv[cnt + 1]);
+			gRectY = atoi(argv[cnt + 2]);
+			gRectWidth = atoi(argv[cnt + 3]);
+			gRectHeight = atoi(argv[cnt + 4]);
+			cnt += 4;
+			if (gRectX < 0 || gRectY < 0 || gRectWidth < 3 || gRectHeight < 3)
+			{
+				fprintf(stderr, "\n\nError - the rectangle must start inside the image and be at least 3x3 pixels.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-durable") == 0)	// write outputs under a temporary name and commit them in groups
+		{
+			gDurable = 1;
+		}
+		else if (_stricmp(argv[cnt], "-commitfiles") == 0)	// outputs committed together by -durable
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no file count following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gCommitFiles = atoi(argv[cnt]);
+			if (gCommitFiles < 1)
+			{
+				fprintf(stderr, "\n\nError - commit file count must be a positive integer.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-commitms") == 0)	// longest a finished output waits for its group
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no interval following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gCommitMilliseconds = atoi(argv[cnt]);
+			if (gCommitMilliseconds < 0)
+			{
+				fprintf(stderr, "\n\nError - commit interval must be zero or more milliseconds.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-deadline") == 0)	// longest a hide or extract may run
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no time following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			if (atoi(argv[cnt]) < 1)
+			{
+				fprintf(stderr, "\n\nError - deadline must be a positive number of milliseconds.\n\n");
+				exit(-1);
+			}
+			gDeadlineMilliseconds = (unsigned int)atoi(argv[cnt]);
+		}
+		else if (_stricmp(argv[cnt], "-lanes") == 0)	// cost above which a batch job or ring request is large
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no megapixels following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gLaneMegapixels = atoi(argv[cnt]);
+			if (gLaneMegapixels < 0)
+			{
+				fprintf(stderr, "\n\nError - lane megapixels must be 0 or a positive integer.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-laneburst") == 0)	// small jobs run before a large one gets a band
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no job count following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gLaneBurst = atoi(argv[cnt]);
+			if (gLaneBurst < 1)
+			{
+				fprintf(stderr, "\n\nError - lane burst must be a positive integer.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-memo") == 0)	// remember classified rows of blocks
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no memory size following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gBandMemoMegabytes = atoi(argv[cnt]);
+			if (gBandMemoMegabytes < 1 || gBandMemoMegabytes > 4096)
+			{
+				fprintf(stderr, "\n\nError - memo size must be between 1 and 4096 megabytes.\n\n");
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-verify") == 0)	// read back every block a hide writes
+		{
+			gVerify = 1;
+		}
+		else if (_stricmp(argv[cnt], "-kernel") == 0)	// how rows of blocks are classified
+		{
+			cnt++;
+			if (cnt == argc)
+			{
+				fprintf(stderr, "\n\nError - no kernel following '%s' parameter.\n\n", argv[cnt - 1]);
+				exit(-1);
+			}
+
+			gKernel = findKernel(argv[cnt]);
+			if (gKernel == KERNEL_COUNT)
+			{
+				fprintf(stderr, "\n\nError - unknown kernel <%s>.\n\n", argv[cnt]);
+				exit(-1);
+			}
+		}
+		else if (_stricmp(argv[cnt], "-selftest") == 0)	// check every kernel against the reference
+		{
+			gSelfTest = 1;
+		}
+		else if (_stricmp(argv[cnt], "-fullcapacity") == 0)	// classify every block when hiding
+		{
+			gFullCapacity = 1;
+		}
+		else if (_stricmp(argv[cnt], "-pipeline") == 0)	// stream the image in bands
+		{
+			gPipeline = 1;
+		}
+		else if (_stricmp(argv[cnt], "-hide") == 0)	// hide
+		{
+			if (gAction)
+			{
+				fprintf(stderr, "\n\nError, an action has already been specified.\n\n");
+				exit(-1);
+			}
+
+			gAction = ACTION_HIDE;
+		}
+		else if (_stricmp(argv[cnt], "-extract") == 0)	// extract
+		{
+			if (gAction)
+			{
+				fprintf(stderr, "\n\nError, an action has already been specified.\n\n");
+				exit(-1);
+			}
+			gAction = ACTION_EXTRACT;
+
+		}
+		else
+		{
+			fprintf(stderr, "\n\nError - unknown parameter <%s>.\n\n", argv[cnt]);
+			exit(-1);
+		}
+
+		cnt++;
+
+		// error checking for parameters
+		if (cnt == argc && gAnalysisPathFileName[0] != 0 && (gBatchPathFileName[0] != 0 || gSchedulePathFileName[0] != 0 || gRingName[0] != 0 || gNumCapacityFiles != 0))
+		{
+			fprintf(stderr, "\n\nError - -analysis describes a single hide or extract and cannot be used with -batch, -schedule, -serve or -capacity.\n\n");
+			exit(-1);
+		}
+		if (cnt == argc && gRectWidth != 0 && (gBatchPathFileName[0] != 0 || gSchedulePathFileName[0] != 0 || gRingName[0] != 0 || gNumCapacityFiles != 0))
+		{
+			fprintf(stderr, "\n\nError - -rect applies to a single hide or extract and cannot be used with -batch, -schedule, -serve or -capacity.\n\n");
+			exit(-1);
+		}
+		if (gBatchPathFileName[0] != 0)
+		{
+			// every job in the batch file carries its own action and files
+		}
+		else if (gNumCapacityFiles != 0)
+		{
+			// the covers follow -capacity, nothing else is needed
+		}
+		else if (gRingName[0] != 0)
+		{
+			// every request placed in the ring carries its own action, image and message
+		}
+		else if (gSelfTest)
+		{
+			// the self test needs no action, -c only adds a cover to check
+		}
+		else if (gSchedulePathFileName[0] != 0)
+		{
+			// the schedule file lists the covers and messages, -o names the manifest
+			if (cnt == argc && gOutputPathFileName[0] == 0)
+			{
+				GetFullPathName(SCHEDULE_DEFAULT_MANIFEST, MAX_PATH, gOutputPathFileName, &gOutputFileName);
+			}
+			if (cnt == argc && gCataloguePathFileName[0] == 0)
+			{
+				GetFullPathName(SCHEDULE_DEFAULT_CATALOGUE, MAX_PATH, gCataloguePathFileName, &gCatalogueFileName);
+			}
+		}
+		else if (gInfo == 0)
+		{
+			if (cnt == argc && gAction == 0)
+			{
+				fprintf(stderr, "\n\nError - no action specified.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gAction == 0)
+			{
+				fprintf(stderr, "\n\nError - no action specified.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gPermute && gPipeline)
+			{
+				fprintf(stderr, "\n\nError - -permute needs the whole image and cannot be used with -pipeline.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gRectWidth != 0 && (gPipeline || gAction == ACTION_ESTIMATE))
+			{
+				fprintf(stderr, "\n\nError - -rect cannot be used with -pipeline or -estimate, they read the whole width of the image.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gAction == ACTION_EXTRACT && gKey == -1)
+			{
+				fprintf(stderr, "\n\nError - no key specified.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gOutputPathFileName[0] == 0)
+			{
+				if (gAction == ACTION_HIDE)
+				{
+					GetFullPathName("hiding_output.bmp", MAX_PATH, gOutputPathFileName, &gOutputFileName);
+				}
+				else if (gAction == ACTION_EXTRACT)
+				{
+					GetFullPathName("extraction_output.bin", MAX_PATH, gOutputPathFileName, &gOutputFileName);
+				}
+			}
+			if (cnt == argc && gMsgPathFileName[0] == 0 && gAction == ACTION_HIDE)
+			{
+				fprintf(stderr, "\n\nError - no message file specified.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gStegoPathFileName[0] == 0 && gAction == ACTION_EXTRACT)
+			{
+				fprintf(stderr, "\n\nError - no stego file specified.\n\n");
+				exit(-1);
+			}
+			if (cnt == argc && gCoverPathFileName[0] == 0 && (gAction == ACTION_HIDE || gAction == ACTION_ESTIMATE))
+			{
+				fprintf(stderr, "\n\nError - no cover file specified.\n\n");
+				exit(-1);
+			}
+		}
+		else
+		{
+			if (cnt == argc && gCoverPathFileName[0] == 0)
+			{
+				fprintf(stderr, "\n\nError - no cover file specified.\n\n");
+				exit(-1);
+			}
+		}
+
+	} // end while loop
+
+	return;
+} // parseCommandLine
+
+// copies the next whitespace separated token of a batch file line, double quotes group a token
+// returns 0 when the line has no more tokens
+int nextBatchToken(char** cursor, char* token, int tokenSize)
+{
+	char* p = *cursor;
+	int length = 0;
+
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+	if (*p == 0) return 0;
+
+	if (*p == '"')
+	{
+		p++;
+		while (*p != 0 && *p != '"')
+		{
+			if (length < tokenSize - 1) token[length++] = *p;
+			p++;
+		}
+		if (*p == '"') p++;
+	}
+	else
+	{
+		while (*p != 0 && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+		{
+			if (length < tokenSize - 1) token[length++] = *p;
+			p++;
+		}
+	}
+	token[length] = 0;
+	*cursor = p;
+	return 1;
+} // nextBatchToken
+
+// reads the batch file into an array of jobs, blank lines and lines starting with # are skipped
+static batchJob* readBatchFile(char* batchFileName, int* numJobs)
+{
+	FILE* ptrFile;
+	char line[3 * MAX_PATH + 64];
+	char action[16], input[MAX_PATH], second[MAX_PATH], output[MAX_PATH];
+	batchJob* jobs = NULL;
+	int capacity = 0;
+	int lineNumber = 0;
+
+	*numJobs = 0;
+	ptrFile = fopen(batchFileName, "r");
+	if (ptrFile == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", batchFileName);
+		exit(-1);
+	}
+
+	while (fgets(line, sizeof(line), ptrFile) != NULL)
+	{
+		char* cursor = line;
+		lineNumber++;
+		if (!nextBatchToken(&cursor, action, sizeof(action)) || action[0] == '#') continue;
+
+		if (!nextBatchToken(&cursor, input, MAX_PATH) || !nextBatchToken(&cursor, second, MAX_PATH)
+			|| !nextBatchToken(&cursor, output, MAX_PATH))
+		{
+			printf("Error - batch file line %d needs an action and three values.\n\n", lineNumber);
+			exit(-1);
+		}
+
+		if (*numJobs == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 16;
+			jobs = (batchJob*)trackedRealloc(jobs, sizeof(batchJob) * capacity, MEM_SITE_BOOKKEEPING);
+			if (jobs == NULL)
+			{
+				printf("Error - Could not allocate memory for %d batch jobs.\n\n", capacity);
+				exit(-1);
+			}
+		}
+
+		batchJob* job = &jobs[*numJobs];
+		memset(job, 0, sizeof(batchJob));
+		strcpy(job->inputFile, input);
+		strcpy(job->outputFile, output);
+		if (_stricmp(action, "hide") == 0)
+		{
+			job->action = ACTION_HIDE;
+			strcpy(job->msgFile, second);
+		}
+		else if (_stricmp(action, "extract") == 0)
+		{
+			job->action = ACTION_EXTRACT;
+			job->key = atoi(second);
+		}
+		else
+		{
+			printf("Error - unknown action <%s> on batch file line %d.\n\n", action, lineNumber);
+			exit(-1);
+		}
+
+		// an input produced by an earlier job cannot be read ahead, it may still be in the write queue,
+		// and an output written twice must be written in the order of the file
+		for (int i = 0; i < *numJobs; i++)
+		{
+			if (_stricmp(jobs[i].outputFile, job->inputFile) == 0
+				|| (job->action == ACTION_HIDE && _stricmp(jobs[i].outputFile, job->msgFile) == 0)
+				|| _stricmp(jobs[i].outputFile, job->outputFile) == 0)
+			{
+				job->readsOwnOutput = 1;
+			}
+		}
+		(*numJobs)++;
+	}
+	fclose(ptrFile);
+	return jobs;
+} // readBatchFile
+
+// queues the reads a job needs so they overlap with the processing of earlier jobs
+static void submitBatchReads(batchJob* job)
+{
+	job->inputRead = ioSubmitRead(job->inputFile);
+	job->msgRead = NULL;
+	if (job->action == ACTION_HIDE && _stricmp(job->msgFile, "random") != 0)
+	{
+		job->msgRead = ioSubmitRead(job->msgFile);
+	}
+} // submitBatchReads
+
+// waits for the buffers read for a job and sets up its hide or extract without processing any bands,
+// this follows the same steps as main does for a single image
+static int startBatchJob(batchJob* job)
+{
+	unsigned char* coverData, * pixelData, * messageData = NULL, * msgPixelData, * extractBits;
+	unsigned int coverSize, msgSize = 0;
+	BITMAPFILEHEADER* pFileHdr;
+	BITMAPINFOHEADER* pFileInfoHdr;
+	imageView image;
+
+	// a read that could not be queued is waited on as a failed one
+	int msgQueued = job->action == ACTION_HIDE && _stricmp(job->msgFile, "random") != 0;
+	coverData = ioWaitRead(job->inputRead, &coverSize);
+	if (msgQueued)
+	{
+		messageData = ioWaitRead(job->msgRead, &msgSize);
+	}
+	job->inputRead = job->msgRead = NULL;
+
+	if (coverData == NULL || (msgQueued && messageData == NULL))
+	{
+		printf("Error in opening file: %s.\n\n", coverData == NULL ? job->inputFile : job->msgFile);
+		trackedFree(coverData);
+		trackedFree(messageData);
+		return FAILURE;
+	}
+
+	if (!isValidBitMap(coverData))
+	{
+		printf("Error - %s is not a valid bitmap file.\n\n", job->inputFile);
+		trackedFree(coverData);
+		trackedFree(messageData);
+		return FAILURE;
+	}
+
+	pFileHdr = (BITMAPFILEHEADER*)coverData;
+	pFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
+	if (!isSupportedBitmap(coverData, coverSize))
+	{
+		trackedFree(coverData);
+		trackedFree(messageData);
+		return FAILURE;
+	}
+	pixelData = coverData + pFileHdr->bfOffBits;
+	initImageView(&image, pFileInfoHdr, pixelData);
+
+	if (job->action == ACTION_HIDE)
+	{
+		if (_stricmp(job->msgFile, "random") == 0)
+		{
+			// random message data based on the cover image width, same as the single image path
+			messageData = generateRandomMessage(&job->random, pFileInfoHdr->biWidth, &msgSize);
+			msgPixelData = messageData;
+		}
+		else if (isValidBitMap(messageData))
+		{
+			msgPixelData = messageData + ((BITMAPFILEHEADER*)messageData)->bfOffBits;
+		}
+		else
+		{
+			msgPixelData = messageData;
+			msgSize *= 8;
+		}
+		extractBits = (unsigned char*)trackedMalloc(sizeof(unsigned char) * 1, MEM_SITE_EXTRACT);
+		printf("\nAttempting to hide in %s\n", job->inputFile);
+	}
+	else
+	{
+		msgPixelData = (unsigned char*)trackedMalloc(sizeof(unsigned char) * job->key * 2, MEM_SITE_MESSAGE);
+		extractBits = (unsigned char*)trackedMalloc(sizeof(unsigned char) * job->key, MEM_SITE_EXTRACT);
+		messageData = msgPixelData;
+		printf("\nAttempting to extract from %s\n", job->inputFile);
+	}
+
+	// every job has a deadline of its own, one that runs out is not written and the batch goes on
+	job->coverData = coverData;
+	job->coverSize = coverSize;
+	job->messageData = messageData;
+	job->extractBits = extractBits;
+	initRequest(&job->request, gDeadlineMilliseconds);
+	if (startPixelData(&job->work, &image, msgPixelData, msgSize, extractBits, job->key, job->action, &job->request) != SUCCESS)
+	{
+		trackedFree(coverData);
+		trackedFree(messageData);
+		trackedFree(extractBits);
+		return FAILURE;
+	}
+	return SUCCESS;
+} // startBatchJob
+
+// prints the outcome of a started job once its bands are done or it stopped, and queues its output write
+static int finishBatchJob(batchJob* job, int status)
+{
+	unsigned char* outputData;
+	unsigned int outputSize;
+
+	// other jobs ran between the bands of a large one, so its results say whose they are
+	if (job->lane == LANE_THROUGHPUT)
+	{
+		printf("\nResults of %s (throughput lane)\n", job->inputFile);
+	}
+	if (finishPixelData(&job->work, status) != SUCCESS)
+	{
+		// a hide that failed -verify is not written
+		reportRequestStop(&job->request, job->action == ACTION_HIDE ? "hide" : "extract");
+		trackedFree(job->coverData);
+		trackedFree(job->messageData);
+		trackedFree(job->extractBits);
+		return FAILURE;
+	}
+
+	if (job->action == ACTION_HIDE)
+	{
+		// the pixels were changed in place, so the cover buffer is the stego file as it is,
+		// header, palette and all, and is handed over to the writer without a copy
+		outputData = job->coverData;
+		outputSize = job->coverSize;
+		trackedFree(job->extractBits);
+		printf("Message hidden in %s\n", job->outputFile);
+	}
+	else
+	{
+		outputData = job->extractBits;
+		outputSize = job->key;
+		trackedFree(job->coverData);
+		printf("Message extracted to %s\n", job->outputFile);
+	}
+	trackedFree(job->messageData);
+
+	return ioSubmitWrite(job->outputFile, outputData, outputSize);
+} // finishBatchJob
+
+// reads the image size of a job's input and the size of its message to estimate what the job costs,
+// a job whose files cannot be read costs nothing, it fails as soon as it runs
+static unsigned long long estimateBatchJobCost(batchJob* job)
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	unsigned long long payloadBits;
+	FILE* ptrFile = fopen(job->inputFile, "rb");
+
+	if (ptrFile == NULL) return 0;
+	if (fread(&fileHdr, sizeof(fileHdr), 1, ptrFile) != 1 || fread(&fileInfo, sizeof(fileInfo), 1, ptrFile) != 1)
+	{
+		fclose(ptrFile);
+		return 0;
+	}
+	fclose(ptrFile);
+
+	if (job->action == ACTION_EXTRACT)
+	{
+		payloadBits = job->key > 0 ? job->key : 0;
+	}
+	else if (_stricmp(job->msgFile, "random") == 0)
+	{
+		// the jobs may run in any order, so each draws its message from where the generator was when
+		// it was read, and the generator is moved on as though the message had been drawn then
+		unsigned int msgSize;
+		job->random = gRandom;
+		trackedFree(generateRandomMessage(&gRandom, fileInfo.biWidth > 0 ? fileInfo.biWidth : 0, &msgSize));
+		payloadBits = msgSize;
+	}
+	else
+	{
+		payloadBits = 0;
+		ptrFile = fopen(job->msgFile, "rb");
+		if (ptrFile != NULL)
+		{
+			fseek(ptrFile, 0, SEEK_END);
+			long msgBytes = ftell(ptrFile);
+			payloadBits = msgBytes > 0 ? (unsigned long long)msgBytes * 8 : 0;
+			fclose(ptrFile);
+		}
+	}
+	return estimateJobCost(fileInfo.biWidth, fileInfo.biHeight, payloadBits);
+} // estimateBatchJobCost
+
+// keeps the reads of the next gQueueDepth jobs of the latency lane and of the throughput lane's head in flight
+static void submitLaneReads(batchJob* jobs, laneScheduler* lanes)
+{
+	for (int lane = 0; lane < LANE_COUNT; lane++)
+	{
+		int ahead = lane == LANE_LATENCY ? gQueueDepth : 1;
+		for (int i = 0; i < lanes->count[lane] && i < ahead; i++)
+		{
+			batchJob* job = &jobs[lanes->jobs[lane][(lanes->head[lane] + i) % lanes->capacity]];
+			if (!job->readQueued)
+			{
+				submitBatchReads(job);
+				job->readQueued = 1;
+			}
+		}
+	}
+} // submitLaneReads
+
+int runBatch(char* batchFileName)
+{
+	batchJob* jobs;
+	laneScheduler lanes;
+	LARGE_INTEGER arrival;
+	int numJobs, failed = 0, numLarge = 0;
+	clock_t start = clock();
+
+	jobs = readBatchFile(batchFileName, &numJobs);
+	if (initLanes(&lanes, numJobs, (unsigned long long)gLaneMegapixels * 1000000, gLaneBurst) != SUCCESS)
+	{
+		trackedFree(jobs);
+		return FAILURE;
+	}
+	for (int i = 0; i < numJobs; i++)
+	{
+		jobs[i].cost = estimateBatchJobCost(&jobs[i]);
+		if (gLaneMegapixels != 0 && jobs[i].cost > lanes.splitCost) numLarge++;
+	}
+	ioInit(gIoBackendChoice, gQueueDepth);
+	printf("\nRunning %d batch jobs from %s (I/O backend: %s, queue depth: %d)\n",
+		numJobs, batchFileName, ioBackendName(), gQueueDepth);
+	printf("Lanes: %d latency, %d throughput jobs above %d megapixels of work\n", numJobs - numLarge, numLarge, gLaneMegapixels);
+
+	// every job arrives when the batch starts, so its latency is the time until it is written out
+	QueryPerformanceCounter(&arrival);
+
+	// a job reading an earlier job's output, or writing the same file, waits for every job before it and
+	// for their writes, so the jobs between two of them are scheduled together
+	for (int first = 0; first < numJobs;)
+	{
+		int end = first + 1;
+		while (end < numJobs && !jobs[end].readsOwnOutput) end++;
+		if (jobs[first].readsOwnOutput)
+		{
+			// with -durable the earlier output is only there once it is renamed to its final name
+			failed += ioDrain();
+			if (durableDrain() != SUCCESS) failed++;
+		}
+		for (int i = first; i < end; i++)
+		{
+			jobs[i].lane = pushLaneJob(&lanes, i, jobs[i].cost);
+		}
+
+		// small jobs run whole, the large one at the head of the throughput lane a band at a time in between
+		for (int lane = nextLane(&lanes); lane >= 0; lane = nextLane(&lanes))
+		{
+			batchJob* job = &jobs[peekLaneJob(&lanes, lane)];
+			submitLaneReads(jobs, &lanes);
+			if (lane == LANE_LATENCY)
+			{
+				if (startBatchJob(job) != SUCCESS || finishBatchJob(job, continuePixelData(&job->work, INT_MAX)) != SUCCESS) failed++;
+				popLaneJob(&lanes, lane, arrival);
+				continue;
+			}
+
+			int status = SUCCESS;
+			if (!job->started)
+			{
+				job->started = 1;
+				if (startBatchJob(job) != SUCCESS)
+				{
+					failed++;
+					popLaneJob(&lanes, lane, arrival);
+					continue;
+				}
+			}
+			status = continuePixelData(&job->work, 1);
+			if (status != SUCCESS || isPixelDataDone(&job->work))
+			{
+				if (finishBatchJob(job, status) != SUCCESS) failed++;
+				popLaneJob(&lanes, lane, arrival);
+			}
+		}
+		first = end;
+	}
+
+	failed += ioDrain();
+	ioShutdown();
+	trackedFree(jobs);
+	freeLanes(&lanes);
+
+	printf("\nBatch complete: %d jobs, %d failed, %.2f seconds\n",
+		numJobs, failed, (double)(clock() - start) / CLOCKS_PER_SEC);
+	printLaneHistograms(stdout, lanes.histograms);
+	return failed == 0 ? SUCCESS : FAILURE;
+} // runBatch
+
+// hides or extracts with the image streamed through the reader, BDPP and writer threads
+// the message is prepared the same way as in main, only the cover is never loaded whole
+static int runPipelineAction()
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	unsigned char* messageData = NULL, * msgPixelData = NULL, * extractBits = NULL;
+	requestContext request;
+	int status;
+
+	initRequest(&request, gDeadlineMilliseconds);
+	if (gAction == ACTION_HIDE)
+	{
+		if (readBitmapHeader(gCoverPathFileName, &fileHdr, &fileInfo) != SUCCESS) return FAILURE;
+
+		if (_stricmp(gMsgFileName, "random") == 0)
+		{
+			messageData = generateRandomMessage(&gRandom, fileInfo.biWidth, &gMsgFileSize);
+			printf("\nRandom message data size: %d", gMsgFileSize);
+			msgPixelData = messageData;
+		}
+		else
+		{
+			messageData = readBitmapFile(gMsgPathFileName, &gMsgFileSize);
+			if (messageData == NULL) return FAILURE;
+			if (isValidBitMap(messageData))
+			{
+				msgPixelData = messageData + fileHdr.bfOffBits;
+			}
+			else
+			{
+				msgPixelData = messageData;
+				gMsgFileSize *= 8;
+			}
+		}
+		printf("\nAttempting to hide in %s\n", gCoverPathFileName);
+		status = runPipeline(gCoverPathFileName, gOutputFileName, msgPixelData, gMsgFileSize, NULL, gKey, gAction, &request);
+		if (status == SUCCESS) printf("Message hidden in %s\n", gOutputPathFileName);
+	}
+	else
+	{
+		extractBits = (unsigned char*)trackedMalloc(sizeof(unsigned char) * gKey, MEM_SITE_EXTRACT);
+		printf("\nAttempting to extract from %s\n", gStegoPathFileName);
+		status = runPipeline(gStegoPathFileName, NULL, NULL, 0, extractBits, gKey, gAction, &request);
+		if (status == SUCCESS)
+		{
+			status = writeFile(gOutputFileName, gKey, extractBits);
+			if (status == SUCCESS) printf("Message extracted to %s\n", gOutputPathFileName);
+		}
+	}
+	reportRequestStop(&request, gAction == ACTION_HIDE ? "hide" : "extract");
+
+	trackedFree(messageData);
+	trackedFree(extractBits);
+	return status;
+} // runPipelineAction
+
+// prints the memory statistics when the program exits, registered with atexit for -memstats
+static void reportMemStatsAtExit()
+{
+	printMemStats(stdout, gMemStats);
+} // reportMemStatsAtExit
+
+// Main function
+// Parameters are used to indicate the input file and available options
+int main(int argc, char* argv[])
+{
+	unsigned char* coverData, * pixelData, * messageData, * msgPixelData;  // used to store file data for cover and message
+	unsigned char* extractBits;  // used to store extracted bits
+
+
+	// get the number of bits to use for data hiding or data extracting
+	// if not specified, default to one
+	initGlobals();
+
+	parseCommandLine(argc, argv);
+
+	// hiding positions of every block pattern for the chosen number of bits per block
+	initBlockPositions(gNumBits2Hide);
+
+	// rows of blocks classified once are remembered for the rest of the run
+	if (gBandMemoMegabytes > 0 && initBandMemo(gBandMemoMegabytes) != SUCCESS)
+	{
+		printf("Error - Could not allocate the band memo.\n\n");
+		exit(-1);
+	}
+
+	// random message data comes from the seeded generator, the clock is the seed unless -seed was given
+	seedRandom(&gRandom, gSeedGiven ? gSeed : (unsigned long long)time(NULL));
+
+	// every way out of the program, including errors, reports the memory use
+	if (gMemStats != MEMSTATS_OFF)
+	{
+		atexit(reportMemStatsAtExit);
+	}
+
+	// the trace is written on the way out as well, every thread records from here on
+	if (gTracePathFileName[0] != 0 && startTrace(gTracePathFileName) != SUCCESS)
+	{
+		exit(-1);
+	}
+
+	// outputs are written under a temporary name and renamed once a group of them is on disk
+	if (gDurable && startDurable(gCommitFiles, gCommitMilliseconds) != SUCCESS)
+	{
+		exit(-1);
+	}
+
+	// take appropriate actions based on user inputs
+	// example opening cover bitmap
+
+	// Necessary to display information about the bitmap file and exit before any other action
+	if (gInfo == 1)
+	{
+		if (gCoverPathFileName[0] != 0)
+		{
+			coverData = readBitmapFile(gCoverPathFileName, &gCoverFileSize);
+			if (coverData == NULL)
+			{
+				exit(-1);
+			}
+
+			if (!isValidBitMap(coverData))
+			{
+				printf("Error - %s is not a valid bitmap file.\n\n", gCoverPathFileName);
+				exit(-1);
+			}
+
+			gpTypeFileHdr = (BITMAPFILEHEADER*)coverData;
+
+			gpTypeFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
+
+			// there might not exist a palette - I don't check here, but you can see how in display info
+			// the palette follows the info header, which is longer than 40 bytes in V4 and V5 bitmaps
+			gpCoverPalette = (RGBQUAD*)((char*)coverData + sizeof(BITMAPFILEHEADER) + gpTypeFileInfoHdr->biSize);
+
+			pixelData = coverData + gpTypeFileHdr->bfOffBits;
+
+			displayFileInfo(gCoverPathFileName, gpTypeFileHdr, gpTypeFileInfoHdr, gpCoverPalette, pixelData);
+			exit(0);
+		}
+	} // end if gInfo
+
+	// the kernels everything below classifies and packs with
+	if (selectKernel(gKernel) != SUCCESS)
+	{
+		exit(-1);
+	}
+
+	// check every kernel against the reference checks, on every block of the cover as well if one is given
+	if (gSelfTest)
+	{
+		imageView image, * cover = NULL;
+		if (gCoverPathFileName[0] != 0)
+		{
+			coverData = readBitmapFile(gCoverPathFileName, &gCoverFileSize);
+			if (coverData == NULL)
+			{
+				exit(-1);
+			}
+			if (!isValidBitMap(coverData))
+			{
+				printf("Error - %s is not a valid bitmap file.\n\n", gCoverPathFileName);
+				exit(-1);
+			}
+			gpTypeFileHdr = (BITMAPFILEHEADER*)coverData;
+			gpTypeFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
+			if (!isSupportedBitmap(coverData, gCoverFileSize))
+			{
+				exit(-1);
+			}
+			initImageView(&image, gpTypeFileInfoHdr, coverData + gpTypeFileHdr->bfOffBits);
+			cover = &image;
+		}
+		exit(selfTestClassifier(cover) == SUCCESS ? 0 : -1);
+	}
+
+	// run every job listed in the batch file, then exit
+	if (gBatchPathFileName[0] != 0)
+	{
+		exit(finishDurable(runBatch(gBatchPathFileName)) == SUCCESS ? 0 : -1);
+	}
+
+	// pack the queued messages onto the cover pool, hide them and exit
+	if (gSchedulePathFileName[0] != 0)
+	{
+		exit(finishDurable(runSchedule(gSchedulePathFileName, gCataloguePathFileName, gOutputPathFileName, gNumBits2Hide)) == SUCCESS ? 0 : -1);
+	}
+
+	// hide and extract in place in the slots of a shared memory request ring until a caller stops it
+	if (gRingName[0] != 0)
+	{
+		exit(runRingServer(gRingName, gRingSlots, gRingSlotMegabytes, gNumBits2Hide) == SUCCESS ? 0 : -1);
+	}
+
+	// count the exact capacity of every cover given and exit
+	if (gNumCapacityFiles != 0)
+	{
+		exit(runCapacityScan(gCapacityFileNames, gNumCapacityFiles, gNumBits2Hide, gCapacityJson) == SUCCESS ? 0 : -1);
+	}
+
+	// estimate the capacity from a sample of the cover and exit
+	if (gAction == ACTION_ESTIMATE)
+	{
+		exit(runEstimate(gCoverPathFileName, gMsgPathFileName, gEstimateSamples, &gRandom) == SUCCESS ? 0 : -1);
+	}
+
+	// stream the image through the pipeline stages instead of loading it whole
+	if (gPipeline && gAction != 0)
+	{
+		exit(finishDurable(runPipelineAction()) == SUCCESS ? 0 : -1);
+	}
+
+	// hide or extract data
+	if (gAction == ACTION_HIDE)
+	{
+		if (gCoverPathFileName[0] != 0)
+		{
+			coverData = readBitmapFile(gCoverPathFileName, &gCoverFileSize);
+			if (coverData == NULL)
+			{
+				exit(-1);
+			}
+
+			if (!isValidBitMap(coverData))  //  check if cover is usable for hiding, should be bmp
+			{
+				printf("Error - %s is not a valid bitmap file.\n\n", gCoverPathFileName);
+				exit(-1);
+			}
+
+			// 1-bit covers, or 8-bit grayscale ones hidden in their lowest bit-plane, checked against the bytes
+			// read before any header field is used
+			if (!isSupportedBitmap(coverData, gCoverFileSize))
+			{
+				exit(-1);
+			}
+
+			gpTypeFileHdr = (BITMAPFILEHEADER*)coverData;
+
+			gpTypeFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
+
+			// there might not exist a palette - I don't check here, but you can see how in display info
+			// the palette follows the info header, which is longer than 40 bytes in V4 and V5 bitmaps
+			gpCoverPalette = (RGBQUAD*)((char*)coverData + sizeof(BITMAPFILEHEADER) + gpTypeFileInfoHdr->biSize);
+
+			pixelData = coverData + gpTypeFileHdr->bfOffBits;
+
+			//  check if message is random, if so generate random data based on the cover image width 
+			// (almost guarantees data will be small enough to hide)
+			if (_stricmp(gMsgFileName, "random") == 0)
+			{
+				// generate random data
+				unsigned int maxMsgFilesSize = gpTypeFileInfoHdr->biWidth;
+				messageData = generateRandomMessage(&gRandom, maxMsgFilesSize, &gMsgFileSize);
+				printf("\nRandom message data size: %d", gMsgFileSize);
+				msgPixelData = messageData;  //  no header data
+			}
+			else  //  read the file and check if it is a bitmap or not
+			{
+				messageData = readBitmapFile(gMsgPathFileName, &gMsgFileSize);
+				if (messageData == NULL)
+				{
+					exit(-1);
+				}
+				if (isValidBitMap(messageData))
+				{
+					gpMsgFileHdr = (BITMAPFILEHEADER*)messageData;
+					gpMsgFileInfoHdr = (BITMAPINFOHEADER*)(messageData + sizeof(BITMAPFILEHEADER));
+					msgPixelData = messageData + gpMsgFileHdr->bfOffBits;
+				}
+				else
+				{
+					msgPixelData = messageData;
+					gMsgFileSize *= 8;
+				}
+			}
+			// extract bits needs to bee set to be able to enter parsePixelData, so we allocate the bare minimum
+			extractBits = (unsigned char*)trackedMalloc(sizeof(unsigned char) * 1, MEM_SITE_EXTRACT);
+			printf("\nAttempting to hide in %s\n", gCoverPathFileName);
+		}
+		else
+		{
+			printf("Error - no cover file specified.\n\n");
+			exit(-1);
+		}
+	}
+	else if (gAction == ACTION_EXTRACT)
+	{
+		if (gStegoPathFileName[0] != 0)
+		{
+			// extractBits is allocated to the size of the key since the key is the size of the hidden message
+			extractBits = (unsigned char*)trackedMalloc(sizeof(unsigned char) * gKey, MEM_SITE_EXTRACT);
+			printf("\nAttempting to extract from %s\n", gStegoPathFileName);
+
+			// the stego file is streamed a row of blocks at a time and only read up to the last hidden bit,
+			// the rest of the image is never loaded
+			requestContext request;
+			initRequest(&request, gDeadlineMilliseconds);
+			if (runStreamExtract(gStegoPathFileName, extractBits, gKey, &request) != SUCCESS)
+			{
+				reportRequestStop(&request, "extract");
+				exit(-1);
+			}
+			if (writeFile(gOutputFileName, gKey, extractBits) != SUCCESS)
+			{
+				exit(-1);
+			}
+			printf("Message extracted to %s\n", gOutputPathFileName);
+			trackedFree(extractBits);
+			exit(finishDurable(SUCCESS) == SUCCESS ? 0 : -1);
+		}
+		else
+		{
+			printf("Error - no stego file specified.\n\n");
+			exit(-1);
+		}
+	}
+
+	// the pixels are reached through a view, so top-down rows need no reordering, and -rect
+	// narrows the view to the part of the cover the message goes in
+	imageView image;
+	initImageView(&image, gpTypeFileInfoHdr, pixelData);
+	if (gRectWidth != 0 && cropImageView(&image, gRectX, gRectY, gRectWidth, gRectHeight) != SUCCESS)
+	{
+		printf("Error - the rectangle given with -rect is not inside the %dx%d cover.\n\n", image.width, image.height);
+		exit(-1);
+	}
+
+	// parse the pixel data, hides, extracts, and performs all checks for the BDPP algorithm
+	// a hide that fails -verify is still written so it can be inspected, but the exit code reports it;
+	// one stopped by -deadline is left half done and not written
+	requestContext request;
+	initRequest(&request, gDeadlineMilliseconds);
+	int status = parsePixelData(&image, msgPixelData, &gMsgFileSize, extractBits, gKey, gAction, &request);
+	if (reportRequestStop(&request, "hide") || request.stopReason == REQUEST_FAILED)
+	{
+		trackedFree(coverData);
+		trackedFree(messageData);
+		trackedFree(extractBits);
+		exit(-1);
 	}
-	case ACTION_EXTRACT:
+
+	switch (gAction)
+	{
+	case ACTION_HIDE:
 	{
-		f1 = fopen(gOutputFileName, "wb");
-		fwrite(extractBits, 1, gKey, f1);
-		fclose(f1);
-		printf("Message extracted to %s\n", gOutputPathFileName);
+		// the pixels were changed in place, so the cover is written back byte for byte with its
+		// header, palette and anything stored after the pixels kept as they were read
+		if (writeFile(gOutputFileName, gCoverFileSize, coverData) != SUCCESS)
+		{
+			exit(-1);
+		}
+
+		printf("Message hidden in %s\n", gOutputPathFileName);
 		break;
 	}
 	}
-	return 0;
+	return finishDurable(status) == SUCCESS ? 0 : -1;
 } // main
 
 
@@ -13,11 +13,18 @@
 #include <time.h>
 #include <math.h>
 
+#include "Permutation.h"
+#include "Analysis.h"
+#include "ImageView.h"
+#include "BlockSlice.h"
+#include "Request.h"
+
 #define SUCCESS 0
 #define FAILURE -1
 
 #define ACTION_HIDE		1
 #define ACTION_EXTRACT	2
+#define ACTION_ESTIMATE	3	// classify only, nothing is embedded or extracted
 
 #define VERSION "1.0"
 
@@ -66,17 +73,348 @@ struct blockInfo
     blockRatios currentBlockRatios;  // structure to store the ratios for the ratio check
 };  // blockInfo
 
+/*
+* Structure: bandState
+* Usage: bandState state;
+* ------------------------------------------------------
+* This structure carries a hide or extract across the
+* bands of an image. Bands are whole rows of blocks, so
+* an image can be processed in one piece or one band at
+* a time while it is streamed in, with the same results.
+*/
+struct bandState
+{
+    int action;                   // ACTION_HIDE, ACTION_EXTRACT or ACTION_ESTIMATE (count only)
+    int width;                    // image width in pixels
+    int blockWidth;               // blocks per row of blocks
+    int blockHeight;              // rows of blocks in the image
+    int totalPossibleBlocks;
+    unsigned char* msgPixelData;  // message bits to hide, most significant bit first
+    unsigned int totalMsgBits;
+    unsigned char* extractedBits; // one byte per extracted bit
+    int key;                      // bits to extract, or the generated key after hiding
+    unsigned int bitIndex;        // message bits embedded or extracted so far
+    int embeddableBlocks;
+    int capacityBits;             // bits the embeddable blocks can carry
+    int blocksUsed;               // blocks that received or gave up message bits
+    int blocksClassified;         // blocks the BDPP checks were run on
+    int blocksSkipped;            // all 0 or all 1 blocks passed over a 64 pixel word at a time (-kernel table)
+    int kernel;                   // KERNEL_TABLE ... KERNEL_NEON, the kernels rows of blocks are classified with (-kernel)
+    int blocksRemembered;         // blocks of rows the band memo had seen, not classified again
+    int memo;                     // 1 to look rows of blocks up in the band memo (-memo)
+    int memoLookups;
+    int memoHits;
+    int fullCapacity;             // 1 to keep classifying after the message is placed
+    int permuted;                 // 1 to visit the blocks in the order of permutation
+    blockPermutation permutation; // key-derived block order, -permute only
+    int verify;                   // 1 to read back every block a hide writes (-verify)
+    int verifiedBlocks;
+    int verifyFailures;           // blocks that did not read back as written
+    unsigned int streamChecksum;  // running CRC-32 of the bits hidden or extracted
+    classifierAnalysis* analysis; // rejection counts and capacity grid, -analysis only
+    int traceImage;               // image id of the trace events, -trace only
+    requestContext* request;      // deadline, cancellation and progress, NULL for none
+};  // bandState
+
+/*
+* Structure: pixelWork
+* Usage: pixelWork work; startPixelData(&work, &image, ...);
+* ------------------------------------------------------
+* This structure is the hide or extract of an image held
+* in memory, processed a few bands at a time so other
+* work can run in between. parsePixelData is one of
+* them run start to finish.
+*/
+struct pixelWork
+{
+    imageView image;              // the cover or stego pixels
+    imageView bands;              // what the bands are cut from, the image or its packed bit-plane
+    unsigned char* plane;         // packed bit-plane of an 8-bit image, NULL otherwise
+    bandState state;
+    int nextBlockRow;             // first row of blocks still to be processed
+};  // pixelWork
+
+/*
+* Structure: blockPositions
+* Usage: blockPositions* positions = &gBlockPositions[pattern];
+* ------------------------------------------------------
+* This structure lists the pixels of a 3x3 block that
+* carry message bits, in the order the bits are hidden.
+* A position is row * 3 + column with row 0 the bottom
+* row of the block, so the middle pixel is position 4.
+*/
+struct blockPositions
+{
+    int count;                    // bits the block carries, 0 if it is not embeddable
+    int position[9];
+};  // blockPositions
+
+extern blockPositions gBlockPositions[512];
+
+// 1 if a hide should classify every block to report the full capacity (-fullcapacity)
+extern int gFullCapacity;
+
+// 1 if hide and extract visit the blocks in a key-derived order (-permute), and its seed
+extern int gPermute;
+extern unsigned long long gPermuteSeed;
+
+// 1 if hides read back and check every block they write (-verify)
+extern int gVerify;
+
+// the kernels asked for, KERNEL_AUTO for the widest the processor runs (-kernel)
+extern int gKernel;
+
+// milliseconds each hide or extract may run before it is stopped, 0 for no limit (-deadline)
+extern unsigned int gDeadlineMilliseconds;
+
+// estimated megapixels of work above which a batch job or ring request is large (-lanes, 0 for one lane),
+// and the small ones run before a large one gets its next band (-laneburst)
+extern int gLaneMegapixels;
+extern int gLaneBurst;
+
+// CSV file for the classifier analysis (-analysis), empty if none, and its grid tile size (-tile)
+extern char gAnalysisPathFileName[MAX_PATH];
+extern int gAnalysisTile;
+
+// sub-rectangle hidden in or extracted from (-rect), top left pixel and size, a width of 0 means the whole image
+extern int gRectX, gRectY, gRectWidth, gRectHeight;
+
+/*
+* Structure: batchJob
+* Usage: batchJob* job = &jobs[i];
+* ------------------------------------------------------
+* This structure stores one line of a batch file, a
+* hide or an extract with its input and output files,
+* the reads queued for it while earlier jobs are still
+* being processed, and its buffers and bands while it is
+* run. The jobs are not moved once they are read, their
+* work points at their request.
+*/
+struct batchJob
+{
+    int action;                   // ACTION_HIDE or ACTION_EXTRACT
+    char inputFile[MAX_PATH];     // cover file (hide) or stego file (extract)
+    char msgFile[MAX_PATH];       // message file or "random", hide only
+    char outputFile[MAX_PATH];
+    int key;                      // extract only
+    int readsOwnOutput;           // 1 if an earlier job writes one of this job's inputs or its output
+    int readQueued;               // 1 once the reads below have been submitted
+    struct ioRequest* inputRead;  // queued read of inputFile
+    struct ioRequest* msgRead;    // queued read of msgFile, NULL if none
+    unsigned long long cost;      // estimated pixels of work, see estimateJobCost
+    int lane;                     // LANE_LATENCY or LANE_THROUGHPUT
+    int started;                  // 1 once a throughput lane job has been set up
+    unsigned char* coverData;     // the buffers of a started job
+    unsigned int coverSize;
+    unsigned char* messageData;
+    unsigned char* extractBits;
+    bdppRandom random;            // the generator as it was for this job, random messages only
+    requestContext request;       // the job's deadline and progress
+    pixelWork work;               // the job's bands
+};  // batchJob
+
+/*
+* Function: runBatch
+* Usage: runBatch(gBatchPathFileName);
+* ------------------------------------------------------
+* This function runs every job listed in a batch file.
+* Reads for the next jobs and writes of finished ones
+* are kept in flight through the asynchronous I/O layer
+* while the current image is being processed. Small jobs
+* run ahead of large ones, which run a band at a time in
+* between, see Lanes.h.
+*/
+int runBatch(char* batchFileName);
+
+/*
+* Function: nextBatchToken
+* Usage: nextBatchToken(&cursor, token, sizeof(token));
+* ------------------------------------------------------
+* This function copies the next whitespace separated
+* token of a batch or schedule file line, double quotes
+* group a token. It returns 0 when the line has no more
+* tokens.
+*/
+int nextBatchToken(char** cursor, char* token, int tokenSize);
+
+/*
+* Function: readBitmapFile
+* Usage: fileData = readBitmapFile(fileName, &fileSize);
+* ------------------------------------------------------
+* This function reads a whole file into memory and sets
+* fileSize to its length. It returns NULL after printing
+* why if the file cannot be read. Release the data with
+* trackedFree.
+*/
+unsigned char* readBitmapFile(char* fileName, unsigned int* fileSize);
+
 /*
 * Function: parsePixelData
-* Usage: parsePixelData(pFileInfo, pixelData, msgPixelData, gMsgFileSize, extractedBits, gKey, action);
+* Usage: parsePixelData(&image, msgPixelData, gMsgFileSize, extractedBits, gKey, action, &request);
 * ------------------------------------------------------
 * This function is used to parse the pixel data from the
 * image run the BDPP algorithm to embed or extract data
 * and then reassamble the pixel data to be written back,
-* or to be used for extraction.
+* or to be used for extraction. The image is a view of a
+* 1-bit or 8-bit grayscale cover, or of a sub-rectangle
+* of one, already checked with isSupportedBitmap. It
+* returns FAILURE without reporting results if request
+* stops it, request may be NULL.
+*/
+int parsePixelData(imageView* image, unsigned char* msgPixelData, unsigned int* gMsgFileSize,
+    unsigned char* extractBytes, int gKey, int action, requestContext* request);
+
+/*
+* Function: initBlockPositions
+* Usage: initBlockPositions(gNumBits2Hide);
+* ------------------------------------------------------
+* This function builds the table of hiding positions
+* for all 512 block patterns with up to bitsPerBlock
+* bits per block. It must be called before any image is
+* processed, hide and extract must use the same value.
+*/
+void initBlockPositions(int bitsPerBlock);
+
+/*
+* Function: initBandState
+* Usage: initBandState(&state, &image, msgPixelData, msgBits, extractedBits, gKey, action);
+* ------------------------------------------------------
+* This function sets up the state that carries the
+* message position and the block counts from one band
+* of the image to the next. Hides stop classifying
+* blocks once the message is placed unless
+* gFullCapacity is set. The state has no request until
+* the caller sets one. Returns FAILURE if the -analysis
+* counts could not be allocated.
+*/
+int initBandState(bandState* state, const imageView* image, unsigned char* msgPixelData,
+    unsigned int msgBits, unsigned char* extractedBits, int gKey, int action);
+
+/*
+* Function: processBand
+* Usage: processBand(&state, &band, firstBlockRow, numBlockRows);
+* ------------------------------------------------------
+* This function generates the blocks of numBlockRows
+* rows of blocks, runs the BDPP checks on them and embeds
+* or extracts the message bits in the embeddable ones.
+* Row 0 of the band view is the first pixel row of the
+* band, its pixels are 1 bit each. Returns FAILURE if
+* the band could not be processed.
+*/
+int processBand(bandState* state, imageView* band, int firstBlockRow, int numBlockRows);
+
+/*
+* Function: processBands
+* Usage: if (processBands(&state, &image) != SUCCESS) ...
+* ------------------------------------------------------
+* This function processes a whole image held in memory
+* one band at a time, looking at the request of the
+* state before each band and counting them off as its
+* progress. Returns FAILURE as soon as the request stops
+* or a band fails, the request says which.
+*/
+int processBands(bandState* state, imageView* image);
+
+/*
+* Function: countBands
+* Usage: setRequestBands(state->request, countBands(state));
+* ------------------------------------------------------
+* This function returns the bands processBands cuts an
+* image held in memory into.
+*/
+int countBands(bandState* state);
+
+/*
+* Function: processBandsFrom
+* Usage: status = processBandsFrom(&state, &image, &nextBlockRow, maxBands);
+* ------------------------------------------------------
+* This function does the work of processBands for at
+* most maxBands bands, starting with the one at
+* nextBlockRow, and moves nextBlockRow past them. Once
+* the rest of the image is not needed nextBlockRow is
+* moved to the end.
+*/
+int processBandsFrom(bandState* state, imageView* image, int* nextBlockRow, int maxBands);
+
+/*
+* Function: startPixelData
+* Usage: startPixelData(&work, &image, msgPixelData, msgBits, extractedBits, gKey, action, &request);
+* ------------------------------------------------------
+* This function sets up the hide or extract of an image
+* held in memory without processing any of it, so the
+* bands can be run a few at a time with
+* continuePixelData. An 8-bit image has its bit-plane
+* packed here. Returns FAILURE, with the request failed,
+* if the work could not be set up.
+*/
+int startPixelData(pixelWork* work, imageView* image, unsigned char* msgPixelData, unsigned int msgBits,
+    unsigned char* extractedBits, int gKey, int action, requestContext* request);
+
+/*
+* Function: continuePixelData
+* Usage: status = continuePixelData(&work, 1);
+* ------------------------------------------------------
+* This function processes up to maxBands more bands of
+* started work. Returns FAILURE as soon as its request
+* stops or a band fails.
+*/
+int continuePixelData(pixelWork* work, int maxBands);
+
+/*
+* Function: isPixelDataDone
+* Usage: while (!isPixelDataDone(&work)) ...
+* ------------------------------------------------------
+* This function returns 1 once every band the work needs
+* has been processed.
+*/
+int isPixelDataDone(pixelWork* work);
+
+/*
+* Function: finishPixelData
+* Usage: finishPixelData(&work, status);
+* ------------------------------------------------------
+* This function ends started work. After a status of
+* SUCCESS the bit-plane of an 8-bit cover is put back and
+* the outcome printed as parsePixelData prints it, and
+* that is returned. Otherwise, or if there is no memory
+* to put the bit-plane back, what the work holds is
+* released and FAILURE returned.
+*/
+int finishPixelData(pixelWork* work, int status);
+
+/*
+* Function: releasePixelData
+* Usage: releasePixelData(&work);
+* ------------------------------------------------------
+* This function ends started work without printing or
+* putting anything back, releasing what it holds. The
+* request ring reads the outcome from the state itself.
+*/
+void releasePixelData(pixelWork* work);
+
+/*
+* Function: reportBandResults
+* Usage: reportBandResults(&state);
+* ------------------------------------------------------
+* This function prints the outcome of a hide or extract
+* once every band of the image has been processed. It
+* returns FAILURE if a hide did not pass -verify.
+*/
+int reportBandResults(bandState* state);
+
+/*
+* Function: selfTestClassifier
+* Usage: exit(selfTestClassifier(cover) == SUCCESS ? 0 : -1);
+* ------------------------------------------------------
+* This function checks every bit-sliced kernel set the
+* processor runs against the reference checks on all 512
+* block patterns, its gather against the blocks read one
+* at a time at every bit offset, its packer against the
+* bits packed one at a time, and, if cover is not NULL,
+* every block of that cover. It prints what it checked
+* and returns FAILURE on the first mismatch.
 */
-void parsePixelData(BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData,
-    unsigned char* msgPixelData, unsigned int* gMsgFileSize, unsigned char* extractBytes, int gKey, int action);
+int selfTestClassifier(const imageView* cover);
 
 /*
 * Function: printMatrix
@@ -130,9 +468,10 @@ void connectivityTest(blockInfo* currentBlock, int blockNumber);
 * then calls diagonalPartition, and connectivityTest
 * to check if the block is embeddable. If the block is
 * embeddable (isEmbeddable = 1) then the middle pixel
-* is flipped back to its original value.
+* is flipped back to its original value. Returns
+* FAILURE if the middle pixel is not a bit.
 */
-void embedData(blockInfo* currentBlock, int blockNumber);
+int embedData(blockInfo* currentBlock, int blockNumber);
 
 // the following structure information is taken from wingdi.h
 
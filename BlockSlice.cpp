@@ -0,0 +1,140 @@
+// BDPP Block Slice
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Transposes rows of blocks into pixel position words and runs the BDPP
+// checks on them bit-sliced, see BlockSlice.h. This is the portable kernel,
+// the checks themselves are in BlockSliceChecks.h and shared with the
+// vector kernels.
+//
+
+#include <string.h>
+#include "BitmapReader.h"
+#include "BlockSlice.h"
+#include "MemStats.h"
+
+// the portable kernel works on one 64-bit slice word at a time
+#define SLICE_VECTOR uint64_t
+static inline uint64_t sliceAnd(uint64_t a, uint64_t b) { return a & b; }
+static inline uint64_t sliceOr(uint64_t a, uint64_t b) { return a | b; }
+static inline uint64_t sliceXor(uint64_t a, uint64_t b) { return a ^ b; }
+static inline uint64_t sliceAndNot(uint64_t a, uint64_t b) { return a & ~b; }
+static inline uint64_t sliceNot(uint64_t a) { return ~a; }
+#include "BlockSliceChecks.h"
+
+// reverses the bits of every byte, so the first pixel of a packed byte ends up in its lowest bit
+static inline uint64_t reverseByteBits(uint64_t x)
+{
+	x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	return x;
+} // reverseByteBits
+
+// gathers bits 0, 3, 6 ... 45 of x into bits 0 to 15, every step halves the gaps between them
+static inline uint64_t compactThirds(uint64_t x)
+{
+	x &= 0x0000249249249249ULL;
+	x = (x ^ (x >> 2)) & 0x00000C30C30C30C3ULL;
+	x = (x ^ (x >> 4)) & 0x000000F00F00F00FULL;
+	x = (x ^ (x >> 8)) & 0x00000000FF0000FFULL;
+	x = (x ^ (x >> 16)) & 0x000000000000FFFFULL;
+	return x;
+} // compactThirds
+
+int allocSliceRow(sliceRow* row, int blockWidth)
+{
+	row->slices = (blockWidth + SLICE_BLOCKS - 1) / SLICE_BLOCKS;
+	row->capacity = (row->slices + SLICE_ROW_ALIGN - 1) / SLICE_ROW_ALIGN * SLICE_ROW_ALIGN;
+	row->pixels = (uint64_t*)trackedCalloc((size_t)9 * row->capacity, sizeof(uint64_t), MEM_SITE_BAND);
+	row->outcome = (uint64_t*)trackedCalloc((size_t)SLICE_OUTCOMES * row->capacity, sizeof(uint64_t), MEM_SITE_BAND);
+	if (row->pixels == NULL || row->outcome == NULL)
+	{
+		freeSliceRow(row);
+		return FAILURE;
+	}
+	return SUCCESS;
+} // allocSliceRow
+
+void freeSliceRow(sliceRow* row)
+{
+	trackedFree(row->pixels);
+	trackedFree(row->outcome);
+	row->pixels = row->outcome = NULL;
+	return;
+} // freeSliceRow
+
+void getBlockSlice(const sliceRow* row, int s, blockSlice* slice)
+{
+	slice->embeddable = row->outcome[SLICE_EMBEDDABLE * row->capacity + s];
+	slice->ratioFailures = row->outcome[SLICE_RATIO_FAILURES * row->capacity + s];
+	slice->hvdFailures = row->outcome[SLICE_HVD_FAILURES * row->capacity + s];
+	slice->flipFailures = row->outcome[SLICE_FLIP_FAILURES * row->capacity + s];
+	slice->uniqueLow = row->outcome[SLICE_UNIQUE_LOW * row->capacity + s];
+	slice->uniqueHigh = row->outcome[SLICE_UNIQUE_HIGH * row->capacity + s];
+	return;
+} // getBlockSlice
+
+void loadBlockSlice(const imageView* band, int y, int firstBlock, uint64_t pixels[9])
+{
+	size_t rowBytes = bitmapRowSize(band->bitOffset + band->width, 1);
+
+	memset(pixels, 0, 9 * sizeof(uint64_t));
+	for (int k = 0; k < 3; k++)
+	{
+		const unsigned char* row = imageRow(band, y + k);
+
+		// 16 blocks are 48 pixels, read as the little-endian word holding them with the first pixel in bit 0
+		for (int group = 0; group < SLICE_BLOCKS / 16; group++)
+		{
+			size_t bit = (size_t)band->bitOffset + (size_t)(firstBlock + group * 16) * 3;
+			size_t byte = bit / 8;
+			uint64_t word = 0;
+			if (byte + sizeof(word) <= rowBytes) memcpy(&word, row + byte, sizeof(word));
+			else if (byte < rowBytes) memcpy(&word, row + byte, rowBytes - byte);  // the end of the row
+			else break;
+			word = reverseByteBits(word) >> (bit % 8);
+
+			for (int l = 0; l < 3; l++)
+			{
+				pixels[k * 3 + l] |= compactThirds(word >> l) << (group * 16);
+			}
+		}
+	}
+	return;
+} // loadBlockSlice
+
+void classifyBlockSlice(const uint64_t pixels[9], blockSlice* slice)
+{
+	uint64_t outcome[SLICE_OUTCOMES];
+	sliceChecks(pixels, outcome);
+	slice->embeddable = outcome[SLICE_EMBEDDABLE];
+	slice->ratioFailures = outcome[SLICE_RATIO_FAILURES];
+	slice->hvdFailures = outcome[SLICE_HVD_FAILURES];
+	slice->flipFailures = outcome[SLICE_FLIP_FAILURES];
+	slice->uniqueLow = outcome[SLICE_UNIQUE_LOW];
+	slice->uniqueHigh = outcome[SLICE_UNIQUE_HIGH];
+	return;
+} // classifyBlockSlice
+
+void loadSliceRowSwar(const imageView* band, int y, sliceRow* row)
+{
+	uint64_t pixels[9];
+	for (int s = 0; s < row->slices; s++)
+	{
+		loadBlockSlice(band, y, s * SLICE_BLOCKS, pixels);
+		for (int p = 0; p < 9; p++) row->pixels[p * row->capacity + s] = pixels[p];
+	}
+	return;
+} // loadSliceRowSwar
+
+void classifySliceRowSwar(sliceRow* row)
+{
+	uint64_t pixels[9], outcome[SLICE_OUTCOMES];
+	for (int s = 0; s < row->slices; s++)
+	{
+		for (int p = 0; p < 9; p++) pixels[p] = row->pixels[p * row->capacity + s];
+		sliceChecks(pixels, outcome);
+		for (int m = 0; m < SLICE_OUTCOMES; m++) row->outcome[m * row->capacity + s] = outcome[m];
+	}
+	return;
+} // classifySliceRowSwar
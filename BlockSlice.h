@@ -0,0 +1,152 @@
+// BDPP Block Slice Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Bit-sliced BDPP checks. The 9 pixels of 64 neighbouring blocks are
+// transposed into nine 64-bit words, one per pixel position, so bit b of
+// every word belongs to block b. The ratio, HVD and flip checks are then a
+// handful of AND, OR and XOR operations on those words that decide all 64
+// blocks at once, with no table and no branch per block. The functions here
+// are the portable kernel, plain 64-bit integer operations any x86-64 or
+// ARM64 core runs; Kernels.h picks a vector kernel doing the same work on
+// several slices at once when the processor has one.
+//
+
+#pragma once
+
+#include <windows.h>
+#include <stdint.h>
+#include "ImageView.h"
+
+// how the blocks of a row are classified (-kernel)
+#define KERNEL_AUTO				-1	// the best kernel the processor supports
+#define KERNEL_TABLE			0	// one block at a time, its pattern looked up in the table of checks
+#define KERNEL_SWAR				1	// 64 blocks at a time with the bit-sliced checks on 64-bit words
+#define KERNEL_SSE42			2	// 2 slices at a time in SSE registers
+#define KERNEL_AVX2				3	// 4 slices at a time in AVX2 registers, columns gathered with BMI2 pext
+#define KERNEL_AVX512			4	// 8 slices at a time in AVX-512 registers, columns gathered with BMI2 pext
+#define KERNEL_NEON				5	// 2 slices at a time in NEON registers
+#define KERNEL_COUNT			6
+
+#define SLICE_BLOCKS			64	// blocks classified together, one per bit of a word
+#define SLICE_ROW_ALIGN			8	// slices of a row are allocated in multiples of the widest vector
+
+/*
+* Structure: blockSlice
+* Usage: blockSlice slice; classifyBlockSlice(pixels, &slice);
+* ------------------------------------------------------
+* This structure holds the outcome of the BDPP checks on
+* 64 blocks, bit b of every mask belonging to block b.
+* Every block is in exactly one of embeddable and the
+* three failure masks, the first check it fails. The
+* unique ratios of a block, 1 to 4, are the 2-bit number
+* uniqueHigh:uniqueLow plus 1.
+*/
+struct blockSlice
+{
+    uint64_t embeddable;
+    uint64_t ratioFailures;
+    uint64_t hvdFailures;
+    uint64_t flipFailures;
+    uint64_t uniqueLow;
+    uint64_t uniqueHigh;
+};  // blockSlice
+
+// the masks of a classified slice, in the order of blockSlice
+#define SLICE_EMBEDDABLE		0
+#define SLICE_RATIO_FAILURES	1
+#define SLICE_HVD_FAILURES		2
+#define SLICE_FLIP_FAILURES		3
+#define SLICE_UNIQUE_LOW		4
+#define SLICE_UNIQUE_HIGH		5
+#define SLICE_OUTCOMES			6
+
+/*
+* Structure: sliceRow
+* Usage: sliceRow row; allocSliceRow(&row, blockWidth);
+* ------------------------------------------------------
+* This structure holds a whole row of blocks as slices
+* of 64, laid out so a vector kernel loads the same word
+* of neighbouring slices at once: pixel position p of
+* slice s is pixels[p * capacity + s], and mask m of
+* slice s is outcome[m * capacity + s]. Slices past the
+* end of the row are allocated but not meaningful.
+*/
+struct sliceRow
+{
+    int slices;                   // slices of 64 blocks in the row
+    int capacity;                 // slices allocated, a multiple of SLICE_ROW_ALIGN
+    uint64_t* pixels;             // 9 * capacity pixel position words
+    uint64_t* outcome;            // SLICE_OUTCOMES * capacity masks
+};  // sliceRow
+
+/*
+* Function: allocSliceRow
+* Usage: if (allocSliceRow(&row, state->blockWidth) != SUCCESS) ...
+* ------------------------------------------------------
+* This function allocates the slices of a row of
+* blockWidth blocks, zeroed. Returns FAILURE if they
+* could not be allocated. Release them with freeSliceRow.
+*/
+int allocSliceRow(sliceRow* row, int blockWidth);
+
+/*
+* Function: freeSliceRow
+* Usage: freeSliceRow(&row);
+* ------------------------------------------------------
+* This function releases the slices of allocSliceRow.
+*/
+void freeSliceRow(sliceRow* row);
+
+/*
+* Function: getBlockSlice
+* Usage: getBlockSlice(&row, s, &slice);
+* ------------------------------------------------------
+* This function copies the outcome of slice s of a
+* classified row into slice.
+*/
+void getBlockSlice(const sliceRow* row, int s, blockSlice* slice);
+
+/*
+* Function: loadBlockSlice
+* Usage: loadBlockSlice(&band, y, firstBlock, pixels);
+* ------------------------------------------------------
+* This function transposes the 64 blocks of a row of
+* blocks starting at block firstBlock into pixels[9]. Bit
+* b of pixels[k * 3 + l] is row y + k, column l of block
+* firstBlock + b, the numbering of a block pattern. The
+* view must be 1 bit per pixel. Bits of blocks past the
+* end of the row are not meaningful, nothing past the
+* padded row is read.
+*/
+void loadBlockSlice(const imageView* band, int y, int firstBlock, uint64_t pixels[9]);
+
+/*
+* Function: classifyBlockSlice
+* Usage: classifyBlockSlice(pixels, &slice);
+* ------------------------------------------------------
+* This function runs the BDPP checks on the 64 blocks of
+* pixels[9] as loadBlockSlice lays them out, with the
+* same outcome the reference diagonalPartition,
+* connectivityTest and embedData give every block.
+*/
+void classifyBlockSlice(const uint64_t pixels[9], blockSlice* slice);
+
+/*
+* Function: loadSliceRowSwar
+* Usage: loadSliceRowSwar(&band, y, &row);
+* ------------------------------------------------------
+* This function transposes every block of the row of
+* blocks whose bottom pixel row is y into the slices of
+* row with loadBlockSlice, the portable gather kernel.
+*/
+void loadSliceRowSwar(const imageView* band, int y, sliceRow* row);
+
+/*
+* Function: classifySliceRowSwar
+* Usage: classifySliceRowSwar(&row);
+* ------------------------------------------------------
+* This function runs the BDPP checks on every slice of
+* row one 64-bit word at a time, the portable classify
+* kernel.
+*/
+void classifySliceRowSwar(sliceRow* row);
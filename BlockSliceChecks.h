@@ -0,0 +1,79 @@
+// BDPP Block Slice Checks
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The bit-sliced BDPP checks, written once for every kernel. There is no
+// #pragma once on purpose: each kernel file defines SLICE_VECTOR, a vector
+// of 64-bit slice words, and the operations below for it, then includes
+// this file to get a sliceChecks of its own.
+//
+//     sliceAnd(a, b)       a & b
+//     sliceOr(a, b)        a | b
+//     sliceXor(a, b)       a ^ b
+//     sliceAndNot(a, b)    a & ~b
+//     sliceNot(a)          ~a
+//
+
+// adds three bit-sliced bits into a 2-bit count
+static inline void sliceAddThree(SLICE_VECTOR a, SLICE_VECTOR b, SLICE_VECTOR c, SLICE_VECTOR* low, SLICE_VECTOR* high)
+{
+    SLICE_VECTOR ab = sliceXor(a, b);
+    *low = sliceXor(ab, c);
+    *high = sliceOr(sliceAnd(a, b), sliceAnd(c, ab));
+}
+
+// 1 where the 2-bit counts a1:a0 and b1:b0 differ
+static inline SLICE_VECTOR sliceDiffers(SLICE_VECTOR a0, SLICE_VECTOR a1, SLICE_VECTOR b0, SLICE_VECTOR b1)
+{
+    return sliceOr(sliceXor(a0, b0), sliceXor(a1, b1));
+}
+
+/*
+* Function: sliceChecks
+* Usage: sliceChecks(pixels, outcome);
+* ------------------------------------------------------
+* This function runs the BDPP checks on the slices held
+* in pixels[9], one pixel position each, and sets
+* outcome[SLICE_OUTCOMES] to the masks of blockSlice.
+*/
+static inline void sliceChecks(const SLICE_VECTOR pixels[9], SLICE_VECTOR outcome[SLICE_OUTCOMES])
+{
+    SLICE_VECTOR z[9];
+    for (int i = 0; i < 9; i++) z[i] = sliceNot(pixels[i]);  // the checks count and connect zeros
+
+    // every partition is the block less three pixels, so two partitions have the same ratio
+    // exactly when the same number of zeros is left out of each:
+    // upper left leaves out 5 7 8, lower right 0 1 3, upper right 3 6 7, lower left 1 2 5
+    SLICE_VECTOR ul0, ul1, lr0, lr1, ur0, ur1, ll0, ll1;
+    sliceAddThree(z[5], z[7], z[8], &ul0, &ul1);
+    sliceAddThree(z[0], z[1], z[3], &lr0, &lr1);
+    sliceAddThree(z[3], z[6], z[7], &ur0, &ur1);
+    sliceAddThree(z[1], z[2], z[5], &ll0, &ll1);
+
+    // a partition adds a new ratio when it differs from every partition before it, in the order they are counted
+    SLICE_VECTOR newLr = sliceDiffers(ul0, ul1, lr0, lr1);
+    SLICE_VECTOR newUr = sliceAnd(sliceDiffers(ul0, ul1, ur0, ur1), sliceDiffers(lr0, lr1, ur0, ur1));
+    SLICE_VECTOR newLl = sliceAnd(sliceAnd(sliceDiffers(ul0, ul1, ll0, ll1), sliceDiffers(lr0, lr1, ll0, ll1)),
+        sliceDiffers(ur0, ur1, ll0, ll1));
+    sliceAddThree(newLr, newUr, newLl, &outcome[SLICE_UNIQUE_LOW], &outcome[SLICE_UNIQUE_HIGH]);
+    SLICE_VECTOR ratioPass = sliceOr(sliceOr(newLr, newUr), newLl);
+
+    // HVD connectivity, split into the links that do not involve the middle pixel (4) and the
+    // pixels a zero in the middle links to, horizontally, diagonally and vertically
+    SLICE_VECTOR hOuter = sliceOr(sliceAnd(z[1], sliceOr(z[0], z[2])), sliceAnd(z[7], sliceOr(z[6], z[8])));
+    SLICE_VECTOR dOuter = sliceAnd(sliceOr(z[1], z[7]), sliceOr(z[3], z[5]));
+    SLICE_VECTOR vOuter = sliceOr(sliceAnd(z[3], sliceOr(z[0], z[6])), sliceAnd(z[5], sliceOr(z[2], z[8])));
+    SLICE_VECTOR hvd = sliceAnd(sliceAnd(
+        sliceOr(hOuter, sliceAnd(z[4], sliceOr(z[3], z[5]))),
+        sliceOr(dOuter, sliceAnd(z[4], sliceOr(sliceOr(z[0], z[2]), sliceOr(z[6], z[8]))))),
+        sliceOr(vOuter, sliceAnd(z[4], sliceOr(z[1], z[7]))));
+
+    // embedData flips the middle pixel and checks again. The ratio count is not reset in between,
+    // so a block that passed keeps passing the ratio check, and a zero in the middle only adds links,
+    // so the block is HVD connected both ways exactly when it is without the middle pixel
+    SLICE_VECTOR hvdBoth = sliceAnd(sliceAnd(hOuter, dOuter), vOuter);
+
+    outcome[SLICE_RATIO_FAILURES] = sliceNot(ratioPass);
+    outcome[SLICE_HVD_FAILURES] = sliceAndNot(ratioPass, hvd);
+    outcome[SLICE_FLIP_FAILURES] = sliceAndNot(sliceAnd(ratioPass, hvd), hvdBoth);
+    outcome[SLICE_EMBEDDABLE] = sliceAnd(ratioPass, hvdBoth);
+}
@@ -0,0 +1,394 @@
+// BDPP Capacity
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Sampled capacity estimates for admission control. Only the header and a
+// few rows of blocks are read, everything else in the file is skipped.
+// Exact counts classify every block but embed nothing, -capacity runs them
+// over many files at once.
+//
+
+#include "BitmapReader.h"
+#include "Capacity.h"
+#include "Pipeline.h"
+#include "BitPlane.h"
+#include "MemStats.h"
+#include "Trace.h"
+#include <thread>
+#include <atomic>
+
+// the count of one file of a -capacity scan
+struct capacityRecord
+{
+	int status;                   // SUCCESS once counted
+	int capacityBits;
+	int totalBlocks;
+	double milliseconds;          // time to read and classify the file
+};  // capacityRecord
+
+// picks a row of blocks in [first, first + count) that is not exclude
+static int drawBlockRow(bdppRandom* rng, int first, int count, int exclude)
+{
+	uint64_t draws[RANDOM_LANES];
+	int row;
+
+	do
+	{
+		nextRandom(rng, draws);
+		row = first + (int)(draws[0] % count);
+	} while (row == exclude && count > 1);
+	return row;
+} // drawBlockRow
+
+int estimateCapacity(char* fileName, int sampleRows, bdppRandom* rng, capacityEstimate* estimate)
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	bandState state;
+	FILE* ptrFile;
+	unsigned char* rows;
+	imageView image, rowsView;
+	double variance = 0.0;
+
+	if (readBitmapHeader(fileName, &fileHdr, &fileInfo) != SUCCESS) return FAILURE;
+
+	initImageView(&image, &fileInfo, NULL);
+	if (initBandState(&state, &image, NULL, 0, NULL, 0, ACTION_ESTIMATE) != SUCCESS) return FAILURE;
+	size_t rowSize = (size_t)image.stride;
+	estimate->totalBlocks = state.totalPossibleBlocks;
+	estimate->blockRows = state.blockHeight;
+	estimate->rowsSampled = 0;
+	estimate->embeddable = estimate->low = estimate->high = 0.0;
+	if (state.blockHeight == 0) return SUCCESS;
+
+	ptrFile = fopen(fileName, "rb");
+	rows = (unsigned char*)trackedMalloc(3 * rowSize, MEM_SITE_BAND);
+	if (ptrFile == NULL || rows == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", fileName);
+		if (ptrFile != NULL) fclose(ptrFile);
+		trackedFree(rows);
+		return FAILURE;
+	}
+
+	// two rows per stratum so each stratum has its own variance estimate
+	int numStrata = sampleRows / 2;
+	if (numStrata < 1) numStrata = 1;
+	if (numStrata > state.blockHeight) numStrata = state.blockHeight;
+	initRowsView(&rowsView, rows, rowSize, image.width, 3, 1);
+
+	for (int h = 0; h < numStrata; h++)
+	{
+		int first = (int)((long long)state.blockHeight * h / numStrata);
+		int count = (int)((long long)state.blockHeight * (h + 1) / numStrata) - first;
+		int samplesInStratum = count >= 2 ? 2 : 1;
+		double counts[2];
+		int row = -1;
+
+		for (int s = 0; s < samplesInStratum; s++)
+		{
+			row = drawBlockRow(rng, first, count, row);
+			if (fseek(ptrFile, fileHdr.bfOffBits + (long long)row * 3 * rowSize, SEEK_SET) != 0
+				|| fread(rows, 1, 3 * rowSize, ptrFile) != 3 * rowSize)
+			{
+				printf("Error - %s ended before the size given in its header.\n\n", fileName);
+				fclose(ptrFile);
+				trackedFree(rows);
+				return FAILURE;
+			}
+
+			int before = state.capacityBits;
+			if (processBand(&state, &rowsView, row, 1) != SUCCESS)
+			{
+				fclose(ptrFile);
+				trackedFree(rows);
+				return FAILURE;
+			}
+			counts[s] = state.capacityBits - before;
+			estimate->rowsSampled++;
+		}
+
+		// stratum total and its variance, with the finite population correction
+		double mean = samplesInStratum == 2 ? (counts[0] + counts[1]) / 2.0 : counts[0];
+		estimate->embeddable += count * mean;
+		if (samplesInStratum == 2)
+		{
+			double spread = (counts[0] - mean) * (counts[0] - mean) + (counts[1] - mean) * (counts[1] - mean);
+			variance += (double)count * count * (1.0 - 2.0 / count) * spread / 2.0;
+		}
+	}
+	fclose(ptrFile);
+	trackedFree(rows);
+
+	double margin = ESTIMATE_Z_95 * sqrt(variance);
+	estimate->low = estimate->embeddable - margin < 0.0 ? 0.0 : estimate->embeddable - margin;
+	estimate->high = estimate->embeddable + margin;
+	return SUCCESS;
+} // estimateCapacity
+
+// counts a top-down cover, its first row of blocks is stored last so the whole file is read
+static int countTopDownCapacity(char* fileName, int* capacityBits, int* totalBlocks)
+{
+	bandState state;
+	imageView image;
+	unsigned int fileSize;
+	int status = FAILURE;
+
+	unsigned char* fileData = readBitmapFile(fileName, &fileSize);
+	if (fileData == NULL) return FAILURE;
+	if (!isSupportedBitmap(fileData, fileSize))
+	{
+		trackedFree(fileData);
+		return FAILURE;
+	}
+
+	BITMAPFILEHEADER* pFileHdr = (BITMAPFILEHEADER*)fileData;
+	initImageView(&image, (BITMAPINFOHEADER*)(fileData + sizeof(BITMAPFILEHEADER)), fileData + pFileHdr->bfOffBits);
+	if (initBandState(&state, &image, NULL, 0, NULL, 0, ACTION_ESTIMATE) == SUCCESS)
+	{
+		*totalBlocks = state.totalPossibleBlocks;
+		status = processBands(&state, &image);
+		*capacityBits = state.capacityBits;
+	}
+	trackedFree(fileData);
+	return status;
+} // countImageCapacity
+
+int countCapacity(char* fileName, int* capacityBits, int* totalBlocks)
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	bandState state;
+	FILE* ptrFile;
+	unsigned char* band;
+	imageView image, bandView;
+
+	*capacityBits = *totalBlocks = 0;
+	ptrFile = fopen(fileName, "rb");
+	if (ptrFile == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", fileName);
+		return FAILURE;
+	}
+	if (fread(&fileHdr, sizeof(BITMAPFILEHEADER), 1, ptrFile) != 1 || fread(&fileInfo, sizeof(BITMAPINFOHEADER), 1, ptrFile) != 1
+		|| (fileHdr.bfType & 0xFF) != 'B' || (fileHdr.bfType >> 8) != 'M')
+	{
+		printf("Error - %s is not a valid bitmap file.\n\n", fileName);
+		fclose(ptrFile);
+		return FAILURE;
+	}
+
+	// covers are hidden in as 1-bit rows, a schedule measures its covers here before hiding in them
+	if (fileInfo.biBitCount != 1)
+	{
+		printf("Error - %s has %d bits per pixel, capacities are counted for 1-bit images only.\n\n", fileName, fileInfo.biBitCount);
+		fclose(ptrFile);
+		return FAILURE;
+	}
+	if (fileInfo.biHeight < 0)
+	{
+		fclose(ptrFile);
+		return countTopDownCapacity(fileName, capacityBits, totalBlocks);
+	}
+
+	initImageView(&image, &fileInfo, NULL);
+	if (initBandState(&state, &image, NULL, 0, NULL, 0, ACTION_ESTIMATE) != SUCCESS)
+	{
+		fclose(ptrFile);
+		return FAILURE;
+	}
+	size_t rowSize = (size_t)image.stride;
+	*totalBlocks = state.totalPossibleBlocks;
+
+	band = (unsigned char*)trackedMalloc(PIPELINE_BAND_BLOCK_ROWS * 3 * rowSize, MEM_SITE_BAND);
+	if (band == NULL || fseek(ptrFile, fileHdr.bfOffBits, SEEK_SET) != 0)
+	{
+		printf("Error in opening file: %s.\n\n", fileName);
+		fclose(ptrFile);
+		trackedFree(band);
+		return FAILURE;
+	}
+
+	for (int row = 0; row < state.blockHeight; row += PIPELINE_BAND_BLOCK_ROWS)
+	{
+		int numBlockRows = state.blockHeight - row < PIPELINE_BAND_BLOCK_ROWS ? state.blockHeight - row : PIPELINE_BAND_BLOCK_ROWS;
+		size_t bandBytes = numBlockRows * 3 * rowSize;
+		if (fread(band, 1, bandBytes, ptrFile) != bandBytes)
+		{
+			printf("Error - %s ended before the size given in its header.\n\n", fileName);
+			fclose(ptrFile);
+			trackedFree(band);
+			return FAILURE;
+		}
+		initRowsView(&bandView, band, rowSize, image.width, numBlockRows * 3, 1);
+		if (processBand(&state, &bandView, row, numBlockRows) != SUCCESS)
+		{
+			fclose(ptrFile);
+			trackedFree(band);
+			return FAILURE;
+		}
+	}
+	fclose(ptrFile);
+	trackedFree(band);
+
+	*capacityBits = state.capacityBits;
+	return SUCCESS;
+} // countCapacity
+
+int runEstimate(char* coverFileName, char* msgFileName, int sampleRows, bdppRandom* rng)
+{
+	capacityEstimate estimate;
+	LARGE_INTEGER start, end, frequency;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	if (estimateCapacity(coverFileName, sampleRows, rng, &estimate) != SUCCESS) return FAILURE;
+	QueryPerformanceCounter(&end);
+
+	printf("\nCapacity estimate for %s\n", coverFileName);
+	printf("Total Blocks: %d\n", estimate.totalBlocks);
+	printf("Estimated Hiding Capacity: %.0f bits | %.0f bytes\n", estimate.embeddable, estimate.embeddable / 8);
+	printf("95%% Confidence Interval: %.0f - %.0f bits\n", estimate.low, estimate.high);
+	printf("Rows of Blocks Sampled: %d of %d (%.2f%% of the pixels)\n", estimate.rowsSampled, estimate.blockRows,
+		estimate.blockRows ? (double)estimate.rowsSampled / estimate.blockRows * 100 : 0.0);
+	printf("Estimate Time: %.1f microseconds\n", (double)(end.QuadPart - start.QuadPart) * 1e6 / frequency.QuadPart);
+
+	if (msgFileName == NULL || msgFileName[0] == 0) return SUCCESS;
+
+	// the message is sized the way a hide would use it, without reading all of it
+	FILE* ptrFile = fopen(msgFileName, "rb");
+	unsigned char magic[2] = { 0, 0 };
+	if (ptrFile == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", msgFileName);
+		return FAILURE;
+	}
+	fread(magic, 1, 2, ptrFile);
+	fseek(ptrFile, 0, SEEK_END);
+	double msgBits = (double)ftell(ptrFile);
+	fclose(ptrFile);
+	if (magic[0] != 'B' || magic[1] != 'M') msgBits *= 8;
+
+	printf("Message Size: %.0f bits\n", msgBits);
+	if (msgBits <= estimate.low)
+	{
+		printf("Message fits\n");
+		return SUCCESS;
+	}
+	if (msgBits <= estimate.high)
+	{
+		printf("Message may fit, it is within the confidence interval\n");
+		return SUCCESS;
+	}
+	printf("Message does not fit\n");
+	return FAILURE;
+} // runEstimate
+
+// writes a file name as a JSON string, Windows paths are full of backslashes
+static void printJsonString(const char* text)
+{
+	putchar('"');
+	for (const unsigned char* p = (const unsigned char*)text; *p != 0; p++)
+	{
+		if (*p == '"' || *p == '\\') printf("\\%c", *p);
+		else if (*p < 0x20) printf("\\u%04x", *p);
+		else putchar(*p);
+	}
+	putchar('"');
+	return;
+} // printJsonString
+
+int runCapacityScan(char** fileNames, int numFiles, int bitsPerBlock, int json)
+{
+	LARGE_INTEGER start, end, frequency;
+	std::atomic<int> nextFile(0);
+
+	capacityRecord* records = (capacityRecord*)trackedCalloc(numFiles, sizeof(capacityRecord), MEM_SITE_BOOKKEEPING);
+	if (records == NULL)
+	{
+		printf("Error - Could not allocate memory for %d capacity records.\n\n", numFiles);
+		return FAILURE;
+	}
+
+	int numThreads = (int)std::thread::hardware_concurrency();
+	if (numThreads < 1) numThreads = 1;
+	if (numThreads > numFiles) numThreads = numFiles;
+
+	// every file is read a band at a time by the thread that takes it, the files are spread over the
+	// threads one at a time so a large one does not hold up a whole share of the small ones
+	// with -json the records are all that goes to standard output, what the workers print about a file that
+	// cannot be counted goes to standard error until they are done
+	int savedStdout = -1;
+	if (json)
+	{
+		fflush(stdout);
+		savedStdout = _dup(_fileno(stdout));
+		if (savedStdout != -1) _dup2(_fileno(stderr), _fileno(stdout));
+	}
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	std::thread* workers = new std::thread[numThreads];
+	for (int t = 0; t < numThreads; t++)
+	{
+		workers[t] = std::thread([&]()
+		{
+			traceThreadName("capacity worker");
+			for (int i = nextFile++; i < numFiles; i = nextFile++)
+			{
+				LARGE_INTEGER fileStart, fileEnd;
+				QueryPerformanceCounter(&fileStart);
+				records[i].status = countCapacity(fileNames[i], &records[i].capacityBits, &records[i].totalBlocks);
+				QueryPerformanceCounter(&fileEnd);
+				records[i].milliseconds = (double)(fileEnd.QuadPart - fileStart.QuadPart) * 1000.0 / frequency.QuadPart;
+			}
+		});
+	}
+	for (int t = 0; t < numThreads; t++)
+	{
+		workers[t].join();
+	}
+	delete[] workers;
+	QueryPerformanceCounter(&end);
+	if (savedStdout != -1)
+	{
+		fflush(stdout);
+		_dup2(savedStdout, _fileno(stdout));
+		_close(savedStdout);
+	}
+
+	int failed = 0;
+	unsigned long long totalBits = 0;
+	if (!json) printf("\nCapacity of %d files at %d bits per block:\n", numFiles, bitsPerBlock);
+	for (int i = 0; i < numFiles; i++)
+	{
+		capacityRecord* record = &records[i];
+		if (record->status != SUCCESS) failed++;
+		else totalBits += record->capacityBits;
+
+		if (json)
+		{
+			printf("{\"file\":");
+			printJsonString(fileNames[i]);
+			if (record->status != SUCCESS) printf(",\"status\":\"failed\"}\n");
+			else printf(",\"status\":\"ok\",\"bitsPerBlock\":%d,\"totalBlocks\":%d,\"capacityBits\":%d,\"capacityBytes\":%d,\"milliseconds\":%.3f}\n",
+				bitsPerBlock, record->totalBlocks, record->capacityBits, record->capacityBits / 8, record->milliseconds);
+		}
+		else if (record->status != SUCCESS)
+		{
+			printf("%s: failed\n", fileNames[i]);
+		}
+		else
+		{
+			printf("%s: %d bits | %d bytes, %d blocks, %.1f ms\n", fileNames[i], record->capacityBits,
+				record->capacityBits / 8, record->totalBlocks, record->milliseconds);
+		}
+	}
+	if (!json)
+	{
+		printf("Capacity scan complete: %d files, %d failed, %llu bits | %llu bytes, %d threads, %.2f seconds\n",
+			numFiles, failed, totalBits, totalBits / 8, numThreads, (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart);
+	}
+
+	trackedFree(records);
+	return failed == 0 ? SUCCESS : FAILURE;
+} // runCapacityScan
@@ -0,0 +1,83 @@
+// BDPP Capacity Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Answers "how much can this cover hold" without running a hide.
+//
+
+#pragma once
+
+#include <windows.h>
+#include "BDPPRandom.h"
+
+#define ESTIMATE_DEFAULT_SAMPLES	32	// rows of blocks read by -estimate
+#define ESTIMATE_Z_95				1.96
+
+/*
+* Structure: capacityEstimate
+* Usage: capacityEstimate estimate;
+* ------------------------------------------------------
+* This structure holds the result of a sampled capacity
+* estimate: the estimated hiding capacity in bits with
+* its 95% confidence interval, and how much of the image
+* was read to get it. With one bit per block the capacity
+* is the number of embeddable blocks.
+*/
+struct capacityEstimate
+{
+    int totalBlocks;
+    int blockRows;          // rows of blocks in the image
+    int rowsSampled;        // rows of blocks actually classified
+    double embeddable;      // estimated hiding capacity in bits
+    double low;             // 95% confidence interval
+    double high;
+};  // capacityEstimate
+
+/*
+* Function: estimateCapacity
+* Usage: estimateCapacity(gCoverPathFileName, samples, &gRandom, &estimate);
+* ------------------------------------------------------
+* This function reads the bitmap header and a stratified
+* random sample of rows of blocks: the rows of blocks are
+* split into equal strata and two rows are drawn from each.
+* Only the sampled rows are read and classified. The total
+* and its confidence interval are the usual stratified
+* sampling estimates.
+*/
+int estimateCapacity(char* fileName, int sampleRows, bdppRandom* rng, capacityEstimate* estimate);
+
+/*
+* Function: countCapacity
+* Usage: countCapacity(coverFileName, &capacityBits, &totalBlocks);
+* ------------------------------------------------------
+* This function classifies every block of a cover and
+* returns the exact hiding capacity in bits. The file
+* is read a band of rows at a time, so the whole image is
+* never held in memory, except for a top-down file whose
+* first row of blocks is stored last, which is read whole.
+*/
+int countCapacity(char* fileName, int* capacityBits, int* totalBlocks);
+
+/*
+* Function: runEstimate
+* Usage: runEstimate(gCoverPathFileName, gMsgPathFileName, samples, &gRandom);
+* ------------------------------------------------------
+* This function prints the capacity estimate of a cover
+* and, if a message file is given, whether the message
+* fits, may fit or does not fit. It returns FAILURE if the
+* message does not fit so callers can reject the job.
+*/
+int runEstimate(char* coverFileName, char* msgFileName, int sampleRows, bdppRandom* rng);
+
+/*
+* Function: runCapacityScan
+* Usage: runCapacityScan(gCapacityFileNames, gNumCapacityFiles, gNumBits2Hide, gCapacityJson);
+* ------------------------------------------------------
+* This function counts the exact hiding capacity of every
+* file given with countCapacity, one file per hardware
+* thread at a time. Nothing is embedded and nothing is
+* written. It prints one line per file in the order given,
+* or one JSON record per line with json, when what the
+* workers print goes to standard error. Returns FAILURE
+* if any file could not be counted.
+*/
+int runCapacityScan(char** fileNames, int numFiles, int bitsPerBlock, int json);
@@ -0,0 +1,231 @@
+// BDPP Durable Output
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The committer thread behind -durable. Finished temporary files are queued
+// under a lock; the thread takes the whole queue as one group, flushes every
+// file of it and only then renames them, with write-through so the renames
+// are on disk when MoveFileEx returns. Flushing the files of a group back to
+// back lets the file system fold their journal flushes together, and the
+// hiding threads never wait on a flush themselves.
+//
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "BitmapReader.h"
+#include "Durable.h"
+#include "MemStats.h"
+#include "Trace.h"
+
+int gDurableOn = 0;
+
+// one finished output waiting for its group
+struct durableFile
+{
+	char writeName[MAX_PATH];
+	durableFile* next;
+};  // durableFile
+
+static durableFile* gDurableHead = NULL;
+static durableFile* gDurableTail = NULL;
+static int gDurableWaiting = 0;
+static std::chrono::steady_clock::time_point gDurableOldest;	// when the oldest waiting file finished
+static int gDurableGroupFiles, gDurableGroupMilliseconds;
+static int gDurableStopping = 0;
+static int gDurableDraining = 0;		// callers waiting in durableDrain, groups are committed without waiting to fill
+static int gDurableCommitting = 0;		// a group taken from the queue is being flushed and renamed
+static int gDurableCommitted = 0, gDurableGroups = 0, gDurableFailed = 0;
+static double gDurableFlushMilliseconds = 0.0;
+static std::mutex gDurableLock;
+static std::condition_variable gDurableReady;
+static std::condition_variable gDurableIdle;	// the queue is empty and no group is being committed
+static std::thread gDurableCommitter;
+
+// the final name is the write name without DURABLE_TEMP_SUFFIX
+static void finalName(const char* writeName, char* fileName)
+{
+	size_t length = strlen(writeName) - strlen(DURABLE_TEMP_SUFFIX);
+	memcpy(fileName, writeName, length);
+	fileName[length] = 0;
+} // finalName
+
+// flushes every file of a group and then renames them into place, returns the files that failed
+static int commitGroup(durableFile* group)
+{
+	LARGE_INTEGER start, end, frequency;
+	char fileName[MAX_PATH];
+	int failed = 0;
+
+	// the data of every file reaches the disk before any of them takes its final name
+	QueryPerformanceCounter(&start);
+	traceBegin(TRACE_COMMIT, TRACE_NO_ID, TRACE_NO_ID);
+	for (durableFile* file = group; file != NULL; file = file->next)
+	{
+		HANDLE hFile = CreateFileA(file->writeName, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE || !FlushFileBuffers(hFile))
+		{
+			printf("Error - could not flush %s to disk, it is left under that name.\n\n", file->writeName);
+			file->writeName[0] = 0;
+			failed++;
+		}
+		if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+	}
+
+	for (durableFile* file = group; file != NULL; file = file->next)
+	{
+		if (file->writeName[0] == 0) continue;
+		finalName(file->writeName, fileName);
+		if (!MoveFileExA(file->writeName, fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			printf("Error - could not rename %s to %s.\n\n", file->writeName, fileName);
+			failed++;
+		}
+	}
+	traceEnd(TRACE_COMMIT, TRACE_NO_ID, TRACE_NO_ID);
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+	gDurableFlushMilliseconds += (double)(end.QuadPart - start.QuadPart) * 1000.0 / (double)frequency.QuadPart;
+	return failed;
+} // commitGroup
+
+// committer thread loop, takes the waiting files as a group once there are enough of them or the oldest is due
+static void durableCommitter()
+{
+	traceThreadName("committer");
+	std::unique_lock<std::mutex> lock(gDurableLock);
+	for (;;)
+	{
+		if (gDurableWaiting == 0)
+		{
+			if (gDurableStopping) return;
+			gDurableReady.wait(lock);
+			continue;
+		}
+		if (gDurableWaiting < gDurableGroupFiles && !gDurableStopping && !gDurableDraining)
+		{
+			auto due = gDurableOldest + std::chrono::milliseconds(gDurableGroupMilliseconds);
+			if (gDurableReady.wait_until(lock, due) != std::cv_status::timeout) continue;
+		}
+
+		durableFile* group = gDurableHead;
+		int files = gDurableWaiting;
+		gDurableHead = gDurableTail = NULL;
+		gDurableWaiting = 0;
+		gDurableCommitting = 1;
+		lock.unlock();
+
+		int failed = commitGroup(group);
+		while (group != NULL)
+		{
+			durableFile* next = group->next;
+			trackedFree(group);
+			group = next;
+		}
+
+		lock.lock();
+		gDurableCommitted += files - failed;
+		gDurableFailed += failed;
+		gDurableGroups++;
+		gDurableCommitting = 0;
+		if (gDurableWaiting == 0) gDurableIdle.notify_all();
+	}
+} // durableCommitter
+
+// commits what is waiting on an exit that did not go through finishDurable, a joinable thread must not be destroyed
+static void finishDurableAtExit()
+{
+	finishDurable(SUCCESS);
+} // finishDurableAtExit
+
+int startDurable(int groupFiles, int groupMilliseconds)
+{
+	gDurableGroupFiles = groupFiles;
+	gDurableGroupMilliseconds = groupMilliseconds;
+	gDurableStopping = 0;
+	gDurableCommitter = std::thread(durableCommitter);
+	gDurableOn = 1;
+	atexit(finishDurableAtExit);
+	return SUCCESS;
+} // startDurable
+
+int durableWriteName(const char* fileName, char* writeName)
+{
+	if (gDurableOn)
+	{
+		// a cut short temporary name would be renamed onto some other file
+		if (strlen(fileName) + strlen(DURABLE_TEMP_SUFFIX) >= MAX_PATH)
+		{
+			printf("Error - %s is too long a name to be written under a temporary name.\n\n", fileName);
+			writeName[0] = 0;
+			return FAILURE;
+		}
+		snprintf(writeName, MAX_PATH, "%s%s", fileName, DURABLE_TEMP_SUFFIX);
+		return SUCCESS;
+	}
+	strncpy(writeName, fileName, MAX_PATH - 1);
+	writeName[MAX_PATH - 1] = 0;
+	return SUCCESS;
+} // durableWriteName
+
+int durableFinish(const char* writeName)
+{
+	if (!gDurableOn) return SUCCESS;
+
+	// an output that cannot be queued is never committed, so it goes like one that failed to write
+	durableFile* file = (durableFile*)trackedCalloc(1, sizeof(durableFile), MEM_SITE_BOOKKEEPING);
+	if (file == NULL)
+	{
+		printf("Error - Could not allocate memory to commit %s.\n\n", writeName);
+		durableDiscard(writeName);
+		return FAILURE;
+	}
+	strncpy(file->writeName, writeName, MAX_PATH - 1);
+
+	{
+		std::lock_guard<std::mutex> lock(gDurableLock);
+		if (gDurableTail == NULL) gDurableHead = file;
+		else gDurableTail->next = file;
+		gDurableTail = file;
+		if (gDurableWaiting++ == 0) gDurableOldest = std::chrono::steady_clock::now();
+	}
+	gDurableReady.notify_one();
+	return SUCCESS;
+} // durableFinish
+
+int durableDrain()
+{
+	if (!gDurableOn) return SUCCESS;
+
+	std::unique_lock<std::mutex> lock(gDurableLock);
+	int failedBefore = gDurableFailed;
+	gDurableDraining++;
+	gDurableReady.notify_one();
+	gDurableIdle.wait(lock, []() { return gDurableWaiting == 0 && !gDurableCommitting; });
+	gDurableDraining--;
+	return gDurableFailed == failedBefore ? SUCCESS : FAILURE;
+} // durableDrain
+
+void durableDiscard(const char* writeName)
+{
+	if (gDurableOn) DeleteFileA(writeName);
+} // durableDiscard
+
+int finishDurable(int status)
+{
+	if (!gDurableOn) return status;
+
+	{
+		std::lock_guard<std::mutex> lock(gDurableLock);
+		gDurableStopping = 1;
+	}
+	gDurableReady.notify_one();
+	gDurableCommitter.join();
+	gDurableOn = 0;
+
+	printf("Durable Outputs: %d files committed in %d groups, %.1f ms flushing and renaming",
+		gDurableCommitted, gDurableGroups, gDurableFlushMilliseconds);
+	if (gDurableFailed > 0) printf(", %d failed", gDurableFailed);
+	printf("\n");
+	return gDurableFailed > 0 ? FAILURE : status;
+} // finishDurable
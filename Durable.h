@@ -0,0 +1,94 @@
+// BDPP Durable Output Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Crash-safe output files for -durable. Every output is written under a
+// temporary name next to its final name, and a committer thread flushes the
+// finished temporary files to disk and renames them into place a group at a
+// time. A crash leaves either the old file or the complete new one under the
+// final name, never a half-written one, and the cost of flushing is paid once
+// per group on a thread of its own instead of once per file on the thread
+// doing the hiding.
+//
+
+#pragma once
+
+#include <windows.h>
+
+#define DURABLE_TEMP_SUFFIX		".bdpptmp"	// added to the final name while a file is written
+#define DURABLE_DEFAULT_FILES	16			// files committed together
+#define DURABLE_DEFAULT_MS		200			// longest a finished file waits to be committed
+
+// 1 once startDurable succeeded
+extern int gDurableOn;
+
+/*
+* Function: startDurable
+* Usage: startDurable(gCommitFiles, gCommitMilliseconds);
+* ------------------------------------------------------
+* This function turns on durable output and starts the
+* committer thread. A group is committed as soon as
+* groupFiles files are waiting, or groupMilliseconds
+* after the oldest of them finished.
+*/
+int startDurable(int groupFiles, int groupMilliseconds);
+
+/*
+* Function: durableWriteName
+* Usage: durableWriteName(fileName, writeName);
+* ------------------------------------------------------
+* This function copies the name an output should be
+* written under into writeName, MAX_PATH characters: the
+* temporary name when durable output is on, otherwise
+* fileName itself. Returns FAILURE, with writeName
+* empty, if the temporary name would not fit.
+*/
+int durableWriteName(const char* fileName, char* writeName);
+
+/*
+* Function: durableFinish
+* Usage: durableFinish(writeName);
+* ------------------------------------------------------
+* This function hands a completely written and closed
+* output to the committer thread, which flushes it and
+* renames it to its final name with the next group. It
+* does nothing when durable output is off. Returns
+* FAILURE, after deleting the temporary file, if the
+* output could not be queued.
+*/
+int durableFinish(const char* writeName);
+
+/*
+* Function: durableDrain
+* Usage: failed += durableDrain() != SUCCESS;
+* ------------------------------------------------------
+* This function commits the files waiting at once and
+* waits until every file handed to durableFinish has
+* been flushed and renamed to its final name, so the
+* next job can read or rewrite it. Returns FAILURE if
+* any of them could not be committed. It returns at
+* once when durable output is off.
+*/
+int durableDrain();
+
+/*
+* Function: durableDiscard
+* Usage: durableDiscard(writeName);
+* ------------------------------------------------------
+* This function deletes the temporary file of an output
+* that failed, so the final name keeps its old contents.
+* It does nothing when durable output is off.
+*/
+void durableDiscard(const char* writeName);
+
+/*
+* Function: finishDurable
+* Usage: exit(finishDurable(status) == SUCCESS ? 0 : -1);
+* ------------------------------------------------------
+* This function commits the files still waiting, stops
+* the committer thread and prints how many files were
+* committed in how many groups. Returns FAILURE if any
+* file could not be flushed or renamed, otherwise
+* status. It returns status at once when durable output
+* is off.
+*/
+int finishDurable(int status);
@@ -0,0 +1,51 @@
+// BDPP Image View
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Builds image views over bitmap pixel data, bands and sub-rectangles.
+//
+
+#include "BitmapReader.h"
+#include "ImageView.h"
+
+void initRowsView(imageView* image, unsigned char* rows, ptrdiff_t stride, int width, int height, int bitsPerPixel)
+{
+	image->base = rows;
+	image->stride = stride;
+	image->width = width;
+	image->height = height;
+	image->bitOffset = 0;
+	image->bitsPerPixel = bitsPerPixel;
+	return;
+} // initRowsView
+
+void initImageView(imageView* image, BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData)
+{
+	ptrdiff_t rowSize = (ptrdiff_t)bitmapRowSize(pFileInfo->biWidth, pFileInfo->biBitCount);
+	int height = pFileInfo->biHeight < 0 ? -pFileInfo->biHeight : pFileInfo->biHeight;
+
+	initRowsView(image, pixelData, rowSize, pFileInfo->biWidth, height, pFileInfo->biBitCount);
+
+	// top-down rows: the bottom row is stored last
+	if (pFileInfo->biHeight < 0)
+	{
+		image->stride = -rowSize;
+		if (pixelData != NULL) image->base = pixelData + (height - 1) * rowSize;
+	}
+	return;
+} // initImageView
+
+int cropImageView(imageView* image, int x, int y, int width, int height)
+{
+	if (x < 0 || y < 0 || width < 1 || height < 1 || x > image->width - width || y > image->height - height)
+	{
+		return FAILURE;
+	}
+
+	// the rectangle's bottom row is y + height - 1 rows down from the top, a view without pixels only
+	// changes size
+	if (image->base != NULL) image->base = imageRow(image, image->height - y - height);
+	image->bitOffset += x * image->bitsPerPixel;
+	image->width = width;
+	image->height = height;
+	return SUCCESS;
+} // cropImageView
@@ -0,0 +1,92 @@
+// BDPP Image View Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// A view of pixel rows in memory. Every stage finds pixel (x, y) of its image
+// through a view instead of working out row sizes itself, so bottom-up and
+// top-down files, bands read from a stream, request ring slots and
+// sub-rectangles of a cover all look the same to the BDPP: row 0 is the
+// bottom row and x runs left to right. Nothing is copied or reordered.
+//
+
+#pragma once
+
+#include <windows.h>
+#include <stddef.h>
+
+/*
+* Structure: imageView
+* Usage: imageView image; initImageView(&image, pFileInfo, pixelData);
+* ------------------------------------------------------
+* This structure locates the pixels of an image. Row y
+* starts at base + y * stride, stride is negative when
+* the rows are stored top row first. Pixel x of a row is
+* bitsPerPixel bits starting bitOffset + x * bitsPerPixel
+* bits into the row, most significant bit first, so a
+* sub-rectangle is the same rows with a larger offset.
+*/
+struct imageView
+{
+    unsigned char* base;          // first byte of row 0, the bottom row of the image
+    ptrdiff_t stride;             // bytes from one row to the row above it
+    int width;                    // pixels per row
+    int height;                   // rows
+    int bitOffset;                // bits before pixel 0 of every row
+    int bitsPerPixel;             // 1 or 8
+};  // imageView
+
+/*
+* Function: bitmapRowSize
+* Usage: rowSize = bitmapRowSize(width, bitsPerPixel);
+* ------------------------------------------------------
+* This function returns the bytes per pixel row of a
+* bitmap, padded to 4 bytes.
+*/
+static inline size_t bitmapRowSize(int width, int bitsPerPixel)
+{
+    return (((size_t)width * bitsPerPixel + 31) / 32) * 4;
+}
+
+/*
+* Function: imageRow
+* Usage: unsigned char* row = imageRow(&image, y);
+* ------------------------------------------------------
+* This function returns the first byte of row y of a
+* view, row 0 being the bottom row.
+*/
+static inline unsigned char* imageRow(const imageView* image, int y)
+{
+    return image->base + (ptrdiff_t)y * image->stride;
+}
+
+/*
+* Function: initRowsView
+* Usage: initRowsView(&band, rows, rowSize, width, numRows, 1);
+* ------------------------------------------------------
+* This function makes a view of height rows stored one
+* after the other from the bottom up, stride bytes apart,
+* such as a band read from a file or a request slot.
+*/
+void initRowsView(imageView* image, unsigned char* rows, ptrdiff_t stride, int width, int height, int bitsPerPixel);
+
+/*
+* Function: initImageView
+* Usage: initImageView(&image, pFileInfo, coverData + pFileHdr->bfOffBits);
+* ------------------------------------------------------
+* This function makes a view of the pixel data of a
+* bitmap. A negative biHeight marks a top-down bitmap,
+* its view starts at the last row and steps backwards.
+* pixelData may be NULL when only the size is needed.
+*/
+void initImageView(imageView* image, BITMAPINFOHEADER* pFileInfo, unsigned char* pixelData);
+
+/*
+* Function: cropImageView
+* Usage: if (cropImageView(&image, x, y, width, height) != SUCCESS) ...
+* ------------------------------------------------------
+* This function narrows a view to the rectangle of width
+* by height pixels whose top left pixel is (x, y), with y
+* counted down from the top row as an image is viewed.
+* Returns FAILURE if the rectangle is not inside the view.
+* A view made without pixel data stays without it.
+*/
+int cropImageView(imageView* image, int x, int y, int width, int height);
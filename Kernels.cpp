@@ -0,0 +1,138 @@
+// BDPP Kernels
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Asks the processor which instruction sets it supports and picks the
+// kernels to run with, see Kernels.h. The table and portable kernels live
+// here, the vector kernels in a file per instruction set.
+//
+
+#include "BitmapReader.h"
+#include "BitPlane.h"
+#include "Kernels.h"
+
+#ifdef KERNELS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// the table kernel classifies one block at a time, it gathers and packs like the portable kernel where it has to
+const kernelSet gTableKernels = { KERNEL_TABLE, "table", loadSliceRowSwar, classifySliceRowSwar, packLsbRowSwar };
+const kernelSet gSwarKernels = { KERNEL_SWAR, "swar", loadSliceRowSwar, classifySliceRowSwar, packLsbRowSwar };
+
+const kernelSet* gKernels = &gSwarKernels;
+
+// the -kernel names, in the order of the KERNEL_ numbers
+static const char* gKernelNames[KERNEL_COUNT] = { "table", "swar", "sse42", "avx2", "avx512", "neon" };
+
+#ifdef KERNELS_X86
+// registers eax, ebx, ecx and edx of cpuid leaf and subleaf
+static void readCpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuidex(info, (int)leaf, (int)subleaf);
+	for (int i = 0; i < 4; i++) regs[i] = (unsigned int)info[i];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	return;
+} // readCpuid
+
+// the register state the operating system saves on a context switch, vector registers it does not save cannot be used
+static unsigned long long readXcr0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int low, high;
+	__asm__ volatile ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((unsigned long long)high << 32) | low;
+#endif
+} // readXcr0
+
+// 1 if this processor and operating system can run kernel
+static int isKernelSupported(int kernel)
+{
+	unsigned int leaf0[4], leaf1[4], leaf7[4] = { 0, 0, 0, 0 };
+	readCpuid(0, 0, leaf0);
+	readCpuid(1, 0, leaf1);
+	if (leaf0[0] >= 7) readCpuid(7, 0, leaf7);
+
+	int sse42 = (leaf1[2] >> 20 & 1) && (leaf1[2] >> 23 & 1);	// SSE4.2 and POPCNT
+	int osxsave = leaf1[2] >> 27 & 1;
+	unsigned long long xcr0 = osxsave ? readXcr0() : 0;
+	int avx2 = sse42 && osxsave && (leaf1[2] >> 28 & 1) && (xcr0 & 0x6) == 0x6	// AVX with the ymm state saved
+		&& (leaf7[1] >> 5 & 1) && (leaf7[1] >> 3 & 1) && (leaf7[1] >> 8 & 1);	// AVX2, BMI1 and BMI2
+	int avx512 = avx2 && (xcr0 & 0xE6) == 0xE6	// the opmask and zmm state saved as well
+		&& (leaf7[1] >> 16 & 1) && (leaf7[1] >> 30 & 1);	// AVX-512 F and BW
+
+	switch (kernel)
+	{
+	case KERNEL_SSE42:
+		return sse42;
+	case KERNEL_AVX2:
+		return avx2;
+	case KERNEL_AVX512:
+		return avx512;
+	default:
+		return 0;
+	}
+} // isKernelSupported
+#endif
+
+int findKernel(const char* name)
+{
+	if (_stricmp(name, "auto") == 0) return KERNEL_AUTO;
+	for (int kernel = 0; kernel < KERNEL_COUNT; kernel++)
+	{
+		if (_stricmp(name, gKernelNames[kernel]) == 0) return kernel;
+	}
+	return KERNEL_COUNT;
+} // findKernel
+
+const kernelSet* getKernelSet(int kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_TABLE:
+		return &gTableKernels;
+	case KERNEL_SWAR:
+		return &gSwarKernels;
+#ifdef KERNELS_X86
+	case KERNEL_SSE42:
+		return isKernelSupported(KERNEL_SSE42) ? &gSse42Kernels : NULL;
+	case KERNEL_AVX2:
+		return isKernelSupported(KERNEL_AVX2) ? &gAvx2Kernels : NULL;
+	case KERNEL_AVX512:
+		return isKernelSupported(KERNEL_AVX512) ? &gAvx512Kernels : NULL;
+#endif
+#ifdef KERNELS_NEON
+	case KERNEL_NEON:
+		return &gNeonKernels;	// every ARM64 core has NEON
+#endif
+	default:
+		return NULL;
+	}
+} // getKernelSet
+
+int selectKernel(int kernel)
+{
+	// the widest first, the portable kernel runs everywhere; neon has not been run on an ARM64 machine
+	// yet, so it is only used when asked for and ARM64 gets swar
+	if (kernel == KERNEL_AUTO)
+	{
+		for (kernel = KERNEL_COUNT - 1; kernel == KERNEL_NEON || getKernelSet(kernel) == NULL; kernel--);
+	}
+
+	const kernelSet* kernels = getKernelSet(kernel);
+	if (kernels == NULL)
+	{
+		printf("Error - this processor cannot run the %s kernel.\n\n", gKernelNames[kernel]);
+		return FAILURE;
+	}
+	gKernels = kernels;
+	return SUCCESS;
+} // selectKernel
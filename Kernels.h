@@ -0,0 +1,100 @@
+// BDPP Kernels Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Runtime choice of the kernels that gather blocks, classify them and pack
+// bit-planes. One build carries a portable kernel and vector kernels for
+// SSE4.2, AVX2, AVX-512 and NEON; the processor is asked what it supports at
+// startup (cpuid and xgetbv on x86-64) and the widest kernel it runs is used
+// unless -kernel asks for another. NEON is only used when -kernel asks for
+// it, ARM64 runs the portable kernel otherwise. The
+// vector kernels are compiled for their instruction set function by
+// function, the rest of the program stays generic.
+//
+
+#pragma once
+
+#include <windows.h>
+#include "BlockSlice.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define KERNELS_X86
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define KERNELS_NEON
+#endif
+
+/*
+* Structure: kernelSet
+* Usage: gKernels->classifySliceRow(&row);
+* ------------------------------------------------------
+* This structure holds the kernels of one instruction
+* set. loadSliceRow and classifySliceRow do the work of
+* loadSliceRowSwar and classifySliceRowSwar, packLsbRow
+* the work of the portable packLsbRow, with the same
+* results.
+*/
+struct kernelSet
+{
+    int kernel;                   // KERNEL_TABLE ... KERNEL_NEON
+    const char* name;             // as given to -kernel
+    void (*loadSliceRow)(const imageView* band, int y, sliceRow* row);
+    void (*classifySliceRow)(sliceRow* row);
+    void (*packLsbRow)(const unsigned char* byteRow, int width, unsigned char* packedRow);
+};  // kernelSet
+
+// the kernels in use, the portable ones until selectKernel is called
+extern const kernelSet* gKernels;
+
+// the kernels of each instruction set, defined in their own files for the processors that have them
+extern const kernelSet gTableKernels;
+extern const kernelSet gSwarKernels;
+#ifdef KERNELS_X86
+extern const kernelSet gSse42Kernels;
+extern const kernelSet gAvx2Kernels;
+extern const kernelSet gAvx512Kernels;
+#endif
+#ifdef KERNELS_NEON
+extern const kernelSet gNeonKernels;
+#endif
+
+#ifdef KERNELS_X86
+/*
+* Function: loadSliceRowPext
+* Usage: loadSliceRowPext(&band, y, &row);
+* ------------------------------------------------------
+* This function does the work of loadSliceRowSwar with
+* AVX2 and BMI2 pext, shared by the AVX2 and AVX-512
+* kernels. Only call it through their kernel sets.
+*/
+void loadSliceRowPext(const imageView* band, int y, sliceRow* row);
+#endif
+
+/*
+* Function: findKernel
+* Usage: kernel = findKernel(argv[cnt]);
+* ------------------------------------------------------
+* This function returns the kernel named by name (auto,
+* table, swar, sse42, avx2, avx512 or neon), or
+* KERNEL_COUNT if there is none by that name.
+*/
+int findKernel(const char* name);
+
+/*
+* Function: getKernelSet
+* Usage: const kernelSet* kernels = getKernelSet(KERNEL_AVX2);
+* ------------------------------------------------------
+* This function returns the kernels of kernel if this
+* processor can run them, otherwise NULL.
+*/
+const kernelSet* getKernelSet(int kernel);
+
+/*
+* Function: selectKernel
+* Usage: if (selectKernel(gKernel) != SUCCESS) exit(-1);
+* ------------------------------------------------------
+* This function makes gKernels the kernels asked for,
+* or with KERNEL_AUTO the widest this processor runs,
+* leaving out neon, which must be asked for.
+* Returns FAILURE, after saying why, if the processor
+* cannot run the kernel asked for.
+*/
+int selectKernel(int kernel);
@@ -0,0 +1,117 @@
+// BDPP AVX2 Kernels
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The kernels for processors with AVX2 and BMI2. Gathering reads the 24
+// bytes of a slice with one load, reverses the bits of every byte with two
+// nibble lookups, and pulls each column of 16 blocks out with one pext where
+// the portable kernel needs a chain of shifts and masks. The checks run on
+// 4 slices per 256-bit register, and packing does 32 pixels per movemask.
+//
+
+#include <string.h>
+#include "BitmapReader.h"
+#include "BitPlane.h"
+#include "Kernels.h"
+
+#ifdef KERNELS_X86
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,bmi,bmi2,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2,bmi,bmi2,popcnt")
+#endif
+
+#define SLICE_VECTOR __m256i
+static inline __m256i sliceAnd(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+static inline __m256i sliceOr(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+static inline __m256i sliceXor(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+static inline __m256i sliceAndNot(__m256i a, __m256i b) { return _mm256_andnot_si256(b, a); }
+static inline __m256i sliceNot(__m256i a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+#include "BlockSliceChecks.h"
+
+void loadSliceRowPext(const imageView* band, int y, sliceRow* row)
+{
+	size_t rowBytes = bitmapRowSize(band->bitOffset + band->width, 1);
+	int shift = band->bitOffset % 8;
+
+	// a nibble reversed, and reversed into the high nibble
+	const __m256i reverseLow = _mm256_setr_epi8(0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+		0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0);
+	const __m256i reverseHigh = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+		0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+	for (int k = 0; k < 3; k++)
+	{
+		const unsigned char* line = imageRow(band, y + k);
+		for (int s = 0; s < row->slices; s++)
+		{
+			// a slice is 192 pixels, 24 whole bytes, so every slice of the row starts at the same bit of its first byte
+			size_t byte = (size_t)(band->bitOffset / 8) + (size_t)s * 24;
+			__m256i raw;
+			if (byte + 32 <= rowBytes) raw = _mm256_loadu_si256((const __m256i*)(line + byte));
+			else
+			{
+				unsigned char tail[32] = { 0 };  // the end of the row
+				if (byte < rowBytes) memcpy(tail, line + byte, rowBytes - byte);
+				raw = _mm256_loadu_si256((const __m256i*)tail);
+			}
+
+			unsigned char bits[32];
+			_mm256_storeu_si256((__m256i*)bits, _mm256_or_si256(
+				_mm256_shuffle_epi8(reverseLow, _mm256_and_si256(raw, nibble)),
+				_mm256_shuffle_epi8(reverseHigh, _mm256_and_si256(_mm256_srli_epi16(raw, 4), nibble))));
+
+			uint64_t columns[3] = { 0, 0, 0 };
+			for (int group = 0; group < SLICE_BLOCKS / 16; group++)
+			{
+				uint64_t word;
+				memcpy(&word, bits + group * 6, sizeof(word));
+				word >>= shift;
+				for (int l = 0; l < 3; l++)
+				{
+					columns[l] |= _pext_u64(word, 0x0000249249249249ULL << l) << (group * 16);
+				}
+			}
+			for (int l = 0; l < 3; l++) row->pixels[(k * 3 + l) * row->capacity + s] = columns[l];
+		}
+	}
+	return;
+} // loadSliceRowPext
+
+static void classifySliceRowAvx2(sliceRow* row)
+{
+	__m256i pixels[9], outcome[SLICE_OUTCOMES];
+	for (int s = 0; s < row->slices; s += 4)
+	{
+		for (int p = 0; p < 9; p++) pixels[p] = _mm256_loadu_si256((const __m256i*)(row->pixels + p * row->capacity + s));
+		sliceChecks(pixels, outcome);
+		for (int m = 0; m < SLICE_OUTCOMES; m++) _mm256_storeu_si256((__m256i*)(row->outcome + m * row->capacity + s), outcome[m]);
+	}
+	return;
+} // classifySliceRowAvx2
+
+static void packLsbRowAvx2(const unsigned char* byteRow, int width, unsigned char* packedRow)
+{
+	// the movemask puts the first pixel of a byte lowest, the bitmap wants it highest
+	const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+	int x = 0;
+	for (; x + 32 <= width; x += 32)
+	{
+		__m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(byteRow + x)), reverse);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi64(pixels, 7));
+		memcpy(packedRow + x / 8, &mask, sizeof(mask));
+	}
+	packLsbRowSwar(byteRow + x, width - x, packedRow + x / 8);
+	return;
+} // packLsbRowAvx2
+
+const kernelSet gAvx2Kernels = { KERNEL_AVX2, "avx2", loadSliceRowPext, classifySliceRowAvx2, packLsbRowAvx2 };
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
@@ -0,0 +1,67 @@
+// BDPP AVX-512 Kernels
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The kernels for processors with AVX-512 F and BW. The checks run on 8
+// slices per 512-bit register and packing tests the lowest bits of 64 pixels
+// straight into a mask register. Blocks are gathered with the pext kernel of
+// KernelsAvx2.cpp, every AVX-512 processor has BMI2.
+//
+
+#include <string.h>
+#include "BitmapReader.h"
+#include "BitPlane.h"
+#include "Kernels.h"
+
+#ifdef KERNELS_X86
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt")
+#endif
+
+#define SLICE_VECTOR __m512i
+static inline __m512i sliceAnd(__m512i a, __m512i b) { return _mm512_and_si512(a, b); }
+static inline __m512i sliceOr(__m512i a, __m512i b) { return _mm512_or_si512(a, b); }
+static inline __m512i sliceXor(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+static inline __m512i sliceAndNot(__m512i a, __m512i b) { return _mm512_andnot_si512(b, a); }
+static inline __m512i sliceNot(__m512i a) { return _mm512_ternarylogic_epi64(a, a, a, 0x55); }
+#include "BlockSliceChecks.h"
+
+static void classifySliceRowAvx512(sliceRow* row)
+{
+	__m512i pixels[9], outcome[SLICE_OUTCOMES];
+	for (int s = 0; s < row->slices; s += 8)
+	{
+		for (int p = 0; p < 9; p++) pixels[p] = _mm512_loadu_si512((const void*)(row->pixels + p * row->capacity + s));
+		sliceChecks(pixels, outcome);
+		for (int m = 0; m < SLICE_OUTCOMES; m++) _mm512_storeu_si512((void*)(row->outcome + m * row->capacity + s), outcome[m]);
+	}
+	return;
+} // classifySliceRowAvx512
+
+static void packLsbRowAvx512(const unsigned char* byteRow, int width, unsigned char* packedRow)
+{
+	// the mask puts the first pixel of a byte lowest, the bitmap wants it highest
+	const __m512i reverse = _mm512_set_epi64(0x08090A0B0C0D0E0FULL, 0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL, 0x0001020304050607ULL,
+		0x08090A0B0C0D0E0FULL, 0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL, 0x0001020304050607ULL);
+	const __m512i lowest = _mm512_set1_epi8(1);
+
+	int x = 0;
+	for (; x + 64 <= width; x += 64)
+	{
+		__m512i pixels = _mm512_shuffle_epi8(_mm512_loadu_si512((const void*)(byteRow + x)), reverse);
+		uint64_t mask = _mm512_test_epi8_mask(pixels, lowest);
+		memcpy(packedRow + x / 8, &mask, sizeof(mask));
+	}
+	packLsbRowSwar(byteRow + x, width - x, packedRow + x / 8);
+	return;
+} // packLsbRowAvx512
+
+const kernelSet gAvx512Kernels = { KERNEL_AVX512, "avx512", loadSliceRowPext, classifySliceRowAvx512, packLsbRowAvx512 };
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
@@ -0,0 +1,57 @@
+// BDPP NEON Kernels
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The classify and pack kernels for ARM64. The checks run on 2 slices per
+// 128-bit register, with bic giving a & ~b in one instruction; packing
+// shifts the lowest bit of each of 8 pixels to its place in the byte and
+// adds them across the register. Blocks are gathered with the portable
+// kernel.
+//
+
+#include "BitmapReader.h"
+#include "BitPlane.h"
+#include "Kernels.h"
+
+#ifdef KERNELS_NEON
+#include <arm_neon.h>
+
+#define SLICE_VECTOR uint64x2_t
+static inline uint64x2_t sliceAnd(uint64x2_t a, uint64x2_t b) { return vandq_u64(a, b); }
+static inline uint64x2_t sliceOr(uint64x2_t a, uint64x2_t b) { return vorrq_u64(a, b); }
+static inline uint64x2_t sliceXor(uint64x2_t a, uint64x2_t b) { return veorq_u64(a, b); }
+static inline uint64x2_t sliceAndNot(uint64x2_t a, uint64x2_t b) { return vbicq_u64(a, b); }
+static inline uint64x2_t sliceNot(uint64x2_t a) { return veorq_u64(a, vdupq_n_u64(~0ULL)); }
+#include "BlockSliceChecks.h"
+
+static void classifySliceRowNeon(sliceRow* row)
+{
+	uint64x2_t pixels[9], outcome[SLICE_OUTCOMES];
+	for (int s = 0; s < row->slices; s += 2)
+	{
+		for (int p = 0; p < 9; p++) pixels[p] = vld1q_u64(row->pixels + p * row->capacity + s);
+		sliceChecks(pixels, outcome);
+		for (int m = 0; m < SLICE_OUTCOMES; m++) vst1q_u64(row->outcome + m * row->capacity + s, outcome[m]);
+	}
+	return;
+} // classifySliceRowNeon
+
+static void packLsbRowNeon(const unsigned char* byteRow, int width, unsigned char* packedRow)
+{
+	// the first pixel of a byte goes to its top bit
+	const int8_t placesInit[16] = { 7, 6, 5, 4, 3, 2, 1, 0, 7, 6, 5, 4, 3, 2, 1, 0 };
+	const int8x16_t places = vld1q_s8(placesInit);
+	const uint8x16_t lowest = vdupq_n_u8(1);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		uint8x16_t bits = vshlq_u8(vandq_u8(vld1q_u8(byteRow + x), lowest), places);
+		packedRow[x / 8] = vaddv_u8(vget_low_u8(bits));
+		packedRow[x / 8 + 1] = vaddv_u8(vget_high_u8(bits));
+	}
+	packLsbRowSwar(byteRow + x, width - x, packedRow + x / 8);
+	return;
+} // packLsbRowNeon
+
+const kernelSet gNeonKernels = { KERNEL_NEON, "neon", loadSliceRowSwar, classifySliceRowNeon, packLsbRowNeon };
+#endif
@@ -0,0 +1,66 @@
+// BDPP SSE4.2 Kernels
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The classify and pack kernels for processors with SSE4.2. The checks run
+// on 2 slices per 128-bit register; packing reverses every 8 pixels with a
+// byte shuffle and gathers the lowest bits of 16 with one movemask, which
+// then comes out in bitmap order. Blocks are gathered with the portable
+// kernel, there is no bit gather before BMI2.
+//
+
+#include "BitmapReader.h"
+#include "BitPlane.h"
+#include "Kernels.h"
+
+#ifdef KERNELS_X86
+#include <immintrin.h>
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse4.2,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse4.2,popcnt")
+#endif
+
+#define SLICE_VECTOR __m128i
+static inline __m128i sliceAnd(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+static inline __m128i sliceOr(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+static inline __m128i sliceXor(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+static inline __m128i sliceAndNot(__m128i a, __m128i b) { return _mm_andnot_si128(b, a); }
+static inline __m128i sliceNot(__m128i a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+#include "BlockSliceChecks.h"
+
+static void classifySliceRowSse42(sliceRow* row)
+{
+	__m128i pixels[9], outcome[SLICE_OUTCOMES];
+	for (int s = 0; s < row->slices; s += 2)
+	{
+		for (int p = 0; p < 9; p++) pixels[p] = _mm_loadu_si128((const __m128i*)(row->pixels + p * row->capacity + s));
+		sliceChecks(pixels, outcome);
+		for (int m = 0; m < SLICE_OUTCOMES; m++) _mm_storeu_si128((__m128i*)(row->outcome + m * row->capacity + s), outcome[m]);
+	}
+	return;
+} // classifySliceRowSse42
+
+static void packLsbRowSse42(const unsigned char* byteRow, int width, unsigned char* packedRow)
+{
+	// the movemask puts the first pixel of a byte lowest, the bitmap wants it highest
+	const __m128i reverse = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+	int x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(byteRow + x)), reverse);
+		int mask = _mm_movemask_epi8(_mm_slli_epi64(pixels, 7));
+		packedRow[x / 8] = (unsigned char)mask;
+		packedRow[x / 8 + 1] = (unsigned char)(mask >> 8);
+	}
+	packLsbRowSwar(byteRow + x, width - x, packedRow + x / 8);
+	return;
+} // packLsbRowSse42
+
+const kernelSet gSse42Kernels = { KERNEL_SSE42, "sse42", loadSliceRowSwar, classifySliceRowSse42, packLsbRowSse42 };
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+#endif
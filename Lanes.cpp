@@ -0,0 +1,112 @@
+// BDPP Lanes
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The latency and throughput lanes of the batch and request ring modes, see
+// Lanes.h. The lanes only order the jobs, the callers run them.
+//
+
+#include "BitmapReader.h"
+#include "Lanes.h"
+#include "MemStats.h"
+
+static const char* gLaneNames[LANE_COUNT] = { "Latency", "Throughput" };
+
+int initLanes(laneScheduler* lanes, int capacity, unsigned long long splitCost, int burst)
+{
+	memset(lanes, 0, sizeof(laneScheduler));
+	lanes->capacity = capacity > 0 ? capacity : 1;
+	lanes->splitCost = splitCost;
+	lanes->burst = burst > 0 ? burst : 1;
+	for (int lane = 0; lane < LANE_COUNT; lane++)
+	{
+		lanes->jobs[lane] = (int*)trackedMalloc(sizeof(int) * lanes->capacity, MEM_SITE_BOOKKEEPING);
+		if (lanes->jobs[lane] == NULL)
+		{
+			printf("Error - Could not allocate the queues of %d jobs.\n\n", lanes->capacity);
+			freeLanes(lanes);
+			return FAILURE;
+		}
+	}
+	return SUCCESS;
+} // initLanes
+
+void freeLanes(laneScheduler* lanes)
+{
+	for (int lane = 0; lane < LANE_COUNT; lane++)
+	{
+		trackedFree(lanes->jobs[lane]);
+		lanes->jobs[lane] = NULL;
+	}
+	return;
+} // freeLanes
+
+unsigned long long estimateJobCost(int width, int height, unsigned long long payloadBits)
+{
+	unsigned long long pixels = (unsigned long long)(width < 0 ? -(long long)width : width)
+		* (unsigned long long)(height < 0 ? -(long long)height : height);
+	return pixels + payloadBits * LANE_BIT_PIXELS;
+} // estimateJobCost
+
+int pushLaneJob(laneScheduler* lanes, int job, unsigned long long cost)
+{
+	int lane = lanes->splitCost != 0 && cost > lanes->splitCost ? LANE_THROUGHPUT : LANE_LATENCY;
+	lanes->jobs[lane][(lanes->head[lane] + lanes->count[lane]) % lanes->capacity] = job;
+	lanes->count[lane]++;
+	return lane;
+} // pushLaneJob
+
+int nextLane(laneScheduler* lanes)
+{
+	if (lanes->count[LANE_THROUGHPUT] == 0)
+	{
+		lanes->latencyRun = 0;
+		return lanes->count[LANE_LATENCY] > 0 ? LANE_LATENCY : -1;
+	}
+
+	// the throughput lane never waits more than burst latency jobs for its next band
+	if (lanes->count[LANE_LATENCY] == 0 || lanes->latencyRun >= lanes->burst)
+	{
+		lanes->latencyRun = 0;
+		return LANE_THROUGHPUT;
+	}
+	lanes->latencyRun++;
+	return LANE_LATENCY;
+} // nextLane
+
+int peekLaneJob(laneScheduler* lanes, int lane)
+{
+	return lanes->jobs[lane][lanes->head[lane]];
+} // peekLaneJob
+
+void popLaneJob(laneScheduler* lanes, int lane, LARGE_INTEGER arrival)
+{
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	recordLaneLatency(&lanes->histograms[lane],
+		(unsigned long long)((now.QuadPart - arrival.QuadPart) * 1000000.0 / frequency.QuadPart));
+
+	lanes->head[lane] = (lanes->head[lane] + 1) % lanes->capacity;
+	lanes->count[lane]--;
+	return;
+} // popLaneJob
+
+void printLaneHistograms(FILE* stream, const laneHistogram histograms[LANE_COUNT])
+{
+	for (int lane = 0; lane < LANE_COUNT; lane++)
+	{
+		const laneHistogram* histogram = &histograms[lane];
+		if (histogram->jobs == 0) continue;
+
+		fprintf(stream, "%s Lane: %llu jobs, mean %.2f ms, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			gLaneNames[lane], histogram->jobs, histogram->totalMicroseconds / 1000.0 / histogram->jobs,
+			laneLatencyPercentile(histogram, 0.50) / 1000.0, laneLatencyPercentile(histogram, 0.90) / 1000.0,
+			laneLatencyPercentile(histogram, 0.99) / 1000.0, histogram->maxMicroseconds / 1000.0);
+		for (int bucket = 0; bucket < LANE_HISTOGRAM_BUCKETS; bucket++)
+		{
+			if (histogram->buckets[bucket] == 0) continue;
+			fprintf(stream, "    under %10.3f ms: %u\n", laneBucketLimit(bucket) / 1000.0, histogram->buckets[bucket]);
+		}
+	}
+	return;
+} // printLaneHistograms
@@ -0,0 +1,209 @@
+// BDPP Lanes Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Size-aware scheduling for the batch and request ring modes. Every job is
+// given a cost estimated from its image size and payload before it runs;
+// jobs up to -lanes megapixels go to the latency lane and run whole, larger
+// ones go to the throughput lane and run one band at a time between them, so
+// a gigapixel cover no longer holds up the small jobs queued behind it. The
+// throughput lane is given a band after every -laneburst latency jobs, so it
+// keeps moving however many small jobs arrive. The time from arrival to
+// completion of every job is kept in a histogram per lane.
+//
+// The histograms are plain counters kept in the request ring header as well,
+// so this file only needs the Windows API, like RequestRing.h.
+//
+
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+
+#define LANE_LATENCY			0	// small jobs, run whole as soon as they come up
+#define LANE_THROUGHPUT			1	// large jobs, run one band at a time
+#define LANE_COUNT				2
+
+#define LANE_DEFAULT_MEGAPIXELS	16	// -lanes, estimated cost above which a job is large
+#define LANE_DEFAULT_BURST		4	// -laneburst, latency jobs run before the throughput lane gets a band
+#define LANE_BIT_PIXELS			64	// pixels of work a message bit is counted as, its block found, checked and written
+
+#define LANE_HISTOGRAM_OCTAVES	32	// powers of two of microseconds, up to an hour
+#define LANE_HISTOGRAM_STEPS	4	// buckets per power of two, so a bucket is at most 25% wide
+#define LANE_HISTOGRAM_BUCKETS	(LANE_HISTOGRAM_OCTAVES * LANE_HISTOGRAM_STEPS)
+
+/*
+* Structure: laneHistogram
+* Usage: recordLaneLatency(&histograms[lane], microseconds);
+* ------------------------------------------------------
+* This structure counts the latencies of the jobs of one
+* lane. Bucket octave * LANE_HISTOGRAM_STEPS + step holds
+* the latencies from 2^octave microseconds in quarters
+* of the octave.
+*/
+struct laneHistogram
+{
+    unsigned long long jobs;
+    unsigned long long totalMicroseconds;
+    unsigned long long maxMicroseconds;
+    unsigned int buckets[LANE_HISTOGRAM_BUCKETS];
+};  // laneHistogram
+
+/*
+* Function: recordLaneLatency
+* Usage: recordLaneLatency(&histograms[lane], microseconds);
+* ------------------------------------------------------
+* This function adds the latency of one job to a lane's
+* histogram.
+*/
+static inline void recordLaneLatency(laneHistogram* histogram, unsigned long long microseconds)
+{
+    int octave = 0;
+    while (octave < LANE_HISTOGRAM_OCTAVES - 1 && (microseconds >> (octave + 1)) != 0) octave++;
+    int step = octave >= 2 ? (int)(microseconds >> (octave - 2)) & (LANE_HISTOGRAM_STEPS - 1) : 0;
+
+    histogram->buckets[octave * LANE_HISTOGRAM_STEPS + step]++;
+    histogram->jobs++;
+    histogram->totalMicroseconds += microseconds;
+    if (microseconds > histogram->maxMicroseconds) histogram->maxMicroseconds = microseconds;
+}
+
+/*
+* Function: laneBucketLimit
+* Usage: limit = laneBucketLimit(bucket);
+* ------------------------------------------------------
+* This function returns the microseconds a latency must
+* stay under to be counted in a bucket.
+*/
+static inline unsigned long long laneBucketLimit(int bucket)
+{
+    int octave = bucket / LANE_HISTOGRAM_STEPS, step = bucket % LANE_HISTOGRAM_STEPS;
+    if (octave < 2) return 1ULL << (octave + 1);
+    return (unsigned long long)(LANE_HISTOGRAM_STEPS + step + 1) << (octave - 2);
+}
+
+/*
+* Function: laneLatencyPercentile
+* Usage: p99 = laneLatencyPercentile(&histogram, 0.99);
+* ------------------------------------------------------
+* This function returns the latency in microseconds that
+* fraction of a lane's jobs stayed under, to the width of
+* a bucket and never above the slowest job, or 0 for a
+* lane with no jobs.
+*/
+static inline unsigned long long laneLatencyPercentile(const laneHistogram* histogram, double fraction)
+{
+    unsigned long long rank = (unsigned long long)(fraction * histogram->jobs + 0.999999), seen = 0;
+    if (histogram->jobs == 0) return 0;
+    if (rank < 1) rank = 1;
+    for (int bucket = 0; bucket < LANE_HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank)
+        {
+            unsigned long long limit = laneBucketLimit(bucket);
+            return limit < histogram->maxMicroseconds ? limit : histogram->maxMicroseconds;
+        }
+    }
+    return histogram->maxMicroseconds;
+}
+
+/*
+* Structure: laneScheduler
+* Usage: laneScheduler lanes; initLanes(&lanes, numJobs, splitCost, burst);
+* ------------------------------------------------------
+* This structure holds the jobs waiting in each lane, in
+* the order they arrived, by the number the caller gave
+* them. The first job of the throughput lane stays at
+* its head until the caller pops it, band after band.
+*/
+struct laneScheduler
+{
+    int* jobs[LANE_COUNT];        // a circular queue of job numbers per lane
+    int head[LANE_COUNT];
+    int count[LANE_COUNT];
+    int capacity;                 // jobs each queue holds
+    unsigned long long splitCost; // jobs costing more go to the throughput lane, 0 puts every job in the latency lane
+    int burst;                    // latency jobs in a row before the throughput lane is served
+    int latencyRun;               // latency jobs served since the throughput lane last was
+    laneHistogram histograms[LANE_COUNT];
+};  // laneScheduler
+
+/*
+* Function: initLanes
+* Usage: if (initLanes(&lanes, numJobs, splitCost, burst) != SUCCESS) ...
+* ------------------------------------------------------
+* This function sets up empty lanes for up to capacity
+* waiting jobs each. Returns FAILURE if the queues could
+* not be allocated.
+*/
+int initLanes(laneScheduler* lanes, int capacity, unsigned long long splitCost, int burst);
+
+/*
+* Function: freeLanes
+* Usage: freeLanes(&lanes);
+* ------------------------------------------------------
+* This function releases the queues of initLanes.
+*/
+void freeLanes(laneScheduler* lanes);
+
+/*
+* Function: estimateJobCost
+* Usage: cost = estimateJobCost(width, height, payloadBits);
+* ------------------------------------------------------
+* This function returns the cost of a hide or extract in
+* pixels of work: the pixels of the image read, checked
+* and written, plus LANE_BIT_PIXELS for every message
+* bit. A negative height (a top-down image) counts the
+* same as a positive one.
+*/
+unsigned long long estimateJobCost(int width, int height, unsigned long long payloadBits);
+
+/*
+* Function: pushLaneJob
+* Usage: lane = pushLaneJob(&lanes, job, cost);
+* ------------------------------------------------------
+* This function queues a job at the back of the lane its
+* cost puts it in and returns that lane.
+*/
+int pushLaneJob(laneScheduler* lanes, int job, unsigned long long cost);
+
+/*
+* Function: nextLane
+* Usage: lane = nextLane(&lanes);
+* ------------------------------------------------------
+* This function returns the lane to run next, or -1 if
+* both are empty. The latency lane goes first, but not
+* more than burst times in a row while the throughput
+* lane has a job waiting.
+*/
+int nextLane(laneScheduler* lanes);
+
+/*
+* Function: peekLaneJob
+* Usage: job = peekLaneJob(&lanes, lane);
+* ------------------------------------------------------
+* This function returns the job at the head of a lane,
+* which must not be empty.
+*/
+int peekLaneJob(laneScheduler* lanes, int lane);
+
+/*
+* Function: popLaneJob
+* Usage: popLaneJob(&lanes, lane, arrival);
+* ------------------------------------------------------
+* This function removes the finished job at the head of
+* a lane and adds the time since its arrival, a
+* QueryPerformanceCounter reading, to the lane's
+* histogram.
+*/
+void popLaneJob(laneScheduler* lanes, int lane, LARGE_INTEGER arrival);
+
+/*
+* Function: printLaneHistograms
+* Usage: printLaneHistograms(stdout, lanes.histograms);
+* ------------------------------------------------------
+* This function prints the jobs and latency percentiles
+* of each lane that ran any, then its histogram, one
+* line per bucket that is not empty.
+*/
+void printLaneHistograms(FILE* stream, const laneHistogram histograms[LANE_COUNT]);
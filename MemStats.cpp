@@ -0,0 +1,143 @@
+// Memory Statistics
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Every tracked buffer carries a small prefix with its size and site so that
+// trackedFree can take it off the right counters. The counters are atomic,
+// the pipeline and I/O threads allocate and free at the same time.
+//
+
+#include <windows.h>
+#include <psapi.h>
+#include <stdlib.h>
+#include <atomic>
+#include "MemStats.h"
+
+// kept at 16 bytes so the memory handed out stays aligned like malloc's
+struct memPrefix
+{
+	size_t size;
+	size_t site;
+};
+
+struct memSiteStats
+{
+	std::atomic<long long> allocations{ 0 };
+	std::atomic<long long> bytes{ 0 };      // all bytes ever allocated
+	std::atomic<long long> live{ 0 };       // bytes currently allocated
+	std::atomic<long long> peakLive{ 0 };
+};
+
+static memSiteStats gSiteStats[MEM_SITE_COUNT];
+static std::atomic<long long> gLiveBytes{ 0 };
+static std::atomic<long long> gPeakLiveBytes{ 0 };
+
+static const char* gSiteNames[MEM_SITE_COUNT] = { "file", "message", "extract", "output", "band", "bookkeeping" };
+
+// raises peak to value if value is larger, other threads may be doing the same
+static void raisePeak(std::atomic<long long>* peak, long long value)
+{
+	long long current = peak->load(std::memory_order_relaxed);
+	while (value > current && !peak->compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+} // raisePeak
+
+static void countAllocation(size_t size, int site)
+{
+	memSiteStats* stats = &gSiteStats[site];
+	stats->allocations++;
+	stats->bytes += size;
+	raisePeak(&stats->peakLive, stats->live += size);
+	raisePeak(&gPeakLiveBytes, gLiveBytes += size);
+} // countAllocation
+
+static void countRelease(size_t size, int site)
+{
+	gSiteStats[site].live -= size;
+	gLiveBytes -= size;
+} // countRelease
+
+void* trackedMalloc(size_t size, int site)
+{
+	memPrefix* prefix = (memPrefix*)malloc(sizeof(memPrefix) + size);
+	if (prefix == NULL) return NULL;
+
+	prefix->size = size;
+	prefix->site = site;
+	countAllocation(size, site);
+	return prefix + 1;
+} // trackedMalloc
+
+void* trackedCalloc(size_t count, size_t size, int site)
+{
+	memPrefix* prefix = (memPrefix*)calloc(1, sizeof(memPrefix) + count * size);
+	if (prefix == NULL) return NULL;
+
+	prefix->size = count * size;
+	prefix->site = site;
+	countAllocation(count * size, site);
+	return prefix + 1;
+} // trackedCalloc
+
+void* trackedRealloc(void* memory, size_t size, int site)
+{
+	if (memory == NULL) return trackedMalloc(size, site);
+
+	memPrefix* prefix = (memPrefix*)memory - 1;
+	size_t oldSize = prefix->size;
+	int oldSite = (int)prefix->site;
+	memPrefix* resized = (memPrefix*)realloc(prefix, sizeof(memPrefix) + size);
+	if (resized == NULL) return NULL;
+
+	countRelease(oldSize, oldSite);
+	resized->size = size;
+	resized->site = site;
+	countAllocation(size, site);
+	return resized + 1;
+} // trackedRealloc
+
+void trackedFree(void* memory)
+{
+	if (memory == NULL) return;
+
+	memPrefix* prefix = (memPrefix*)memory - 1;
+	countRelease(prefix->size, (int)prefix->site);
+	free(prefix);
+} // trackedFree
+
+void printMemStats(FILE* ptrFile, int format)
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	unsigned long long peakWorkingSet = 0;
+
+	// the Windows counterpart of VmHWM, the largest resident set the process has had
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		peakWorkingSet = counters.PeakWorkingSetSize;
+	}
+
+	if (format == MEMSTATS_JSON)
+	{
+		fprintf(ptrFile, "{\"peakLiveBytes\":%lld,\"liveBytes\":%lld,\"peakWorkingSetBytes\":%llu,\"sites\":{",
+			gPeakLiveBytes.load(), gLiveBytes.load(), peakWorkingSet);
+		for (int i = 0; i < MEM_SITE_COUNT; i++)
+		{
+			fprintf(ptrFile, "%s\"%s\":{\"allocations\":%lld,\"bytes\":%lld,\"peakLiveBytes\":%lld}",
+				i ? "," : "", gSiteNames[i], gSiteStats[i].allocations.load(), gSiteStats[i].bytes.load(),
+				gSiteStats[i].peakLive.load());
+		}
+		fprintf(ptrFile, "}}\n");
+		return;
+	}
+
+	fprintf(ptrFile, "\nMemory Statistics:\n");
+	fprintf(ptrFile, "%-12s %12s %16s %16s\n", "Site", "Allocations", "Bytes", "Peak Live Bytes");
+	for (int i = 0; i < MEM_SITE_COUNT; i++)
+	{
+		fprintf(ptrFile, "%-12s %12lld %16lld %16lld\n", gSiteNames[i], gSiteStats[i].allocations.load(),
+			gSiteStats[i].bytes.load(), gSiteStats[i].peakLive.load());
+	}
+	fprintf(ptrFile, "Peak Live Bytes: %lld\n", gPeakLiveBytes.load());
+	fprintf(ptrFile, "Live Bytes at Exit: %lld\n", gLiveBytes.load());
+	fprintf(ptrFile, "Peak Working Set: %llu bytes\n", peakWorkingSet);
+} // printMemStats
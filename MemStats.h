@@ -0,0 +1,71 @@
+// Memory Statistics Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Counts the buffers the program allocates by the part of the program that
+// asked for them, keeps the peak of live bytes and reports the process peak
+// working set, so memory limits can be sized and new whole-image buffers
+// show up in the numbers.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define MEM_SITE_FILE		0	// bitmap and message files read from disk
+#define MEM_SITE_MESSAGE	1	// generated or scratch message data
+#define MEM_SITE_EXTRACT	2	// extracted bits
+#define MEM_SITE_OUTPUT		3	// output files built in memory
+#define MEM_SITE_BAND		4	// pipeline band buffers
+#define MEM_SITE_BOOKKEEPING	5	// batch jobs and I/O requests
+#define MEM_SITE_COUNT		6
+
+#define MEMSTATS_OFF	0
+#define MEMSTATS_TEXT	1
+#define MEMSTATS_JSON	2
+
+/*
+* Function: trackedMalloc
+* Usage: pFile = (unsigned char*)trackedMalloc(fileSize, MEM_SITE_FILE);
+* ------------------------------------------------------
+* This function allocates size bytes like malloc and
+* adds them to the counters of the given site. Memory
+* from trackedMalloc must be released with trackedFree.
+*/
+void* trackedMalloc(size_t size, int site);
+
+/*
+* Function: trackedCalloc
+* Usage: request = (ioRequest*)trackedCalloc(1, sizeof(ioRequest), MEM_SITE_BOOKKEEPING);
+* ------------------------------------------------------
+* This function is trackedMalloc for zeroed memory.
+*/
+void* trackedCalloc(size_t count, size_t size, int site);
+
+/*
+* Function: trackedRealloc
+* Usage: jobs = (batchJob*)trackedRealloc(jobs, newSize, MEM_SITE_BOOKKEEPING);
+* ------------------------------------------------------
+* This function resizes a tracked buffer like realloc.
+*/
+void* trackedRealloc(void* memory, size_t size, int site);
+
+/*
+* Function: trackedFree
+* Usage: trackedFree(pFile);
+* ------------------------------------------------------
+* This function releases memory from trackedMalloc and
+* takes it off the live counters. NULL is ignored.
+*/
+void trackedFree(void* memory);
+
+/*
+* Function: printMemStats
+* Usage: printMemStats(stdout, MEMSTATS_JSON);
+* ------------------------------------------------------
+* This function prints the allocation count, bytes and
+* peak live bytes of every site, the overall peak and
+* the peak working set of the process, as text or as a
+* single line of JSON.
+*/
+void printMemStats(FILE* ptrFile, int format);
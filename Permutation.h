@@ -0,0 +1,89 @@
+// BDPP Block Permutation Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Key-derived pseudo-random order of the blocks of an image. A balanced
+// Feistel network over the smallest even power of two that covers the block
+// count is a bijection on that domain; values past the last block are walked
+// through the network again until they land on a block (cycle walking), which
+// keeps it a bijection on the blocks. Any position of the order is computed
+// on its own in a few rounds, so no shuffled index array is ever built.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include "BDPPRandom.h"
+
+#define PERMUTATION_ROUNDS 6
+
+/*
+* Structure: blockPermutation
+* Usage: blockPermutation permutation; initBlockPermutation(&permutation, totalBlocks, seed);
+* ------------------------------------------------------
+* This structure holds the round keys of the Feistel
+* network and the size of its domain. It is all the
+* state the permutation needs, whatever the image size.
+*/
+struct blockPermutation
+{
+    uint32_t totalBlocks;
+    int halfBits;                             // bits in each half of the Feistel domain
+    uint32_t halfMask;
+    uint32_t roundKeys[PERMUTATION_ROUNDS];
+};  // blockPermutation
+
+/*
+* Function: initBlockPermutation
+* Usage: initBlockPermutation(&permutation, totalBlocks, seed);
+* ------------------------------------------------------
+* This function sizes the Feistel domain for totalBlocks
+* and derives the round keys from the seed.
+*/
+static inline void initBlockPermutation(blockPermutation* permutation, uint32_t totalBlocks, uint64_t seed)
+{
+    uint64_t x = seed;
+
+    permutation->totalBlocks = totalBlocks;
+    permutation->halfBits = 1;
+    while (((uint64_t)1 << (2 * permutation->halfBits)) < totalBlocks) permutation->halfBits++;
+    permutation->halfMask = ((uint32_t)1 << permutation->halfBits) - 1;
+    for (int i = 0; i < PERMUTATION_ROUNDS; i++)
+    {
+        permutation->roundKeys[i] = (uint32_t)splitMix64(&x);
+    }
+}
+
+// Feistel round function, mixes one half with the round key
+static inline uint32_t permutationRound(uint32_t half, uint32_t key)
+{
+    uint32_t z = (half ^ key) * 0x9E3779B1u;
+    z ^= z >> 15;
+    z *= 0x85EBCA77u;
+    return z ^ (z >> 13);
+}
+
+/*
+* Function: permuteBlock
+* Usage: blockNumber = permuteBlock(&permutation, rank);
+* ------------------------------------------------------
+* This function returns the block visited at position
+* rank of the order. Every rank below totalBlocks maps to
+* a different block.
+*/
+static inline uint32_t permuteBlock(const blockPermutation* permutation, uint32_t rank)
+{
+    uint32_t value = rank;
+    do
+    {
+        uint32_t left = value >> permutation->halfBits;
+        uint32_t right = value & permutation->halfMask;
+        for (int i = 0; i < PERMUTATION_ROUNDS; i++)
+        {
+            uint32_t next = left ^ (permutationRound(right, permutation->roundKeys[i]) & permutation->halfMask);
+            left = right;
+            right = next;
+        }
+        value = (left << permutation->halfBits) | right;
+    } while (value >= permutation->totalBlocks);
+    return value;
+}
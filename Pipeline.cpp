@@ -0,0 +1,499 @@
+// BDPP Pipeline
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// The reader, BDPP and writer stages are connected by lock-free single
+// producer single consumer queues. A fixed set of band buffers circulates
+// reader -> BDPP -> writer -> reader, so memory use does not grow with the
+// image size and the total time approaches the slowest of the three stages.
+//
+
+#include "BitmapReader.h"
+#include "Pipeline.h"
+#include "SPSCQueue.h"
+#include "MemStats.h"
+#include "Trace.h"
+#include "BitPlane.h"
+#include "Durable.h"
+#include <fcntl.h>
+
+typedef spscQueue<pixelBand*, PIPELINE_BANDS_IN_FLIGHT> bandQueue;
+
+int readBitmapHeader(char* fileName, BITMAPFILEHEADER* pFileHdr, BITMAPINFOHEADER* pFileInfo)
+{
+	FILE* ptrFile = fopen(fileName, "rb");
+	int status = FAILURE;
+
+	if (ptrFile == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", fileName);
+		return FAILURE;
+	}
+
+	if (fread(pFileHdr, sizeof(BITMAPFILEHEADER), 1, ptrFile) == 1
+		&& fread(pFileInfo, sizeof(BITMAPINFOHEADER), 1, ptrFile) == 1
+		&& (pFileHdr->bfType & 0xFF) == 'B' && (pFileHdr->bfType >> 8) == 'M')
+	{
+		status = SUCCESS;
+	}
+	else
+	{
+		printf("Error - %s is not a valid bitmap file.\n\n", fileName);
+	}
+
+	// the bands are 1-bit rows as they lie in the file, only the whole image paths unpack an 8-bit plane
+	// or view the rows of a top-down file from the last one back
+	if (status == SUCCESS && pFileInfo->biBitCount != 1)
+	{
+		printf("Error - %s has %d bits per pixel, bands and samples are read from 1-bit images only.\n\n",
+			fileName, pFileInfo->biBitCount);
+		status = FAILURE;
+	}
+	else if (status == SUCCESS && pFileInfo->biHeight < 0)
+	{
+		printf("Error - %s stores its top row first, bands and samples are read from bottom-up images only.\n\n", fileName);
+		status = FAILURE;
+	}
+	fclose(ptrFile);
+	return status;
+} // readBitmapHeader
+
+// reader stage, fills free band buffers with the next rows of the file in order
+// once the BDPP stage sets stop, the next band is handed over empty as the last one
+static void readerStage(FILE* ptrFile, size_t pixelBytes, size_t rowSize, int blockHeight,
+	bandQueue* freeQueue, bandQueue* readQueue, int* readError, volatile LONG* stop, int traceImage)
+{
+	size_t bandBytes = PIPELINE_BAND_BLOCK_ROWS * 3 * rowSize;
+	size_t offset = 0;
+	int blockRow = 0;
+
+	traceThreadName("reader");
+	for (;;)
+	{
+		traceBegin(TRACE_WAIT, traceImage, TRACE_NO_ID);
+		pixelBand* band = freeQueue->pop();
+		traceEnd(TRACE_WAIT, traceImage, TRACE_NO_ID);
+
+		if (*stop)
+		{
+			band->firstBlockRow = blockRow;
+			band->numBlockRows = 0;
+			band->size = 0;
+			band->last = 1;
+			readQueue->push(band);
+			return;
+		}
+
+		band->firstBlockRow = blockRow;
+		band->numBlockRows = blockHeight - blockRow;
+		if (band->numBlockRows > PIPELINE_BAND_BLOCK_ROWS) band->numBlockRows = PIPELINE_BAND_BLOCK_ROWS;
+		if (band->numBlockRows > 0)
+		{
+			band->size = band->numBlockRows * 3 * rowSize;
+		}
+		else
+		{
+			// leftover rows above the last row of blocks and anything after them
+			band->numBlockRows = 0;
+			band->size = pixelBytes - offset < bandBytes ? pixelBytes - offset : bandBytes;
+		}
+		if (band->size > pixelBytes - offset) band->size = pixelBytes - offset;
+
+		traceBegin(TRACE_READ, traceImage, band->firstBlockRow);
+		size_t got = fread(band->data, 1, band->size, ptrFile);
+		traceEnd(TRACE_READ, traceImage, band->firstBlockRow);
+		if (got != band->size)
+		{
+			*readError = 1;
+			band->size = got;
+		}
+
+		blockRow += band->numBlockRows;
+		offset += band->size;
+		band->last = (offset >= pixelBytes || *readError);
+		readQueue->push(band);
+		if (band->last) return;
+	}
+} // readerStage
+
+// writer stage, writes the header and then every band as soon as the BDPP stage hands it over
+static void writerStage(FILE* ptrFile, unsigned char* headerData, size_t headerSize, bandQueue* writeQueue,
+	bandQueue* freeQueue, int* writeError, int traceImage)
+{
+	traceThreadName("writer");
+	if (fwrite(headerData, 1, headerSize, ptrFile) != headerSize) *writeError = 1;
+
+	for (;;)
+	{
+		traceBegin(TRACE_WAIT, traceImage, TRACE_NO_ID);
+		pixelBand* band = writeQueue->pop();
+		traceEnd(TRACE_WAIT, traceImage, TRACE_NO_ID);
+		int last = band->last;
+
+		traceBegin(TRACE_WRITE, traceImage, band->firstBlockRow);
+		if (fwrite(band->data, 1, band->size, ptrFile) != band->size) *writeError = 1;
+		traceEnd(TRACE_WRITE, traceImage, band->firstBlockRow);
+		freeQueue->push(band);
+		if (last) return;
+	}
+} // writerStage
+
+// releases the band buffers allocated so far and the header, for every way out of runPipeline
+static void freePipelineBuffers(pixelBand* bands, int numAllocated, unsigned char* headerData)
+{
+	for (int i = 0; i < numAllocated; i++)
+	{
+		trackedFree(bands[i].data);
+	}
+	trackedFree(headerData);
+	return;
+} // freePipelineBuffers
+
+int runPipeline(char* inputFileName, char* outputFileName, unsigned char* msgPixelData, unsigned int msgBits,
+	unsigned char* extractedBits, int gKey, int action, requestContext* request)
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	unsigned char* headerData;
+	imageView image, bandView;
+	FILE* inFile, * outFile = NULL;
+	pixelBand bands[PIPELINE_BANDS_IN_FLIGHT];
+	bandQueue freeQueue, readQueue, writeQueue;
+	bandState state;
+	int readError = 0, writeError = 0, numBands = 0;
+	volatile LONG stop = 0;
+	char writeName[MAX_PATH];
+
+	if (readBitmapHeader(inputFileName, &fileHdr, &fileInfo) != SUCCESS) return FAILURE;
+
+	// the stego file gets the cover's header and palette byte for byte, whatever their size
+	headerData = (unsigned char*)trackedMalloc(fileHdr.bfOffBits, MEM_SITE_FILE);
+	if (headerData == NULL)
+	{
+		printf("Error - Could not allocate %u bytes of memory for the header of %s.\n\n", fileHdr.bfOffBits, inputFileName);
+		failRequest(request);
+		return FAILURE;
+	}
+	inFile = fopen(inputFileName, "rb");
+	if (inFile == NULL || fread(headerData, 1, fileHdr.bfOffBits, inFile) != fileHdr.bfOffBits)
+	{
+		printf("Error reading file: %s.\n\n", inputFileName);
+		if (inFile != NULL) fclose(inFile);
+		trackedFree(headerData);
+		return FAILURE;
+	}
+
+	if (action == ACTION_HIDE)
+	{
+		outFile = durableWriteName(outputFileName, writeName) == SUCCESS ? fopen(writeName, "wb") : NULL;
+		if (outFile == NULL)
+		{
+			printf("Error opening file (%s) for writing.\n\n", outputFileName);
+			fclose(inFile);
+			trackedFree(headerData);
+			return FAILURE;
+		}
+	}
+
+	initImageView(&image, &fileInfo, NULL);
+	size_t rowSize = (size_t)image.stride;
+	size_t bandBytes = PIPELINE_BAND_BLOCK_ROWS * 3 * rowSize;
+	int numAllocated = 0;
+	int status = initBandState(&state, &image, msgPixelData, msgBits, extractedBits, gKey, action);
+	for (; status == SUCCESS && numAllocated < PIPELINE_BANDS_IN_FLIGHT; numAllocated++)
+	{
+		bands[numAllocated].data = (unsigned char*)trackedMalloc(bandBytes, MEM_SITE_BAND);
+		if (bands[numAllocated].data == NULL)
+		{
+			printf("Error - Could not allocate %zu bytes of memory for a pixel band.\n\n", bandBytes);
+			status = FAILURE;
+			break;
+		}
+		freeQueue.push(&bands[numAllocated]);
+	}
+	if (status != SUCCESS)
+	{
+		failRequest(request);
+		fclose(inFile);
+		if (outFile != NULL)
+		{
+			fclose(outFile);
+			durableDiscard(writeName);
+		}
+		freeAnalysis(state.analysis);
+		freePipelineBuffers(bands, numAllocated, headerData);
+		return FAILURE;
+	}
+	state.request = request;
+	setRequestBands(request, (state.blockHeight + PIPELINE_BAND_BLOCK_ROWS - 1) / PIPELINE_BAND_BLOCK_ROWS);
+
+	size_t pixelBytes = fileHdr.bfSize - fileHdr.bfOffBits;
+	std::thread reader(readerStage, inFile, pixelBytes, rowSize, state.blockHeight,
+		&freeQueue, &readQueue, &readError, &stop, state.traceImage);
+	std::thread writer;
+	if (action == ACTION_HIDE)
+	{
+		writer = std::thread(writerStage, outFile, headerData, (size_t)fileHdr.bfOffBits, &writeQueue, &freeQueue, &writeError, state.traceImage);
+	}
+
+	// BDPP stage, runs on this thread. A stopped request tells the reader to end early, the bands
+	// already in flight are passed along unprocessed so the other stages drain and exit
+	for (;;)
+	{
+		traceBegin(TRACE_WAIT, state.traceImage, TRACE_NO_ID);
+		pixelBand* band = readQueue.pop();
+		traceEnd(TRACE_WAIT, state.traceImage, TRACE_NO_ID);
+		int last = band->last;
+
+		if (!stop && band->numBlockRows > 0 && isRequestStopped(request)) stop = 1;
+		if (!stop)
+		{
+			initRowsView(&bandView, band->data, rowSize, image.width, band->numBlockRows * 3, 1);
+			if (processBand(&state, &bandView, band->firstBlockRow, band->numBlockRows) != SUCCESS) stop = 1;
+			else if (band->numBlockRows > 0) finishRequestBands(request, 1);
+		}
+		numBands++;
+		if (action == ACTION_HIDE)
+		{
+			writeQueue.push(band);
+		}
+		else
+		{
+			freeQueue.push(band);
+		}
+		if (last) break;
+	}
+
+	reader.join();
+	if (writer.joinable()) writer.join();
+	fclose(inFile);
+	if (outFile != NULL) fclose(outFile);
+	freePipelineBuffers(bands, numAllocated, headerData);
+
+	// a stego file cut short by a read or write error never takes the place of the output, and the
+	// half written file of a stopped request is removed even without -durable
+	if (outFile != NULL)
+	{
+		if (stop) DeleteFileA(writeName);
+		else if (readError || writeError) durableDiscard(writeName);
+		else if (durableFinish(writeName) != SUCCESS) writeError = 1;
+	}
+	if (stop)
+	{
+		freeAnalysis(state.analysis);
+		return FAILURE;
+	}
+
+	status = reportBandResults(&state);
+	printf("Pipeline: %d bands of up to %d block rows\n", numBands, PIPELINE_BAND_BLOCK_ROWS);
+	if (readError)
+	{
+		printf("Error - %s ended before the size given in its header.\n\n", inputFileName);
+		return FAILURE;
+	}
+	if (writeError)
+	{
+		printf("Error writing file %s.\n\n", outputFileName);
+		return FAILURE;
+	}
+	return status;
+} // runPipeline
+
+// reads the three pixel rows of a row of blocks into fileRows, then packs their bit-plane into plane if it is not NULL
+static int readBlockRow(FILE* ptrFile, imageView* fileRows, imageView* plane)
+{
+	size_t rowsBytes = 3 * (size_t)fileRows->stride;
+	if (fread(fileRows->base, 1, rowsBytes, ptrFile) != rowsBytes) return FAILURE;
+	if (plane == NULL) return SUCCESS;
+	for (int k = 0; k < 3; k++)
+	{
+		packLsbRow(imageRow(fileRows, k) + fileRows->bitOffset / 8, plane->width, imageRow(plane, k));
+	}
+	return SUCCESS;
+} // readBlockRow
+
+// reads past count bytes, so that a pipe works the same as a file
+static int skipBytes(FILE* ptrFile, unsigned long long count)
+{
+	unsigned char skipped[256];
+	while (count > 0)
+	{
+		size_t chunk = count < sizeof(skipped) ? (size_t)count : sizeof(skipped);
+		if (fread(skipped, 1, chunk, ptrFile) != chunk) return FAILURE;
+		count -= chunk;
+	}
+	return SUCCESS;
+} // skipBytes
+
+int runStreamExtract(char* stegoFileName, unsigned char* extractedBits, int gKey, requestContext* request)
+{
+	BITMAPFILEHEADER fileHdr;
+	BITMAPINFOHEADER fileInfo;
+	bandState state;
+	imageView image, fileRows, planeRows;
+	FILE* ptrFile;
+	unsigned char* rows, * plane = NULL;
+	int fromStdin = strcmp(stegoFileName, "-") == 0;
+	int rowsRead = 0, status = SUCCESS, stopped = 0;
+
+	if (fromStdin)
+	{
+		_setmode(_fileno(stdin), _O_BINARY);
+		ptrFile = stdin;
+	}
+	else
+	{
+		ptrFile = fopen(stegoFileName, "rb");
+		if (ptrFile == NULL)
+		{
+			printf("Error in opening file: %s.\n\n", stegoFileName);
+			return FAILURE;
+		}
+	}
+	setvbuf(ptrFile, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+
+	if (fread(&fileHdr, sizeof(BITMAPFILEHEADER), 1, ptrFile) != 1
+		|| fread(&fileInfo, sizeof(BITMAPINFOHEADER), 1, ptrFile) != 1
+		|| (fileHdr.bfType & 0xFF) != 'B' || (fileHdr.bfType >> 8) != 'M'
+		|| fileHdr.bfOffBits < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER))
+	{
+		printf("Error - %s is not a valid bitmap file.\n\n", fromStdin ? "standard input" : stegoFileName);
+		if (!fromStdin) fclose(ptrFile);
+		return FAILURE;
+	}
+	if ((fileInfo.biBitCount != 1 && fileInfo.biBitCount != 8) || fileInfo.biCompression != BI_RGB)
+	{
+		printf("Error - %d-bit or compressed images are not supported, only 1-bit and 8-bit grayscale.\n\n", fileInfo.biBitCount);
+		if (!fromStdin) fclose(ptrFile);
+		return FAILURE;
+	}
+
+	// -rect: the blocks are those of a sub-rectangle, given from the top left as the image is viewed
+	initImageView(&image, &fileInfo, NULL);
+	int rectX = 0, rectY = 0, rectWidth = image.width, rectHeight = image.height;
+	if (gRectWidth != 0)
+	{
+		rectX = gRectX;
+		rectY = gRectY;
+		rectWidth = gRectWidth;
+		rectHeight = gRectHeight;
+		if (cropImageView(&image, rectX, rectY, rectWidth, rectHeight) != SUCCESS)
+		{
+			printf("Error - the rectangle given with -rect is not inside the %dx%d image.\n\n", image.width, image.height);
+			if (!fromStdin) fclose(ptrFile);
+			return FAILURE;
+		}
+	}
+
+	// the header may be longer than 40 bytes and the palette is read past rather than seeked over
+	unsigned long long bytesRead = fileHdr.bfOffBits;
+	status = skipBytes(ptrFile, fileHdr.bfOffBits - sizeof(BITMAPFILEHEADER) - sizeof(BITMAPINFOHEADER));
+	if (initBandState(&state, &image, NULL, 0, extractedBits, gKey, ACTION_EXTRACT) != SUCCESS)
+	{
+		failRequest(request);
+		if (!fromStdin) fclose(ptrFile);
+		return FAILURE;
+	}
+	state.request = request;
+	size_t fileRowSize = bitmapRowSize(fileInfo.biWidth, fileInfo.biBitCount);
+	int fileHeight = fileInfo.biHeight < 0 ? -fileInfo.biHeight : fileInfo.biHeight;
+
+	// a permuted order can end anywhere in the image and a top-down file stores the first row of blocks
+	// last, so the whole image is read before extracting
+	if (state.permuted || fileInfo.biHeight < 0)
+	{
+		rows = (unsigned char*)trackedMalloc(fileRowSize * fileHeight + 1, MEM_SITE_BAND);
+		if (rows == NULL)
+		{
+			printf("Error - Could not allocate memory for the pixel data of %s.\n\n", stegoFileName);
+			stopped = 1;
+		}
+		traceBegin(TRACE_READ, state.traceImage, TRACE_NO_ID);
+		if (!stopped && status == SUCCESS && fread(rows, 1, fileRowSize * fileHeight, ptrFile) != fileRowSize * fileHeight) status = FAILURE;
+		traceEnd(TRACE_READ, state.traceImage, TRACE_NO_ID);
+		if (!stopped && status == SUCCESS)
+		{
+			initImageView(&image, &fileInfo, rows);
+			cropImageView(&image, rectX, rectY, rectWidth, rectHeight);
+			if (image.bitsPerPixel == 8)
+			{
+				plane = packLsbPlane(&image);
+				if (plane == NULL) printf("Error - Could not allocate memory for the bit-plane.\n\n");
+				else initRowsView(&image, plane, bitmapRowSize(rectWidth, 1), rectWidth, rectHeight, 1);
+			}
+			bytesRead += fileRowSize * fileHeight;
+			rowsRead = state.blockHeight;
+			stopped = (image.bitsPerPixel == 8 && plane == NULL) || processBands(&state, &image) != SUCCESS;
+		}
+	}
+	else
+	{
+		// rows are stored bottom up, those below the rectangle are read past
+		unsigned long long rowsBelow = (unsigned long long)(fileHeight - rectY - rectHeight) * fileRowSize;
+		if (status == SUCCESS) status = skipBytes(ptrFile, rowsBelow);
+		bytesRead += rowsBelow;
+
+		rows = (unsigned char*)trackedMalloc(3 * fileRowSize, MEM_SITE_BAND);
+		if (rows == NULL)
+		{
+			printf("Error - Could not allocate %zu bytes of memory for a row of blocks.\n\n", 3 * fileRowSize);
+			stopped = 1;
+		}
+		else
+		{
+			initRowsView(&fileRows, rows, fileRowSize, fileInfo.biWidth, 3, fileInfo.biBitCount);
+			cropImageView(&fileRows, rectX, 0, rectWidth, 3);
+		}
+
+		// an 8-bit stego file is read a row of blocks of bytes at a time, its bit-plane packed into plane
+		if (!stopped && fileInfo.biBitCount == 8)
+		{
+			plane = (unsigned char*)trackedMalloc(3 * bitmapRowSize(rectWidth, 1), MEM_SITE_BAND);
+			if (plane == NULL)
+			{
+				printf("Error - Could not allocate %zu bytes of memory for a row of blocks.\n\n", 3 * bitmapRowSize(rectWidth, 1));
+				stopped = 1;
+			}
+			else initRowsView(&planeRows, plane, bitmapRowSize(rectWidth, 1), rectWidth, 3, 1);
+		}
+
+		// one row of blocks at a time, the loop ends as soon as the key's bits are recovered
+		// unless -analysis needs every block, or when the request is stopped; every row of blocks is a band
+		setRequestBands(request, state.blockHeight);
+		while (!stopped && status == SUCCESS && rowsRead < state.blockHeight && (state.bitIndex < (unsigned int)gKey || state.analysis != NULL))
+		{
+			if (isRequestStopped(request))
+			{
+				stopped = 1;
+				break;
+			}
+			traceBegin(TRACE_READ, state.traceImage, rowsRead);
+			status = readBlockRow(ptrFile, &fileRows, plane != NULL ? &planeRows : NULL);
+			traceEnd(TRACE_READ, state.traceImage, rowsRead);
+			if (status != SUCCESS) break;
+			bytesRead += 3 * fileRowSize;
+			if (processBand(&state, plane != NULL ? &planeRows : &fileRows, rowsRead, 1) != SUCCESS) stopped = 1;
+			rowsRead++;
+			finishRequestBands(request, 1);
+		}
+	}
+
+	if (!fromStdin) fclose(ptrFile);
+	trackedFree(rows);
+	trackedFree(plane);
+	if (stopped)
+	{
+		failRequest(request);
+		freeAnalysis(state.analysis);
+		return FAILURE;
+	}
+	if (status != SUCCESS)
+	{
+		printf("Error - %s ended before the size given in its header.\n\n", fromStdin ? "standard input" : stegoFileName);
+		freeAnalysis(state.analysis);
+		return FAILURE;
+	}
+
+	reportBandResults(&state);
+	printf("Rows of Blocks Read: %d of %d (%llu of %u bytes)\n", rowsRead, state.blockHeight, bytesRead, fileHdr.bfSize);
+	return SUCCESS;
+} // runStreamExtract
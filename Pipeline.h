@@ -0,0 +1,77 @@
+// BDPP Pipeline Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Streams a single image through three threads: a reader that loads row
+// bands from the file, the BDPP stage that classifies and embeds each band,
+// and a writer that writes finished bands while later ones are still read.
+//
+
+#pragma once
+
+#include <windows.h>
+#include <stddef.h>
+#include "Request.h"
+
+#define PIPELINE_BAND_BLOCK_ROWS	64	// rows of blocks per band (3 pixel rows each)
+#define PIPELINE_BANDS_IN_FLIGHT	8	// band buffers shared by the three stages
+#define STREAM_BUFFER_SIZE			(64 * 1024)	// stdio buffer for streamed extraction
+
+/*
+* Structure: pixelBand
+* Usage: pixelBand* band = readQueue.pop();
+* ------------------------------------------------------
+* This structure is one buffer of pixel rows passed
+* between the pipeline stages. Bands with no block rows
+* carry the leftover rows at the top of the image, they
+* are written out unchanged.
+*/
+struct pixelBand
+{
+    unsigned char* data;
+    size_t size;          // bytes of pixel data in this band
+    int firstBlockRow;    // index of the first row of blocks in the band
+    int numBlockRows;     // rows of blocks in the band, 0 for leftover rows
+    int last;             // 1 for the final band of the file
+};  // pixelBand
+
+/*
+* Function: readBitmapHeader
+* Usage: readBitmapHeader(fileName, &fileHdr, &fileInfoHdr);
+* ------------------------------------------------------
+* This function reads only the file and info headers of
+* a bitmap. It returns FAILURE if the file cannot be read
+* or is not a bitmap.
+*/
+int readBitmapHeader(char* fileName, BITMAPFILEHEADER* pFileHdr, BITMAPINFOHEADER* pFileInfo);
+
+/*
+* Function: runPipeline
+* Usage: runPipeline(gCoverPathFileName, gOutputFileName, msgPixelData, msgBits, extractBits, gKey, gAction, &request);
+* ------------------------------------------------------
+* This function hides or extracts with the image streamed
+* band by band from inputFileName. When hiding, the stego
+* image is written to outputFileName as the bands finish.
+* When extracting, outputFileName is not used and the bits
+* are left in extractedBits. If request is stopped the
+* stages wind down at the next band, nothing is written
+* and FAILURE is returned.
+*/
+int runPipeline(char* inputFileName, char* outputFileName, unsigned char* msgPixelData, unsigned int msgBits,
+    unsigned char* extractedBits, int gKey, int action, requestContext* request);
+
+/*
+* Function: runStreamExtract
+* Usage: runStreamExtract(gStegoPathFileName, extractBits, gKey, &request);
+* ------------------------------------------------------
+* This function extracts gKey bits reading the stego file
+* one row of blocks at a time. Rows of blocks are stored
+* bottom up, the order they are visited in, so reading
+* stops as soon as the last bit of the key is recovered
+* and the rest of the file is never read. A file name of
+* "-" reads the stego image from standard input. With
+* -rect only the rows of the rectangle are used, a
+* top-down file is read whole and viewed from its end.
+* request is looked at before every row of blocks, and
+* FAILURE returned once it is stopped.
+*/
+int runStreamExtract(char* stegoFileName, unsigned char* extractedBits, int gKey, requestContext* request);
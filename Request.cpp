@@ -0,0 +1,86 @@
+// BDPP Request
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Deadlines, cancellation and progress for one hide or extract, see
+// Request.h. Everything another thread may touch is read and written with
+// interlocked operations; the deadline is only looked at by the thread doing
+// the work, so a request that stopped stays stopped for the same reason.
+//
+
+#include "BitmapReader.h"
+#include "Request.h"
+
+void initRequest(requestContext* request, unsigned int timeoutMs)
+{
+	request->deadline = timeoutMs > 0 ? GetTickCount64() + timeoutMs : 0;
+	request->token = 0;
+	request->done = 0;
+	request->total = 0;
+	request->cancel = &request->token;
+	request->bandsDone = &request->done;
+	request->bandsTotal = &request->total;
+	request->stopReason = REQUEST_RUNNING;
+	return;
+} // initRequest
+
+void cancelRequest(requestContext* request)
+{
+	InterlockedExchange(request->cancel, 1);
+	return;
+} // cancelRequest
+
+int isRequestStopped(requestContext* request)
+{
+	if (request == NULL) return 0;
+	if (request->stopReason != REQUEST_RUNNING) return 1;
+
+	if (InterlockedCompareExchange(request->cancel, 0, 0) != 0)
+	{
+		request->stopReason = REQUEST_CANCELLED;
+	}
+	else if (request->deadline != 0 && GetTickCount64() >= request->deadline)
+	{
+		request->stopReason = REQUEST_TIMED_OUT;
+	}
+	return request->stopReason != REQUEST_RUNNING;
+} // isRequestStopped
+
+void failRequest(requestContext* request)
+{
+	if (request != NULL && request->stopReason == REQUEST_RUNNING) request->stopReason = REQUEST_FAILED;
+	return;
+} // failRequest
+
+void setRequestBands(requestContext* request, int bandsTotal)
+{
+	if (request == NULL) return;
+	InterlockedExchange(request->bandsDone, 0);
+	InterlockedExchange(request->bandsTotal, bandsTotal);
+	return;
+} // setRequestBands
+
+void finishRequestBands(requestContext* request, int bands)
+{
+	// only the thread doing the work counts bands, so the read and the write need not be one operation
+	if (request == NULL) return;
+	InterlockedExchange(request->bandsDone, *request->bandsDone + bands);
+	return;
+} // finishRequestBands
+
+void getRequestProgress(requestContext* request, int* bandsDone, int* bandsTotal)
+{
+	*bandsDone = (int)InterlockedCompareExchange(request->bandsDone, 0, 0);
+	*bandsTotal = (int)InterlockedCompareExchange(request->bandsTotal, 0, 0);
+	return;
+} // getRequestProgress
+
+int reportRequestStop(requestContext* request, const char* what)
+{
+	int bandsDone, bandsTotal;
+
+	if (request->stopReason != REQUEST_CANCELLED && request->stopReason != REQUEST_TIMED_OUT) return 0;
+	getRequestProgress(request, &bandsDone, &bandsTotal);
+	printf("Error - the %s %s after %d of %d bands, nothing was written.\n\n", what,
+		request->stopReason == REQUEST_CANCELLED ? "was cancelled" : "timed out", bandsDone, bandsTotal);
+	return 1;
+} // reportRequestStop
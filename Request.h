@@ -0,0 +1,124 @@
+// BDPP Request Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Deadlines, cancellation and progress for one hide or extract. The band
+// loops are handed a request context and look at it before every band: once
+// its deadline has passed or its cancellation token is set they stop, release
+// what they hold and return FAILURE, and the context keeps why. The bands done
+// and the bands in all can be read from another thread, or another process
+// when they are moved into a request ring slot, while the request runs.
+//
+
+#pragma once
+
+#include <windows.h>
+
+// why a request stopped before its last band
+#define REQUEST_RUNNING			0	// still running, or ran to the end
+#define REQUEST_CANCELLED		1	// its cancellation token was set
+#define REQUEST_TIMED_OUT		2	// its deadline passed
+#define REQUEST_FAILED			3	// an error, reported where it happened
+
+#define REQUEST_CHECK_BLOCKS	65536	// blocks between looks at the request where a band is the whole image
+
+/*
+* Structure: requestContext
+* Usage: requestContext request; initRequest(&request, gDeadlineMilliseconds);
+* ------------------------------------------------------
+* This structure is one request's deadline, cancellation
+* token and progress. cancel, bandsDone and bandsTotal
+* point into the structure itself after initRequest, a
+* server may point them at shared memory instead, so the
+* structure is not copied once it is set up.
+*/
+struct requestContext
+{
+    ULONGLONG deadline;           // GetTickCount64 time the request must be done by, 0 for none
+    volatile LONG* cancel;        // cancellation token, nonzero once the request is cancelled
+    volatile LONG* bandsDone;     // bands processed so far
+    volatile LONG* bandsTotal;    // bands in the request, 0 until they are known
+    int stopReason;               // REQUEST_RUNNING ... REQUEST_FAILED
+    volatile LONG token;          // what the pointers point to unless they are moved
+    volatile LONG done;
+    volatile LONG total;
+};  // requestContext
+
+/*
+* Function: initRequest
+* Usage: initRequest(&request, gDeadlineMilliseconds);
+* ------------------------------------------------------
+* This function starts a request that must be done
+* within timeoutMs milliseconds from now, or any time if
+* timeoutMs is 0, with its own cancellation token.
+*/
+void initRequest(requestContext* request, unsigned int timeoutMs);
+
+/*
+* Function: cancelRequest
+* Usage: cancelRequest(&request);
+* ------------------------------------------------------
+* This function sets the cancellation token of a
+* request. It can be called from any thread, the request
+* stops before its next band.
+*/
+void cancelRequest(requestContext* request);
+
+/*
+* Function: isRequestStopped
+* Usage: if (isRequestStopped(state->request)) ...
+* ------------------------------------------------------
+* This function returns 1 if the request has been
+* cancelled, has run past its deadline or has failed,
+* and records why. A NULL request never stops.
+*/
+int isRequestStopped(requestContext* request);
+
+/*
+* Function: failRequest
+* Usage: failRequest(state->request);
+* ------------------------------------------------------
+* This function marks a request as stopped by an error,
+* unless it already stopped for another reason. A NULL
+* request is left alone.
+*/
+void failRequest(requestContext* request);
+
+/*
+* Function: setRequestBands
+* Usage: setRequestBands(state->request, numBands);
+* ------------------------------------------------------
+* This function sets the bands a request is made of and
+* clears the bands done. Accepts a NULL request.
+*/
+void setRequestBands(requestContext* request, int bandsTotal);
+
+/*
+* Function: finishRequestBands
+* Usage: finishRequestBands(state->request, 1);
+* ------------------------------------------------------
+* This function adds bands to the bands done of a
+* request. Only the thread doing the work calls it.
+* Accepts a NULL request.
+*/
+void finishRequestBands(requestContext* request, int bands);
+
+/*
+* Function: getRequestProgress
+* Usage: getRequestProgress(&request, &bandsDone, &bandsTotal);
+* ------------------------------------------------------
+* This function reads how many of the bands of a request
+* are done. It can be called from any thread.
+*/
+void getRequestProgress(requestContext* request, int* bandsDone, int* bandsTotal);
+
+/*
+* Function: reportRequestStop
+* Usage: if (reportRequestStop(&request, "hide")) ...
+* ------------------------------------------------------
+* This function prints why a request that was cancelled
+* or timed out stopped and how far it got, and returns 1.
+* It prints nothing and returns 0 for a request that ran
+* to the end or failed, errors are printed where they
+* happen.
+*/
+int reportRequestStop(requestContext* request, const char* what);
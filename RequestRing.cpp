@@ -0,0 +1,225 @@
+// BDPP Request Ring
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Creates and connects to the shared memory request rings of -serve. The
+// caller side of this file is the whole client library, it only needs
+// RequestRing.h and the Windows API.
+//
+
+#include "BitmapReader.h"
+#include "RequestRing.h"
+
+#define RING_NAME_PREFIX	"Local\\BDPP_"
+#define RING_DATA_ALIGN		4096	// the slot data starts on its own page
+
+// bytes before the first slot data area
+static size_t ringDataOffset(int slotCount)
+{
+	size_t headerBytes = sizeof(ringHeader) + sizeof(ringSlot) * slotCount;
+	return (headerBytes + RING_DATA_ALIGN - 1) & ~(size_t)(RING_DATA_ALIGN - 1);
+} // ringDataOffset
+
+// creates or opens the request event and the done event of every slot
+static int openRingEvents(requestRing* ring, const char* ringName, int create)
+{
+	char eventName[MAX_PATH];
+
+	snprintf(eventName, MAX_PATH, "%s%s_request", RING_NAME_PREFIX, ringName);
+	ring->requestEvent = create ? CreateEventA(NULL, FALSE, FALSE, eventName)
+		: OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, eventName);
+	if (ring->requestEvent == NULL) return FAILURE;
+
+	for (DWORD i = 0; i < ring->header->slotCount; i++)
+	{
+		snprintf(eventName, MAX_PATH, "%s%s_done%u", RING_NAME_PREFIX, ringName, (unsigned int)i);
+		ring->doneEvents[i] = create ? CreateEventA(NULL, FALSE, FALSE, eventName)
+			: OpenEventA(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, eventName);
+		if (ring->doneEvents[i] == NULL) return FAILURE;
+	}
+	return SUCCESS;
+} // openRingEvents
+
+// points the ring at the header, slots and data of its view
+static void layoutRing(requestRing* ring)
+{
+	ring->header = (ringHeader*)ring->view;
+	ring->slots = (ringSlot*)(ring->view + sizeof(ringHeader));
+	ring->data = ring->view + ringDataOffset(ring->header->slotCount);
+} // layoutRing
+
+int ringCreate(requestRing* ring, const char* ringName, int slotCount, unsigned int slotSize, int bitsPerBlock)
+{
+	char mappingName[MAX_PATH];
+	unsigned long long mappingSize = ringDataOffset(slotCount) + (unsigned long long)slotSize * slotCount;
+
+	memset(ring, 0, sizeof(requestRing));
+	snprintf(mappingName, MAX_PATH, "%s%s", RING_NAME_PREFIX, ringName);
+	ring->hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)(mappingSize >> 32), (DWORD)mappingSize, mappingName);
+	if (ring->hMapping == NULL || GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		printf("Error - could not create request ring %s, it may already be served.\n\n", ringName);
+		ringClose(ring);
+		return FAILURE;
+	}
+	ring->view = (unsigned char*)MapViewOfFile(ring->hMapping, FILE_MAP_ALL_ACCESS, 0, 0, (size_t)mappingSize);
+	if (ring->view == NULL)
+	{
+		printf("Error - could not map %llu bytes for request ring %s.\n\n", mappingSize, ringName);
+		ringClose(ring);
+		return FAILURE;
+	}
+
+	// a new mapping is zero filled, so every slot starts out free
+	ring->header = (ringHeader*)ring->view;
+	ring->header->slotCount = slotCount;
+	ring->header->slotSize = slotSize;
+	ring->header->bitsPerBlock = bitsPerBlock;
+	ring->header->shutdown = 0;
+	layoutRing(ring);
+	if (openRingEvents(ring, ringName, 1) != SUCCESS)
+	{
+		printf("Error - could not create the events of request ring %s.\n\n", ringName);
+		ringClose(ring);
+		return FAILURE;
+	}
+
+	// callers check the magic last, once everything else is in place
+	ring->header->version = RING_VERSION;
+	InterlockedExchange((volatile LONG*)&ring->header->magic, RING_MAGIC);
+	return SUCCESS;
+} // ringCreate
+
+int ringConnect(requestRing* ring, const char* ringName)
+{
+	char mappingName[MAX_PATH];
+
+	memset(ring, 0, sizeof(requestRing));
+	snprintf(mappingName, MAX_PATH, "%s%s", RING_NAME_PREFIX, ringName);
+	ring->hMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName);
+	if (ring->hMapping == NULL)
+	{
+		printf("Error - request ring %s is not being served.\n\n", ringName);
+		return FAILURE;
+	}
+	ring->view = (unsigned char*)MapViewOfFile(ring->hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	if (ring->view == NULL)
+	{
+		printf("Error - could not map request ring %s.\n\n", ringName);
+		ringClose(ring);
+		return FAILURE;
+	}
+
+	ring->header = (ringHeader*)ring->view;
+	if (ring->header->magic != RING_MAGIC || ring->header->version != RING_VERSION
+		|| ring->header->slotCount < 1 || ring->header->slotCount > RING_MAX_SLOTS)
+	{
+		printf("Error - request ring %s is not ready or was made by another version.\n\n", ringName);
+		ringClose(ring);
+		return FAILURE;
+	}
+	layoutRing(ring);
+	if (openRingEvents(ring, ringName, 0) != SUCCESS)
+	{
+		printf("Error - could not open the events of request ring %s.\n\n", ringName);
+		ringClose(ring);
+		return FAILURE;
+	}
+	return SUCCESS;
+} // ringConnect
+
+int ringAcquireSlot(requestRing* ring)
+{
+	for (DWORD i = 0; i < ring->header->slotCount; i++)
+	{
+		if (InterlockedCompareExchange(&ring->slots[i].state, RING_SLOT_CLAIMED, RING_SLOT_FREE) == RING_SLOT_FREE)
+		{
+			InterlockedExchange(&ring->slots[i].cancel, 0);
+			ring->slots[i].deadlineMs = 0;
+			return (int)i;
+		}
+	}
+	return -1;
+} // ringAcquireSlot
+
+ringSlot* ringSlotHeader(requestRing* ring, int slotIndex)
+{
+	return &ring->slots[slotIndex];
+} // ringSlotHeader
+
+unsigned char* ringSlotData(requestRing* ring, int slotIndex)
+{
+	return ring->data + (size_t)slotIndex * ring->header->slotSize;
+} // ringSlotData
+
+int ringSubmit(requestRing* ring, int slotIndex, DWORD timeoutMs)
+{
+	ringSlot* slot = &ring->slots[slotIndex];
+
+	// a cancel left over from an earlier submit only stops that one, the server cannot see a claimed slot
+	if (slot->state == RING_SLOT_CLAIMED) InterlockedExchange(&slot->cancel, 0);
+	if (InterlockedCompareExchange(&slot->state, RING_SLOT_SUBMITTED, RING_SLOT_CLAIMED) != RING_SLOT_CLAIMED)
+	{
+		printf("Error - slot %d was not claimed before it was submitted.\n\n", slotIndex);
+		return FAILURE;
+	}
+	SetEvent(ring->requestEvent);
+
+	// the done event may still be set by a request that timed out earlier, so the state decides
+	while (slot->state != RING_SLOT_DONE)
+	{
+		if (WaitForSingleObject(ring->doneEvents[slotIndex], timeoutMs) != WAIT_OBJECT_0)
+		{
+			// take the request back if the server never picked it up, or stop it if it did and wait
+			// for the server to let go of the slot, it stops at the next band
+			if (InterlockedCompareExchange(&slot->state, RING_SLOT_CLAIMED, RING_SLOT_SUBMITTED) != RING_SLOT_SUBMITTED)
+			{
+				InterlockedExchange(&slot->cancel, 1);
+				while (slot->state != RING_SLOT_DONE)
+				{
+					WaitForSingleObject(ring->doneEvents[slotIndex], INFINITE);
+				}
+				InterlockedExchange(&slot->state, RING_SLOT_CLAIMED);
+			}
+			printf("Error - the server did not answer within %u ms.\n\n", (unsigned int)timeoutMs);
+			return FAILURE;
+		}
+	}
+	InterlockedExchange(&slot->state, RING_SLOT_CLAIMED);
+	return slot->status;
+} // ringSubmit
+
+void ringCancel(requestRing* ring, int slotIndex)
+{
+	InterlockedExchange(&ring->slots[slotIndex].cancel, 1);
+	return;
+} // ringCancel
+
+int ringReleaseSlot(requestRing* ring, int slotIndex)
+{
+	// a slot the server still owns is never freed, another caller could claim it in the middle of the request
+	volatile LONG* state = &ring->slots[slotIndex].state;
+	if (InterlockedCompareExchange(state, RING_SLOT_FREE, RING_SLOT_CLAIMED) != RING_SLOT_CLAIMED
+		&& InterlockedCompareExchange(state, RING_SLOT_FREE, RING_SLOT_DONE) != RING_SLOT_DONE)
+	{
+		printf("Error - slot %d is still in the hands of the server and cannot be released.\n\n", slotIndex);
+		return FAILURE;
+	}
+	return SUCCESS;
+} // ringReleaseSlot
+
+void ringClose(requestRing* ring)
+{
+	for (int i = 0; i < RING_MAX_SLOTS; i++)
+	{
+		if (ring->doneEvents[i] != NULL) CloseHandle(ring->doneEvents[i]);
+		ring->doneEvents[i] = NULL;
+	}
+	if (ring->requestEvent != NULL) CloseHandle(ring->requestEvent);
+	if (ring->view != NULL) UnmapViewOfFile(ring->view);
+	if (ring->hMapping != NULL) CloseHandle(ring->hMapping);
+	ring->requestEvent = NULL;
+	ring->view = NULL;
+	ring->hMapping = NULL;
+	return;
+} // ringClose
@@ -0,0 +1,218 @@
+// BDPP Request Ring Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Shared memory interface for callers on the same machine that already hold
+// decoded cover pixels. The ring is a named file mapping with a header and a
+// fixed number of request slots; a caller writes the pixels and the message
+// straight into a slot, the BDPP server (-serve) hides or extracts in place
+// in the slot and signals the slot's event. No file is read or written and
+// the pixels are never copied on the way in or out.
+//
+// A slot moves FREE -> CLAIMED (a caller is filling it) -> SUBMITTED ->
+// BUSY (the server is working on it) -> DONE -> FREE, every change is an
+// interlocked exchange on the slot state.
+//
+
+#pragma once
+
+#include <windows.h>
+#include "Lanes.h"
+
+#define RING_MAGIC				0x50504442	// "BDPP"
+#define RING_VERSION			3
+#define RING_MAX_SLOTS			64
+#define RING_DEFAULT_SLOTS		4
+#define RING_DEFAULT_SLOT_MB	16			// data bytes per slot, in megabytes
+#define RING_WAIT_TIMEOUT		30000		// milliseconds a caller waits for the server
+
+#define RING_SLOT_FREE			0
+#define RING_SLOT_CLAIMED		1
+#define RING_SLOT_SUBMITTED		2
+#define RING_SLOT_BUSY			3
+#define RING_SLOT_DONE			4
+
+#define RING_ACTION_SHUTDOWN	9			// asks the server to stop, besides ACTION_HIDE and ACTION_EXTRACT
+
+/*
+* Structure: ringHeader
+* Usage: ringHeader* header = ring->header;
+* ------------------------------------------------------
+* This structure starts the mapping. It describes the
+* slots so a caller can check it was built by the same
+* version of the program, and holds the latency of the
+* requests served in each lane so far. The server
+* updates a lane's histogram as a request of it is done,
+* a caller reading it meanwhile may see a count a
+* request behind the others.
+*/
+struct ringHeader
+{
+    DWORD magic;
+    DWORD version;
+    DWORD slotCount;
+    DWORD slotSize;                  // data bytes of each slot
+    DWORD bitsPerBlock;              // the server's -b, requests are hidden and extracted with it
+    volatile LONG shutdown;          // set to 1 when the server stops
+    DWORD padding[10];
+    laneHistogram lanes[LANE_COUNT]; // LANE_LATENCY and LANE_THROUGHPUT
+};  // ringHeader
+
+/*
+* Structure: ringSlot
+* Usage: ringSlot* slot = ringSlotHeader(&ring, slotIndex);
+* ------------------------------------------------------
+* This structure is one request. The caller fills the
+* fields above status and the slot data, the server the
+* fields from status down. A caller may set cancel at any
+* time to stop a request the server is working on, it is
+* looked at between bands as bandsDone is counted. The
+* pixels start at offset 0
+* of the slot data, bottom row first as in a bitmap file,
+* one bit per pixel and ringRowSize(width) bytes per row.
+* The message to hide is packed most significant bit
+* first at messageOffset; an extract writes one byte per
+* extracted bit there instead.
+*/
+struct ringSlot
+{
+    volatile LONG state;             // RING_SLOT_FREE ... RING_SLOT_DONE
+    int action;                      // ACTION_HIDE, ACTION_EXTRACT or RING_ACTION_SHUTDOWN
+    int width;                       // image size in pixels
+    int height;
+    unsigned int messageOffset;      // slot data offset of the message or extracted bits
+    unsigned int messageBits;        // bits to hide, or the key when extracting
+    int status;                      // SUCCESS or FAILURE
+    int key;                         // bits hidden or extracted
+    int embeddableBlocks;            // embeddable blocks classified to serve the request
+    int blocksClassified;
+    unsigned long long sequence;     // requests served by the ring, set when the request completes
+    volatile LONG cancel;            // set to 1 by the caller to stop the request
+    unsigned int deadlineMs;         // milliseconds the request may run, 0 for the server's -deadline
+    volatile LONG bandsDone;         // progress of the request, bands of rows of blocks finished
+    volatile LONG bandsTotal;
+    int stopReason;                  // REQUEST_RUNNING, or why the request was stopped
+    DWORD padding[3];
+};  // ringSlot
+
+/*
+* Structure: requestRing
+* Usage: requestRing ring; ringConnect(&ring, ringName);
+* ------------------------------------------------------
+* This structure is one process's view of a ring: the
+* mapping and the events. The server that creates the
+* ring and the callers that connect to it use the same
+* structure.
+*/
+struct requestRing
+{
+    HANDLE hMapping;
+    unsigned char* view;
+    ringHeader* header;
+    ringSlot* slots;
+    unsigned char* data;             // slot data areas, slotSize bytes each
+    HANDLE requestEvent;             // set by callers when a slot is submitted
+    HANDLE doneEvents[RING_MAX_SLOTS];  // set by the server when a slot is done
+};  // requestRing
+
+/*
+* Function: ringRowSize
+* Usage: rowSize = ringRowSize(width);
+* ------------------------------------------------------
+* This function returns the bytes per pixel row of a
+* slot image, padded to 4 bytes as in a bitmap file.
+*/
+static inline size_t ringRowSize(int width)
+{
+    return ((width + 7) / 8 + 3) & ~3;
+}
+
+/*
+* Function: ringCreate
+* Usage: if (ringCreate(&ring, ringName, slotCount, slotSize, bitsPerBlock) != SUCCESS) ...
+* ------------------------------------------------------
+* This function creates the named mapping and events of
+* a new ring with every slot free. It fails if a ring of
+* that name already exists.
+*/
+int ringCreate(requestRing* ring, const char* ringName, int slotCount, unsigned int slotSize, int bitsPerBlock);
+
+/*
+* Function: ringConnect
+* Usage: if (ringConnect(&ring, ringName) != SUCCESS) ...
+* ------------------------------------------------------
+* This function maps an existing ring and opens its
+* events. It fails if no server has created the ring or
+* the server is another version.
+*/
+int ringConnect(requestRing* ring, const char* ringName);
+
+/*
+* Function: ringAcquireSlot
+* Usage: slotIndex = ringAcquireSlot(&ring);
+* ------------------------------------------------------
+* This function claims a free slot and returns its
+* index, or -1 if every slot is in use. The slot starts
+* with no deadline of its own and not cancelled.
+*/
+int ringAcquireSlot(requestRing* ring);
+
+/*
+* Function: ringSlotHeader
+* Usage: ringSlot* slot = ringSlotHeader(&ring, slotIndex);
+* ------------------------------------------------------
+* This function returns the request fields of a slot.
+*/
+ringSlot* ringSlotHeader(requestRing* ring, int slotIndex);
+
+/*
+* Function: ringSlotData
+* Usage: unsigned char* pixels = ringSlotData(&ring, slotIndex);
+* ------------------------------------------------------
+* This function returns the data area of a slot, where
+* the caller decodes its image and places its message.
+*/
+unsigned char* ringSlotData(requestRing* ring, int slotIndex);
+
+/*
+* Function: ringSubmit
+* Usage: status = ringSubmit(&ring, slotIndex, RING_WAIT_TIMEOUT);
+* ------------------------------------------------------
+* This function hands a claimed slot to the server and
+* waits for it to be done. It returns the status of the
+* request, or FAILURE if the server did not answer in
+* timeoutMs milliseconds, in which case a request the
+* server is already working on is cancelled and waited
+* for until the server stops it at its next band. The
+* slot stays claimed so the caller can read the results
+* or submit it again.
+*/
+int ringSubmit(requestRing* ring, int slotIndex, DWORD timeoutMs);
+
+/*
+* Function: ringCancel
+* Usage: ringCancel(&ring, slotIndex);
+* ------------------------------------------------------
+* This function asks the server to stop the request in
+* a slot, from any thread. The server gives up at the
+* next band and sets the slot's stopReason.
+*/
+void ringCancel(requestRing* ring, int slotIndex);
+
+/*
+* Function: ringReleaseSlot
+* Usage: ringReleaseSlot(&ring, slotIndex);
+* ------------------------------------------------------
+* This function returns a claimed or done slot to the
+* free slots. Returns FAILURE, leaving the slot as it is,
+* if the slot is submitted or the server is working on
+* it.
+*/
+int ringReleaseSlot(requestRing* ring, int slotIndex);
+
+/*
+* Function: ringClose
+* Usage: ringClose(&ring);
+* ------------------------------------------------------
+* This function unmaps the ring and closes its events.
+*/
+void ringClose(requestRing* ring);
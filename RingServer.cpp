@@ -0,0 +1,179 @@
+// BDPP Request Ring Server
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// -serve: waits on the ring's request event and runs every submitted slot
+// through the same band code as a hide or extract of a file, with the slot
+// data as the pixel data. Requests are ordered by size in the lanes of
+// Lanes.h. Nothing is printed per request, callers read the outcome from
+// the slot.
+//
+
+#include "BitmapReader.h"
+#include "RingServer.h"
+#include "Trace.h"
+#include "MemStats.h"
+#include "Lanes.h"
+#include <climits>
+
+// a request taken from its slot and not yet handed back, with its bands so far
+struct ringWork
+{
+	LARGE_INTEGER arrival;        // when the server took the request
+	requestContext request;       // points at the slot's cancel flag and progress counters
+	pixelWork work;
+};  // ringWork
+
+// checks one submitted slot and sets up its hide or extract in place, returns FAILURE if it cannot be served
+static int startRingRequest(requestRing* ring, int slotIndex, ringWork* served)
+{
+	ringSlot* slot = ringSlotHeader(ring, slotIndex);
+	unsigned char* data = ringSlotData(ring, slotIndex);
+	imageView image;
+
+	slot->status = FAILURE;
+	slot->key = 0;
+	slot->embeddableBlocks = 0;
+	slot->blocksClassified = 0;
+	slot->stopReason = REQUEST_FAILED;
+	if ((slot->action != ACTION_HIDE && slot->action != ACTION_EXTRACT) || slot->width < 3 || slot->height < 3)
+	{
+		return FAILURE;
+	}
+
+	// the pixels and the message or extracted bits must fit in the slot without overlapping
+	unsigned long long pixelBytes = (unsigned long long)ringRowSize(slot->width) * slot->height;
+	unsigned long long messageBytes = slot->action == ACTION_HIDE ? (slot->messageBits + 7ULL) / 8 : slot->messageBits;
+	if (pixelBytes > slot->messageOffset || slot->messageOffset + messageBytes > ring->header->slotSize)
+	{
+		return FAILURE;
+	}
+
+	// the caller's cancel flag and the progress counters are the slot's own, so they can be read and set
+	// from the caller's process while the bands run
+	initRequest(&served->request, slot->deadlineMs != 0 ? slot->deadlineMs : gDeadlineMilliseconds);
+	served->request.cancel = &slot->cancel;
+	served->request.bandsDone = &slot->bandsDone;
+	served->request.bandsTotal = &slot->bandsTotal;
+
+	initRowsView(&image, data, ringRowSize(slot->width), slot->width, slot->height, 1);
+	if (slot->action == ACTION_HIDE)
+	{
+		return startPixelData(&served->work, &image, data + slot->messageOffset, slot->messageBits, NULL, 0, ACTION_HIDE,
+			&served->request);
+	}
+	return startPixelData(&served->work, &image, NULL, 0, data + slot->messageOffset, slot->messageBits, ACTION_EXTRACT,
+		&served->request);
+} // startRingRequest
+
+// fills in the results of a request whose bands are done or that was stopped
+static void finishRingRequest(requestRing* ring, int slotIndex, ringWork* served, int status)
+{
+	ringSlot* slot = ringSlotHeader(ring, slotIndex);
+	bandState* state = &served->work.state;
+
+	releasePixelData(&served->work);
+	slot->stopReason = status == SUCCESS ? REQUEST_RUNNING : served->request.stopReason;
+	if (status != SUCCESS)
+	{
+		return;
+	}
+
+	// a permuted order is derived from the whole message size, so the bits of a message that did not fit
+	// cannot be extracted with any key
+	slot->key = state->action == ACTION_HIDE && state->permuted && state->bitIndex < slot->messageBits ? 0 : state->bitIndex;
+	slot->embeddableBlocks = state->embeddableBlocks;
+	slot->blocksClassified = state->blocksClassified;
+	if (state->bitIndex >= slot->messageBits && state->verifyFailures == 0) slot->status = SUCCESS;
+	return;
+} // finishRingRequest
+
+// hands a slot back to its caller
+static void completeSlot(requestRing* ring, int slotIndex, unsigned long long sequence)
+{
+	ringSlot* slot = ringSlotHeader(ring, slotIndex);
+	slot->sequence = sequence;
+	InterlockedExchange(&slot->state, RING_SLOT_DONE);
+	SetEvent(ring->doneEvents[slotIndex]);
+	return;
+} // completeSlot
+
+int runRingServer(char* ringName, int slotCount, int slotMegabytes, int bitsPerBlock)
+{
+	requestRing ring;
+	laneScheduler lanes;
+	ringWork* works;
+	unsigned long long served = 0, failed = 0;
+
+	if (ringCreate(&ring, ringName, slotCount, (unsigned int)slotMegabytes << 20, bitsPerBlock) != SUCCESS)
+	{
+		return FAILURE;
+	}
+	works = (ringWork*)trackedCalloc(slotCount, sizeof(ringWork), MEM_SITE_BOOKKEEPING);
+	if (works == NULL || initLanes(&lanes, slotCount, (unsigned long long)gLaneMegapixels * 1000000, gLaneBurst) != SUCCESS)
+	{
+		printf("Error - Could not allocate the request state of %d slots.\n\n", slotCount);
+		trackedFree(works);
+		ringClose(&ring);
+		return FAILURE;
+	}
+	printf("Serving request ring %s: %d slots of %d MB, %d bits per block\n", ringName, slotCount, slotMegabytes, bitsPerBlock);
+
+	// requests already taken are finished before the server stops
+	while (!ring.header->shutdown || lanes.count[LANE_LATENCY] + lanes.count[LANE_THROUGHPUT] > 0)
+	{
+		// one signal may stand for several submitted slots, so every slot is looked at, and with requests
+		// waiting in the lanes new ones are only looked for between bands
+		int waiting = lanes.count[LANE_LATENCY] + lanes.count[LANE_THROUGHPUT];
+		traceBegin(TRACE_WAIT, TRACE_NO_ID, TRACE_NO_ID);
+		WaitForSingleObject(ring.requestEvent, waiting > 0 ? 0 : INFINITE);
+		traceEnd(TRACE_WAIT, TRACE_NO_ID, TRACE_NO_ID);
+		for (int i = 0; i < slotCount; i++)
+		{
+			ringSlot* slot = ringSlotHeader(&ring, i);
+			if (InterlockedCompareExchange(&slot->state, RING_SLOT_BUSY, RING_SLOT_SUBMITTED) != RING_SLOT_SUBMITTED)
+			{
+				continue;
+			}
+
+			if (slot->action == RING_ACTION_SHUTDOWN)
+			{
+				ring.header->shutdown = 1;
+				slot->status = SUCCESS;
+				completeSlot(&ring, i, served);
+			}
+			else if (startRingRequest(&ring, i, &works[i]) != SUCCESS)
+			{
+				served++;
+				failed++;
+				completeSlot(&ring, i, served);
+			}
+			else
+			{
+				QueryPerformanceCounter(&works[i].arrival);
+				pushLaneJob(&lanes, i, estimateJobCost(slot->width, slot->height, slot->messageBits));
+			}
+		}
+
+		// small requests run whole, the large one at the head of the throughput lane a band at a time in between
+		int lane = nextLane(&lanes);
+		if (lane < 0) continue;
+		int slotIndex = peekLaneJob(&lanes, lane);
+		ringWork* work = &works[slotIndex];
+		int status = continuePixelData(&work->work, lane == LANE_LATENCY ? INT_MAX : 1);
+		if (status == SUCCESS && !isPixelDataDone(&work->work)) continue;
+
+		finishRingRequest(&ring, slotIndex, work, status);
+		popLaneJob(&lanes, lane, work->arrival);
+		ring.header->lanes[lane] = lanes.histograms[lane];
+		served++;
+		if (ringSlotHeader(&ring, slotIndex)->status != SUCCESS) failed++;
+		completeSlot(&ring, slotIndex, served);
+	}
+
+	printf("Request ring %s stopped: %llu requests served, %llu failed\n", ringName, served, failed);
+	printLaneHistograms(stdout, lanes.histograms);
+	freeLanes(&lanes);
+	trackedFree(works);
+	ringClose(&ring);
+	return SUCCESS;
+} // runRingServer
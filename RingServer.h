@@ -0,0 +1,22 @@
+// BDPP Request Ring Server Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Serves hide and extract requests that callers on the same machine place in
+// a shared memory request ring (RequestRing.h).
+//
+
+#pragma once
+
+#include "RequestRing.h"
+
+/*
+* Function: runRingServer
+* Usage: runRingServer(gRingName, gRingSlots, gRingSlotMegabytes, gNumBits2Hide);
+* ------------------------------------------------------
+* This function creates a request ring of slotCount
+* slots of slotMegabytes each and hides or extracts in
+* place in every slot a caller submits, with
+* bitsPerBlock bits per block, until a caller asks it
+* to stop.
+*/
+int runRingServer(char* ringName, int slotCount, int slotMegabytes, int bitsPerBlock);
@@ -0,0 +1,59 @@
+// Single Producer Single Consumer Queue Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Bounded lock-free queue used to hand row bands from one pipeline stage
+// to the next. Exactly one thread may push and exactly one thread may pop.
+//
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <stddef.h>
+
+/*
+* Structure: spscQueue
+* Usage: spscQueue<pixelBand*, 8> readQueue;
+* ------------------------------------------------------
+* This structure is a fixed size ring buffer. The head
+* is only written by the consumer and the tail only by
+* the producer, so no locks are needed. push and pop
+* yield the thread while the queue is full or empty.
+*/
+template <typename T, size_t Capacity>
+struct spscQueue
+{
+    T items[Capacity];
+    alignas(64) std::atomic<size_t> head{ 0 };  // next item to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail{ 0 };  // next free slot, written by the producer
+
+    bool tryPush(T item)
+    {
+        size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - head.load(std::memory_order_acquire) == Capacity) return false;
+        items[currentTail % Capacity] = item;
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T* item)
+    {
+        size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == tail.load(std::memory_order_acquire)) return false;
+        *item = items[currentHead % Capacity];
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T item)
+    {
+        while (!tryPush(item)) std::this_thread::yield();
+    }
+
+    T pop()
+    {
+        T item;
+        while (!tryPop(&item)) std::this_thread::yield();
+        return item;
+    }
+};  // spscQueue
@@ -0,0 +1,596 @@
+// BDPP Scheduler
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Places a queue of messages on a pool of covers. The hiding capacity of every
+// cover is kept in a catalogue file, so a cover is only classified again when
+// its size, its write time or the bits per block change. The messages are
+// packed onto the covers best fit decreasing: the largest message first, each
+// one into the open cover it fills the most, and a new cover is only opened
+// when none of the open ones has room. The hides for the chosen covers then run on several
+// threads, each cover is read once and written once whatever it carries.
+//
+
+#include "BitmapReader.h"
+#include "Scheduler.h"
+#include "Capacity.h"
+#include "BitPlane.h"
+#include "MemStats.h"
+#include "Trace.h"
+#include "Durable.h"
+#include <thread>
+#include <atomic>
+
+// reads the size and last write time of a file, used to tell if a catalogue entry is still valid
+static int fileStamp(char* fileName, unsigned long long* fileSize, unsigned long long* writeTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (!GetFileAttributesExA(fileName, GetFileExInfoStandard, &attributes)) return FAILURE;
+	*fileSize = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	*writeTime = ((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32)
+		| attributes.ftLastWriteTime.dwLowDateTime;
+	return SUCCESS;
+} // fileStamp
+
+// grows an array read from a file by doubling, exits if memory runs out
+static void* growArray(void* array, int* capacity, size_t itemSize)
+{
+	*capacity = *capacity ? *capacity * 2 : 16;
+	array = trackedRealloc(array, itemSize * *capacity, MEM_SITE_BOOKKEEPING);
+	if (array == NULL)
+	{
+		printf("Error - Could not allocate memory for %d schedule entries.\n\n", *capacity);
+		exit(-1);
+	}
+	return array;
+} // growArray
+
+// reads the cover pool and the message queue from the schedule file
+// blank lines and lines starting with # are skipped
+static void readScheduleFile(char* scheduleFileName, scheduleCover** covers, int* numCovers,
+	scheduleMessage** messages, int* numMessages)
+{
+	FILE* ptrFile;
+	char line[2 * MAX_PATH + 64];
+	char kind[16], first[MAX_PATH], second[MAX_PATH];
+	int coverCapacity = 0, messageCapacity = 0, lineNumber = 0;
+
+	*covers = NULL;
+	*messages = NULL;
+	*numCovers = *numMessages = 0;
+	ptrFile = fopen(scheduleFileName, "r");
+	if (ptrFile == NULL)
+	{
+		printf("Error in opening file: %s.\n\n", scheduleFileName);
+		exit(-1);
+	}
+
+	while (fgets(line, sizeof(line), ptrFile) != NULL)
+	{
+		char* cursor = line;
+		lineNumber++;
+		if (!nextBatchToken(&cursor, kind, sizeof(kind)) || kind[0] == '#') continue;
+
+		if (_stricmp(kind, "cover") == 0)
+		{
+			if (!nextBatchToken(&cursor, first, MAX_PATH) || !nextBatchToken(&cursor, second, MAX_PATH))
+			{
+				printf("Error - schedule file line %d needs a cover file and a stego file.\n\n", lineNumber);
+				exit(-1);
+			}
+			if (*numCovers == coverCapacity)
+			{
+				*covers = (scheduleCover*)growArray(*covers, &coverCapacity, sizeof(scheduleCover));
+			}
+			scheduleCover* cover = &(*covers)[(*numCovers)++];
+			memset(cover, 0, sizeof(scheduleCover));
+			strcpy(cover->coverFile, first);
+			strcpy(cover->outputFile, second);
+			GetFullPathNameA(first, MAX_PATH, cover->fullPath, NULL);
+			cover->status = SUCCESS;
+		}
+		else if (_stricmp(kind, "message") == 0)
+		{
+			if (!nextBatchToken(&cursor, first, MAX_PATH))
+			{
+				printf("Error - schedule file line %d needs a message file.\n\n", lineNumber);
+				exit(-1);
+			}
+			if (*numMessages == messageCapacity)
+			{
+				*messages = (scheduleMessage*)growArray(*messages, &messageCapacity, sizeof(scheduleMessage));
+			}
+			scheduleMessage* message = &(*messages)[(*numMessages)++];
+			unsigned long long fileSize, writeTime;
+			memset(message, 0, sizeof(scheduleMessage));
+			strcpy(message->msgFile, first);
+			if (fileStamp(first, &fileSize, &writeTime) != SUCCESS || fileSize * 8 > 0x7FFFFFFFULL)
+			{
+				printf("Error - message file %s cannot be read or is too large.\n\n", first);
+				exit(-1);
+			}
+			message->bits = (unsigned int)(fileSize * 8);
+			message->cover = -1;
+		}
+		else
+		{
+			printf("Error - unknown entry <%s> on schedule file line %d.\n\n", kind, lineNumber);
+			exit(-1);
+		}
+	}
+	fclose(ptrFile);
+
+	// the covers are hidden in parallel and their stego files committed whenever the committer gets to
+	// them, so no stego file may be written twice or be read as another cover
+	for (int i = 0; i < *numCovers; i++)
+	{
+		for (int j = 0; j < *numCovers; j++)
+		{
+			if (j < i && _stricmp((*covers)[i].outputFile, (*covers)[j].outputFile) == 0)
+			{
+				printf("Error - stego file %s is written by two covers.\n\n", (*covers)[i].outputFile);
+				exit(-1);
+			}
+			if (_stricmp((*covers)[i].outputFile, (*covers)[j].coverFile) == 0)
+			{
+				printf("Error - stego file %s is also a cover of the schedule.\n\n", (*covers)[i].outputFile);
+				exit(-1);
+			}
+		}
+	}
+} // readScheduleFile
+
+// fills in the covers from the catalogue, an entry only counts if the file has not changed since
+// catalogue lines are: "full path" file size, write time, bits per block, capacity bits, total blocks, uses
+static void loadCatalogue(char* catalogueFileName, scheduleCover* covers, int numCovers, int bitsPerBlock)
+{
+	FILE* ptrFile;
+	char line[MAX_PATH + 128];
+	char path[MAX_PATH], value[32];
+
+	for (int i = 0; i < numCovers; i++)
+	{
+		if (fileStamp(covers[i].coverFile, &covers[i].fileSize, &covers[i].writeTime) != SUCCESS)
+		{
+			printf("Error in opening file: %s.\n\n", covers[i].coverFile);
+			exit(-1);
+		}
+	}
+
+	ptrFile = fopen(catalogueFileName, "r");
+	if (ptrFile == NULL) return;  // no catalogue yet, every cover gets classified
+
+	while (fgets(line, sizeof(line), ptrFile) != NULL)
+	{
+		char* cursor = line;
+		unsigned long long fields[6];
+		int numFields = 0;
+
+		if (!nextBatchToken(&cursor, path, MAX_PATH) || path[0] == '#') continue;
+		while (numFields < 6 && nextBatchToken(&cursor, value, sizeof(value)))
+		{
+			fields[numFields++] = strtoull(value, NULL, 10);
+		}
+		if (numFields < 6) continue;
+
+		for (int i = 0; i < numCovers; i++)
+		{
+			if (_stricmp(covers[i].fullPath, path) != 0) continue;
+			covers[i].uses = (int)fields[5];
+			if (covers[i].fileSize == fields[0] && covers[i].writeTime == fields[1] && fields[2] == (unsigned long long)bitsPerBlock)
+			{
+				covers[i].capacityBits = (int)fields[3];
+				covers[i].totalBlocks = (int)fields[4];
+				covers[i].catalogued = 1;
+			}
+		}
+	}
+	fclose(ptrFile);
+} // loadCatalogue
+
+// writes the catalogue back, entries for files that are not in this pool are kept as they were
+static void saveCatalogue(char* catalogueFileName, scheduleCover* covers, int numCovers, int bitsPerBlock)
+{
+	FILE* ptrFile;
+	char** keptLines = NULL;
+	int numKept = 0, keptCapacity = 0;
+	char line[MAX_PATH + 128];
+	char path[MAX_PATH];
+
+	ptrFile = fopen(catalogueFileName, "r");
+	if (ptrFile != NULL)
+	{
+		while (fgets(line, sizeof(line), ptrFile) != NULL)
+		{
+			char* cursor = line;
+			int inPool = 0;
+
+			if (!nextBatchToken(&cursor, path, MAX_PATH) || path[0] == '#') continue;
+			for (int i = 0; i < numCovers && !inPool; i++)
+			{
+				if (_stricmp(covers[i].fullPath, path) == 0) inPool = 1;
+			}
+			if (inPool) continue;
+
+			if (numKept == keptCapacity)
+			{
+				keptLines = (char**)growArray(keptLines, &keptCapacity, sizeof(char*));
+			}
+			keptLines[numKept] = (char*)trackedMalloc(strlen(line) + 1, MEM_SITE_BOOKKEEPING);
+			strcpy(keptLines[numKept++], line);
+		}
+		fclose(ptrFile);
+	}
+
+	ptrFile = fopen(catalogueFileName, "w");
+	if (ptrFile == NULL)
+	{
+		printf("Error opening file (%s) for writing.\n\n", catalogueFileName);
+	}
+	else
+	{
+		fprintf(ptrFile, "# BDPP capacity catalogue\n");
+		fprintf(ptrFile, "# \"cover\" file size, write time, bits per block, capacity bits, total blocks, scheduled uses\n");
+		for (int i = 0; i < numKept; i++)
+		{
+			fputs(keptLines[i], ptrFile);
+		}
+		for (int i = 0; i < numCovers; i++)
+		{
+			if (!covers[i].catalogued) continue;
+			fprintf(ptrFile, "\"%s\" %llu %llu %d %d %d %d\n", covers[i].fullPath, covers[i].fileSize,
+				covers[i].writeTime, bitsPerBlock, covers[i].capacityBits, covers[i].totalBlocks, covers[i].uses);
+		}
+		fclose(ptrFile);
+	}
+
+	for (int i = 0; i < numKept; i++)
+	{
+		trackedFree(keptLines[i]);
+	}
+	trackedFree(keptLines);
+} // saveCatalogue
+
+// runs work(i) for i = 0 .. count - 1 on up to one thread per hardware thread
+template<typename Work>
+static void runOnThreads(int count, Work work)
+{
+	std::atomic<int> nextItem(0);
+	int numThreads = (int)std::thread::hardware_concurrency();
+	if (numThreads < 1) numThreads = 1;
+	if (numThreads > count) numThreads = count;
+
+	std::thread* workers = new std::thread[numThreads];
+	for (int t = 0; t < numThreads; t++)
+	{
+		workers[t] = std::thread([&]()
+		{
+			traceThreadName("scheduler worker");
+			for (int i = nextItem++; i < count; i = nextItem++)
+			{
+				work(i);
+			}
+		});
+	}
+	for (int t = 0; t < numThreads; t++)
+	{
+		workers[t].join();
+	}
+	delete[] workers;
+} // runOnThreads
+
+// classifies the covers the catalogue has no valid entry for, in parallel
+static int catalogueCovers(scheduleCover* covers, int numCovers)
+{
+	int* missing = (int*)trackedMalloc(sizeof(int) * (numCovers + 1), MEM_SITE_BOOKKEEPING);
+	int numMissing = 0;
+	std::atomic<int> failed(0);
+
+	for (int i = 0; i < numCovers; i++)
+	{
+		if (!covers[i].catalogued) missing[numMissing++] = i;
+	}
+
+	runOnThreads(numMissing, [&](int item)
+	{
+		scheduleCover* cover = &covers[missing[item]];
+		if (countCapacity(cover->coverFile, &cover->capacityBits, &cover->totalBlocks) == SUCCESS)
+		{
+			cover->catalogued = 1;
+		}
+		else
+		{
+			failed++;
+		}
+	});
+
+	printf("Catalogue: %d covers, %d classified, %d from the cache\n", numCovers, numMissing, numCovers - numMissing);
+	trackedFree(missing);
+	return failed == 0 ? SUCCESS : FAILURE;
+} // catalogueCovers
+
+// orders messages largest first, for the best fit decreasing packing
+static int compareMessages(const void* a, const void* b)
+{
+	unsigned int bitsA = (*(scheduleMessage**)a)->bits;
+	unsigned int bitsB = (*(scheduleMessage**)b)->bits;
+	return bitsA < bitsB ? 1 : (bitsA > bitsB ? -1 : 0);
+} // compareMessages
+
+// places every message on a cover, returns how many messages no cover could hold
+static int packMessages(scheduleCover* covers, int numCovers, scheduleMessage* messages, int numMessages)
+{
+	scheduleMessage** order = (scheduleMessage**)trackedMalloc(sizeof(scheduleMessage*) * (numMessages + 1), MEM_SITE_BOOKKEEPING);
+	unsigned long long bitsLeft = 0;
+	int unplaced = 0;
+
+	for (int i = 0; i < numMessages; i++)
+	{
+		order[i] = &messages[i];
+		bitsLeft += messages[i].bits;
+	}
+	qsort(order, numMessages, sizeof(scheduleMessage*), compareMessages);
+
+	for (int m = 0; m < numMessages; m++)
+	{
+		scheduleMessage* message = order[m];
+		int best = -1;
+
+		// best fit: the open cover with the least room left that still takes the message
+		for (int i = 0; i < numCovers; i++)
+		{
+			if (!covers[i].opened || !covers[i].catalogued) continue;
+			unsigned int room = covers[i].capacityBits - covers[i].bitsPlaced;
+			if (room >= message->bits && (best < 0 || room < covers[best].capacityBits - covers[best].bitsPlaced))
+			{
+				best = i;
+			}
+		}
+
+		// otherwise open a new cover: the smallest one that takes everything still to be placed,
+		// or the largest one if none does. Ties go to the cover used least so the pool wears evenly
+		if (best < 0)
+		{
+			for (int i = 0; i < numCovers; i++)
+			{
+				if (covers[i].opened || !covers[i].catalogued || (unsigned int)covers[i].capacityBits < message->bits) continue;
+				if (best < 0)
+				{
+					best = i;
+					continue;
+				}
+				int holdsAll = (unsigned long long)covers[i].capacityBits >= bitsLeft;
+				int bestHoldsAll = (unsigned long long)covers[best].capacityBits >= bitsLeft;
+				if (holdsAll != bestHoldsAll)
+				{
+					if (holdsAll) best = i;
+				}
+				else if (covers[i].capacityBits != covers[best].capacityBits)
+				{
+					if ((covers[i].capacityBits < covers[best].capacityBits) == (holdsAll != 0)) best = i;
+				}
+				else if (covers[i].uses < covers[best].uses)
+				{
+					best = i;
+				}
+			}
+			if (best >= 0) covers[best].opened = 1;
+		}
+
+		bitsLeft -= message->bits;
+		if (best < 0)
+		{
+			printf("Error - no cover can hold %s (%u bits).\n\n", message->msgFile, message->bits);
+			unplaced++;
+			continue;
+		}
+		message->cover = best;
+		message->offset = covers[best].bitsPlaced;
+		covers[best].bitsPlaced += message->bits;
+	}
+
+	trackedFree(order);
+	return unplaced;
+} // packMessages
+
+// hides the messages placed on one cover, all of them in one pass over the image
+static int hideOnCover(int coverIndex, scheduleCover* cover, scheduleMessage* messages, int numMessages)
+{
+	BITMAPFILEHEADER* pFileHdr;
+	BITMAPINFOHEADER* pFileInfoHdr;
+	unsigned char* coverData, * payload;
+	imageView image;
+	bandState state;
+	FILE* ptrFile;
+	long coverSize;
+	int status = SUCCESS;
+
+	// the payload is the messages of this cover back to back, in the order they were placed
+	payload = (unsigned char*)trackedCalloc(cover->bitsPlaced / 8 + 1, 1, MEM_SITE_MESSAGE);
+	for (int i = 0; i < numMessages && payload != NULL; i++)
+	{
+		if (messages[i].cover != coverIndex) continue;
+		ptrFile = fopen(messages[i].msgFile, "rb");
+		if (ptrFile == NULL || fread(payload + messages[i].offset / 8, 1, messages[i].bits / 8, ptrFile) != messages[i].bits / 8)
+		{
+			printf("Error in opening file: %s.\n\n", messages[i].msgFile);
+			status = FAILURE;
+		}
+		if (ptrFile != NULL) fclose(ptrFile);
+	}
+
+	coverData = NULL;
+	ptrFile = fopen(cover->coverFile, "rb");
+	if (ptrFile != NULL)
+	{
+		fseek(ptrFile, 0, SEEK_END);
+		coverSize = ftell(ptrFile);
+		fseek(ptrFile, 0, SEEK_SET);
+		coverData = (unsigned char*)trackedMalloc(coverSize, MEM_SITE_FILE);
+		if (coverData != NULL && fread(coverData, 1, coverSize, ptrFile) != (size_t)coverSize)
+		{
+			trackedFree(coverData);
+			coverData = NULL;
+		}
+		fclose(ptrFile);
+	}
+	if (payload == NULL || coverData == NULL || status != SUCCESS || !isSupportedBitmap(coverData, (unsigned int)coverSize))
+	{
+		if (coverData == NULL) printf("Error in opening file: %s.\n\n", cover->coverFile);
+		trackedFree(payload);
+		trackedFree(coverData);
+		return FAILURE;
+	}
+
+	pFileHdr = (BITMAPFILEHEADER*)coverData;
+	pFileInfoHdr = (BITMAPINFOHEADER*)(coverData + sizeof(BITMAPFILEHEADER));
+	initImageView(&image, pFileInfoHdr, coverData + pFileHdr->bfOffBits);
+	// every cover has a deadline of its own, one that runs out is not written and the schedule goes on
+	requestContext request;
+	initRequest(&request, gDeadlineMilliseconds);
+	if (initBandState(&state, &image, payload, cover->bitsPlaced, NULL, 0, ACTION_HIDE) != SUCCESS)
+	{
+		trackedFree(payload);
+		trackedFree(coverData);
+		return FAILURE;
+	}
+	state.request = &request;
+	if (processBands(&state, &image) != SUCCESS)
+	{
+		reportRequestStop(&request, "hide");
+		freeAnalysis(state.analysis);
+		trackedFree(payload);
+		trackedFree(coverData);
+		return FAILURE;
+	}
+	cover->key = state.bitIndex;
+	if (state.bitIndex < cover->bitsPlaced && state.permuted)
+	{
+		// the permuted order is derived from the whole payload size, the bits that did fit cannot be extracted
+		printf("Error - %s holds fewer bits than its catalogue entry, a permuted hide needs all of them, nothing was written.\n\n",
+			cover->coverFile);
+		cover->key = 0;
+		trackedFree(payload);
+		trackedFree(coverData);
+		return FAILURE;
+	}
+	if (state.bitIndex < cover->bitsPlaced)
+	{
+		printf("Error - %s holds fewer bits than its catalogue entry, possible message Data loss.\n\n", cover->coverFile);
+		status = FAILURE;
+	}
+	if (state.verifyFailures > 0)
+	{
+		printf("Error - %d blocks of %s failed -verify.\n\n", state.verifyFailures, cover->outputFile);
+		status = FAILURE;
+	}
+
+	// the pixels were changed in place, the stego file is the cover file as it was read, as main writes it
+	char writeName[MAX_PATH];
+	ptrFile = durableWriteName(cover->outputFile, writeName) == SUCCESS ? fopen(writeName, "wb") : NULL;
+	if (ptrFile == NULL || fwrite(coverData, 1, coverSize, ptrFile) != (size_t)coverSize)
+	{
+		printf("Error writing file %s.\n\n", cover->outputFile);
+		if (ptrFile != NULL) fclose(ptrFile);
+		durableDiscard(writeName);
+		status = FAILURE;
+	}
+	else
+	{
+		fclose(ptrFile);
+		if (durableFinish(writeName) != SUCCESS) status = FAILURE;
+	}
+
+	trackedFree(payload);
+	trackedFree(coverData);
+	return status;
+} // hideOnCover
+
+// writes where every message went and the key needed to get it back
+static int writeManifest(char* manifestFileName, scheduleCover* covers, int numCovers,
+	scheduleMessage* messages, int numMessages)
+{
+	char writeName[MAX_PATH];
+	if (durableWriteName(manifestFileName, writeName) != SUCCESS) return FAILURE;
+	FILE* ptrFile = fopen(writeName, "w");
+	if (ptrFile == NULL)
+	{
+		printf("Error opening file (%s) for writing.\n\n", manifestFileName);
+		return FAILURE;
+	}
+
+	fprintf(ptrFile, "# BDPP schedule manifest\n");
+	fprintf(ptrFile, "# extract each stego file with -extract -s <stego file> -k <key>, every extracted byte is one bit\n");
+	fprintf(ptrFile, "# a message is the extracted bytes [offset, offset + bits), 8 of them per message byte\n");
+	for (int i = 0; i < numCovers; i++)
+	{
+		if (!covers[i].opened) continue;
+		fprintf(ptrFile, "stego \"%s\" cover \"%s\" key %d%s\n", covers[i].outputFile, covers[i].coverFile,
+			covers[i].key, covers[i].status == SUCCESS ? "" : " failed");
+		for (int m = 0; m < numMessages; m++)
+		{
+			if (messages[m].cover != i) continue;
+			fprintf(ptrFile, "message \"%s\" offset %u bits %u\n", messages[m].msgFile, messages[m].offset, messages[m].bits);
+		}
+	}
+	for (int m = 0; m < numMessages; m++)
+	{
+		if (messages[m].cover < 0) fprintf(ptrFile, "unplaced \"%s\" bits %u\n", messages[m].msgFile, messages[m].bits);
+	}
+	fclose(ptrFile);
+	return durableFinish(writeName);
+} // writeManifest
+
+int runSchedule(char* scheduleFileName, char* catalogueFileName, char* manifestFileName, int bitsPerBlock)
+{
+	scheduleCover* covers;
+	scheduleMessage* messages;
+	int numCovers, numMessages, unplaced, coversUsed = 0, failed = 0;
+	int* usedCovers;
+	unsigned long long payloadBits = 0, capacityBits = 0;
+	clock_t start = clock();
+
+	readScheduleFile(scheduleFileName, &covers, &numCovers, &messages, &numMessages);
+	printf("\nScheduling %d messages on a pool of %d covers\n", numMessages, numCovers);
+
+	loadCatalogue(catalogueFileName, covers, numCovers, bitsPerBlock);
+	if (catalogueCovers(covers, numCovers) != SUCCESS) failed++;
+
+	unplaced = packMessages(covers, numCovers, messages, numMessages);
+
+	usedCovers = (int*)trackedMalloc(sizeof(int) * (numCovers + 1), MEM_SITE_BOOKKEEPING);
+	for (int i = 0; i < numCovers; i++)
+	{
+		if (!covers[i].opened) continue;
+		usedCovers[coversUsed++] = i;
+		payloadBits += covers[i].bitsPlaced;
+		capacityBits += covers[i].capacityBits;
+	}
+
+	// one hide per chosen cover, the covers are independent so they run side by side
+	runOnThreads(coversUsed, [&](int item)
+	{
+		scheduleCover* cover = &covers[usedCovers[item]];
+		cover->status = hideOnCover(usedCovers[item], cover, messages, numMessages);
+		printf("%s -> %s: %u bits, key %d\n", cover->coverFile, cover->outputFile, cover->bitsPlaced, cover->key);
+	});
+
+	for (int i = 0; i < coversUsed; i++)
+	{
+		if (covers[usedCovers[i]].status != SUCCESS) failed++;
+		else covers[usedCovers[i]].uses++;
+	}
+	saveCatalogue(catalogueFileName, covers, numCovers, bitsPerBlock);
+	if (writeManifest(manifestFileName, covers, numCovers, messages, numMessages) != SUCCESS) failed++;
+
+	printf("\nSchedule complete: %d of %d covers used, %d messages placed, %d unplaced, %d failed\n",
+		coversUsed, numCovers, numMessages - unplaced, unplaced, failed);
+	printf("Payload: %llu bits in %llu bits of capacity (%.2f%% of the covers used)\n", payloadBits, capacityBits,
+		capacityBits ? (double)payloadBits / capacityBits * 100 : 0.0);
+	printf("Manifest: %s, %.2f seconds\n", manifestFileName, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+	trackedFree(usedCovers);
+	trackedFree(covers);
+	trackedFree(messages);
+	return failed == 0 && unplaced == 0 ? SUCCESS : FAILURE;
+} // runSchedule
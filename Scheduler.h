@@ -0,0 +1,68 @@
+// BDPP Scheduler Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Chooses covers for a queue of messages from a pool of covers, packing the
+// messages onto as few covers as possible and hiding on them in parallel.
+//
+
+#pragma once
+
+#include <windows.h>
+
+#define SCHEDULE_DEFAULT_CATALOGUE	"bdpp_catalogue.txt"
+#define SCHEDULE_DEFAULT_MANIFEST	"schedule_manifest.txt"
+
+/*
+* Structure: scheduleCover
+* Usage: scheduleCover* cover = &covers[i];
+* ------------------------------------------------------
+* This structure is one cover of the pool with its
+* catalogue entry: the file size and write time the
+* block counts were taken at, the counts themselves and
+* how many scheduled runs have used the cover. The
+* remaining fields hold the messages placed on it.
+*/
+struct scheduleCover
+{
+    char coverFile[MAX_PATH];
+    char outputFile[MAX_PATH];       // stego file written if the cover is used
+    char fullPath[MAX_PATH];         // catalogue key
+    unsigned long long fileSize;
+    unsigned long long writeTime;
+    int capacityBits;                // hiding capacity at the current bits per block
+    int totalBlocks;
+    int uses;                        // scheduled runs that have hidden in this cover
+    int catalogued;                  // 1 once the counts match the file on disk
+    int opened;                      // 1 if at least one message was placed on the cover
+    unsigned int bitsPlaced;         // message bits placed on the cover, also its key
+    int key;                         // bits actually hidden, set by the hide
+    int status;                      // SUCCESS or FAILURE of the hide
+};  // scheduleCover
+
+/*
+* Structure: scheduleMessage
+* Usage: scheduleMessage* message = &messages[i];
+* ------------------------------------------------------
+* This structure is one message of the queue and where
+* the scheduler placed it: the cover it goes to and its
+* bit offset in that cover's payload.
+*/
+struct scheduleMessage
+{
+    char msgFile[MAX_PATH];
+    unsigned int bits;               // 8 bits per message byte
+    int cover;                       // index into the covers, -1 if no cover can hold it
+    unsigned int offset;             // first bit of the message in the cover payload
+};  // scheduleMessage
+
+/*
+* Function: runSchedule
+* Usage: runSchedule(gSchedulePathFileName, gCataloguePathFileName, gOutputPathFileName, gNumBits2Hide);
+* ------------------------------------------------------
+* This function reads a schedule file listing the cover
+* pool and the message queue, brings the capacity
+* catalogue up to date, packs the messages onto the
+* covers and hides them, one thread per cover. It writes
+* a manifest telling where every message went.
+*/
+int runSchedule(char* scheduleFileName, char* catalogueFileName, char* manifestFileName, int bitsPerBlock);
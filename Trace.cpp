@@ -0,0 +1,182 @@
+// BDPP Trace
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Per thread event rings and the Chrome trace writer behind -trace. A thread
+// registers its ring under a lock the first time it records an event; after
+// that only the thread itself writes the ring, so recording takes no lock.
+// The rings are written out when the program exits.
+//
+
+#include <atomic>
+#include <mutex>
+#include "BitmapReader.h"
+#include "Trace.h"
+
+int gTraceOn = 0;
+
+// one begin or end event
+struct traceEvent
+{
+	long long ticks;       // performance counter
+	const char* name;
+	int image;
+	int band;
+	char phase;            // 'B' or 'E'
+};  // traceEvent
+
+// the events of one thread, the newest TRACE_RING_EVENTS of them
+struct traceBuffer
+{
+	traceEvent* events;
+	std::atomic<unsigned long long> recorded;   // events ever recorded, the ring index is recorded % TRACE_RING_EVENTS
+	int tid;                                    // threads are numbered in the order they first record
+	const char* threadName;
+	traceBuffer* next;
+};  // traceBuffer
+
+static traceBuffer* gTraceBuffers = NULL;
+static int gTraceThreads = 0;
+static std::mutex gTraceLock;
+static std::atomic<int> gTraceImages(0);
+static FILE* gTraceFile = NULL;
+static char* gTraceFileName;
+static LARGE_INTEGER gTraceStart, gTraceFrequency;
+static thread_local traceBuffer* tThreadBuffer = NULL;
+static thread_local int tThreadImage = TRACE_NO_ID;
+
+// the calling thread's ring, registered on first use; NULL if it could not be allocated
+static traceBuffer* threadBuffer()
+{
+	if (tThreadBuffer != NULL) return tThreadBuffer;
+
+	traceBuffer* buffer = (traceBuffer*)calloc(1, sizeof(traceBuffer));
+	if (buffer == NULL) return NULL;
+	buffer->events = (traceEvent*)malloc(sizeof(traceEvent) * TRACE_RING_EVENTS);
+	if (buffer->events == NULL)
+	{
+		free(buffer);
+		return NULL;
+	}
+	{
+		std::lock_guard<std::mutex> lock(gTraceLock);
+		buffer->tid = gTraceThreads++;
+		buffer->next = gTraceBuffers;
+		gTraceBuffers = buffer;
+	}
+	tThreadBuffer = buffer;
+	return buffer;
+} // threadBuffer
+
+void recordTraceEvent(const char* name, char phase, int image, int band)
+{
+	traceBuffer* buffer = threadBuffer();
+	LARGE_INTEGER now;
+
+	if (buffer == NULL) return;
+	QueryPerformanceCounter(&now);
+
+	unsigned long long index = buffer->recorded.load(std::memory_order_relaxed);
+	traceEvent* event = &buffer->events[index % TRACE_RING_EVENTS];
+	event->ticks = now.QuadPart;
+	event->name = name;
+	event->image = image;
+	event->band = band;
+	event->phase = phase;
+	buffer->recorded.store(index + 1, std::memory_order_release);
+	return;
+} // recordTraceEvent
+
+void traceThreadName(const char* name)
+{
+	if (!gTraceOn) return;
+	traceBuffer* buffer = threadBuffer();
+	if (buffer != NULL) buffer->threadName = name;
+	return;
+} // traceThreadName
+
+int startTraceImage()
+{
+	tThreadImage = gTraceImages.fetch_add(1);
+	return tThreadImage;
+} // startTraceImage
+
+int currentTraceImage()
+{
+	return tThreadImage;
+} // currentTraceImage
+
+// writes the ids of an event as its args, ids of TRACE_NO_ID are left out
+static void writeTraceArgs(FILE* ptrFile, traceEvent* event)
+{
+	if (event->image == TRACE_NO_ID && event->band == TRACE_NO_ID) return;
+	fprintf(ptrFile, ",\"args\":{");
+	if (event->image != TRACE_NO_ID) fprintf(ptrFile, "\"image\":%d", event->image);
+	if (event->image != TRACE_NO_ID && event->band != TRACE_NO_ID) fprintf(ptrFile, ",");
+	if (event->band != TRACE_NO_ID) fprintf(ptrFile, "\"band\":%d", event->band);
+	fprintf(ptrFile, "}");
+} // writeTraceArgs
+
+// writes every ring as Chrome trace JSON, registered with atexit by startTrace
+static void writeTraceAtExit()
+{
+	unsigned long long totalEvents = 0, droppedEvents = 0;
+	int first = 1;
+
+	gTraceOn = 0;
+	std::lock_guard<std::mutex> lock(gTraceLock);
+	fprintf(gTraceFile, "{\"traceEvents\":[\n");
+	for (traceBuffer* buffer = gTraceBuffers; buffer != NULL; buffer = buffer->next)
+	{
+		unsigned long long recorded = buffer->recorded.load(std::memory_order_acquire);
+		unsigned long long oldest = recorded > TRACE_RING_EVENTS ? recorded - TRACE_RING_EVENTS : 0;
+		int depth = 0;
+
+		if (buffer->threadName != NULL)
+		{
+			fprintf(gTraceFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", buffer->tid, buffer->threadName);
+			first = 0;
+		}
+		for (unsigned long long i = oldest; i < recorded; i++)
+		{
+			traceEvent* event = &buffer->events[i % TRACE_RING_EVENTS];
+
+			// the begin events of an overwritten start of the ring are gone, drop the ends that match them
+			if (event->phase == 'E' && depth == 0) continue;
+			depth += event->phase == 'B' ? 1 : -1;
+
+			double microseconds = (double)(event->ticks - gTraceStart.QuadPart) * 1e6 / (double)gTraceFrequency.QuadPart;
+			fprintf(gTraceFile, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+				first ? "" : ",\n", event->name, event->phase, buffer->tid, microseconds);
+			writeTraceArgs(gTraceFile, event);
+			fprintf(gTraceFile, "}");
+			first = 0;
+		}
+		totalEvents += recorded - oldest;
+		droppedEvents += oldest;
+	}
+	fprintf(gTraceFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(gTraceFile);
+	gTraceFile = NULL;
+
+	printf("Trace: %llu events from %d threads written to %s", totalEvents, gTraceThreads, gTraceFileName);
+	if (droppedEvents > 0) printf(", %llu older events overwritten", droppedEvents);
+	printf("\n");
+} // writeTraceAtExit
+
+int startTrace(char* fileName)
+{
+	gTraceFile = fopen(fileName, "w");
+	if (gTraceFile == NULL)
+	{
+		printf("Error - could not create trace file %s.\n\n", fileName);
+		return FAILURE;
+	}
+	gTraceFileName = fileName;
+	QueryPerformanceFrequency(&gTraceFrequency);
+	QueryPerformanceCounter(&gTraceStart);
+	gTraceOn = 1;
+	atexit(writeTraceAtExit);
+	traceThreadName("main");
+	return SUCCESS;
+} // startTrace
@@ -0,0 +1,99 @@
+// BDPP Trace Header File
+// Authors: Roberto Delgado, Mark Solis, Daniel Zartuche
+//
+// Begin and end events of the phases of a run (reading, classifying and
+// embedding a band, writing, waiting on a queue), tagged with the image and
+// band they belong to and written as a Chrome trace JSON file with -trace so
+// a run can be laid out per thread in chrome://tracing or Perfetto. Each
+// thread records into its own ring of events, without locks; when tracing is
+// off every call is a single test of gTraceOn.
+//
+
+#pragma once
+
+#define TRACE_RING_EVENTS	65536	// events kept per thread, the oldest are overwritten
+#define TRACE_NO_ID			-1		// an event that is not tied to an image or band
+
+// phase names, the name of an event is one of these pointers
+#define TRACE_READ			"read"
+#define TRACE_CLASSIFY		"classify"			// capacity counts only
+#define TRACE_EMBED			"classify+embed"	// blocks are generated, classified and embedded in one pass
+#define TRACE_EXTRACT		"classify+extract"
+#define TRACE_WRITE			"write"
+#define TRACE_COMMIT		"commit"			// -durable flushes and renames a group of outputs
+#define TRACE_WAIT			"wait"
+#define TRACE_IO			"io"
+
+extern int gTraceOn;
+
+/*
+* Function: recordTraceEvent
+* Usage: recordTraceEvent(TRACE_READ, 'B', image, band);
+* ------------------------------------------------------
+* This function adds a begin ('B') or end ('E') event to
+* the ring of the calling thread, stamped with the
+* performance counter. Call it through traceBegin and
+* traceEnd.
+*/
+void recordTraceEvent(const char* name, char phase, int image, int band);
+
+/*
+* Function: traceBegin
+* Usage: traceBegin(TRACE_READ, image, band);
+* ------------------------------------------------------
+* This function marks the start of a phase of the
+* calling thread when tracing is on.
+*/
+static inline void traceBegin(const char* name, int image, int band)
+{
+    if (gTraceOn) recordTraceEvent(name, 'B', image, band);
+}
+
+/*
+* Function: traceEnd
+* Usage: traceEnd(TRACE_READ, image, band);
+* ------------------------------------------------------
+* This function marks the end of the phase most recently
+* begun by the calling thread when tracing is on.
+*/
+static inline void traceEnd(const char* name, int image, int band)
+{
+    if (gTraceOn) recordTraceEvent(name, 'E', image, band);
+}
+
+/*
+* Function: traceThreadName
+* Usage: traceThreadName("reader");
+* ------------------------------------------------------
+* This function names the calling thread in the trace.
+*/
+void traceThreadName(const char* name);
+
+/*
+* Function: startTraceImage
+* Usage: state->traceImage = startTraceImage();
+* ------------------------------------------------------
+* This function returns a new image id, numbered from 0
+* in the order the images are started, and makes it the
+* current image of the calling thread.
+*/
+int startTraceImage();
+
+/*
+* Function: currentTraceImage
+* Usage: traceBegin(TRACE_WRITE, currentTraceImage(), TRACE_NO_ID);
+* ------------------------------------------------------
+* This function returns the image the calling thread
+* last started, or TRACE_NO_ID.
+*/
+int currentTraceImage();
+
+/*
+* Function: startTrace
+* Usage: if (startTrace(gTracePathFileName) != SUCCESS) ...
+* ------------------------------------------------------
+* This function turns tracing on and writes the trace
+* to fileName when the program exits. Returns FAILURE if
+* the file cannot be created.
+*/
+int startTrace(char* fileName);